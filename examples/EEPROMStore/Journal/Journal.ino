@@ -0,0 +1,50 @@
+/**
+ * Journal - EEPROMJournalStore で書き込み先を分散する例
+ *
+ * 保存のたびに次のスロットへレコードを追記します。
+ * 起動するたびに起動回数を 1 増やして保存し、使用中のスロットを表示します。
+ */
+
+#include <EEPROMJournalStore.h>
+
+struct BootInfo {
+  uint32_t bootCount;
+  uint16_t lastReason;
+};
+
+constexpr uint16_t kEepromSize = 512;
+constexpr uint8_t kSlotCount = 8;
+
+BootInfo defaults = {
+    0,
+    0,
+};
+
+EEPROMSession session(kEepromSize);
+EEPROMJournalStore<BootInfo> store(session, 0, kSlotCount, defaults, 0xB007);
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+  }
+
+  const bool loaded = store.begin();
+  Serial.println(loaded ? F("Loaded from EEPROM") : F("Initialized"));
+
+  store.data.bootCount++;
+  store.save();
+
+  Serial.print(F("  boot count : "));
+  Serial.println(store.data.bootCount);
+  Serial.print(F("  slot       : "));
+  Serial.print(store.currentSlot());
+  Serial.print(F(" / "));
+  Serial.println(kSlotCount);
+  Serial.print(F("  sequence   : "));
+  Serial.println(store.sequence());
+  Serial.print(F("  area size  : "));
+  Serial.print(EEPROMJournalStore<BootInfo>::requiredSize(kSlotCount));
+  Serial.println(F(" bytes"));
+}
+
+void loop() {}
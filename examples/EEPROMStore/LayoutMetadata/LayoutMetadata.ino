@@ -3,6 +3,7 @@
  *
  * 既存EEPROMレイアウトのメタ情報を固定アドレスに保持し、
  * 構造体本体は EEPROMStore<T> で保存します。
+ * メタ情報の更新は Transaction でまとめて書き込み、commit() は 1 回だけ行います。
  */
 
 #include <stddef.h>
@@ -25,11 +26,14 @@ struct DeviceConfig {
 
 constexpr uint16_t kEepromSize = 512;
 constexpr uint16_t kHeaderAddress = 10;
+// Transaction がヘッダの CRC を保存する 2 バイト(ヘッダと設定の間に確保)
+constexpr uint16_t kHeaderCRCAddress = 28;
 constexpr uint16_t kConfigAddress = 32;
 constexpr uint16_t kLayoutVersion = 2;
 
 EEPROMSession session(kEepromSize);
-EEPROMLayoutStore<LayoutHeader> layoutStore(session, kHeaderAddress);
+EEPROMLayoutStore<LayoutHeader> layoutStore(session, kHeaderAddress,
+                                             kHeaderCRCAddress);
 
 DeviceConfig defaults = {
     64,
@@ -92,10 +96,18 @@ void setup() {
   LayoutHeader header = layoutStore.read();
   session.get(kConfigAddress, loadedConfig);
 
-  if (!isSameLayout(header, expectedHeader)) {
-    layoutStore.write(expectedHeader);
+  if (!isSameLayout(header, expectedHeader) || !layoutStore.verify()) {
+    EEPROMLayoutStore<LayoutHeader>::Transaction tx(layoutStore);
+    tx.writeField(offsetof(LayoutHeader, version), expectedHeader.version);
+    tx.writeField(offsetof(LayoutHeader, configSize),
+                  expectedHeader.configSize);
+    tx.writeField(offsetof(LayoutHeader, configAddress),
+                  expectedHeader.configAddress);
+    tx.writeField(offsetof(LayoutHeader, itemName), expectedHeader.itemName);
     session.put(kConfigAddress, defaults);
-    session.commit();
+    tx.commit();
+    Serial.print(F("Header bytes written: "));
+    Serial.println(tx.writtenBytes());
     header = expectedHeader;
     loadedConfig = defaults;
     Serial.println(F("Layout header updated"));
@@ -0,0 +1,65 @@
+/**
+ * Registry - EEPROMRegistry で複数の構造体をまとめて保存する例
+ *
+ * 保存先アドレスはコンパイル時に自動で割り当てられます。
+ * begin() は EEPROM の初期化を 1 回だけ行い、save() は変更のあった
+ * レコードだけを書き込んでから commit() を 1 回だけ呼びます。
+ */
+
+#include <EEPROMRegistry.h>
+
+struct SensorConfig {
+  uint16_t intervalMs;
+  float tempThreshold;
+  char name[16];
+};
+
+struct NetworkConfig {
+  uint8_t ip[4];
+  uint16_t port;
+};
+
+struct DisplayConfig {
+  uint8_t brightness;
+  bool enabled;
+};
+
+using Registry = EEPROMRegistry<SensorConfig, NetworkConfig, DisplayConfig>;
+
+Registry registry(SensorConfig{1000, 25.5f, "sensor-01"},
+                  NetworkConfig{{192, 168, 1, 100}, 8080},
+                  DisplayConfig{64, true});
+
+void printAddress(const __FlashStringHelper* name, uint16_t address) {
+  Serial.print(name);
+  Serial.print(F(": addr="));
+  Serial.println(address);
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+  }
+
+  Serial.println(registry.begin() ? F("All records loaded")
+                                  : F("Some records initialized"));
+
+  Serial.println(F("\n--- EEPROM Memory Map ---"));
+  printAddress(F("  Sensor  "), Registry::address<0>());
+  printAddress(F("  Network "), Registry::address<1>());
+  printAddress(F("  Display "), Registry::address<2>());
+  Serial.print(F("  Total   : "));
+  Serial.print(Registry::requiredSize());
+  Serial.println(F(" bytes"));
+
+  registry.get<0>().tempThreshold += 0.5f;
+  registry.get<2>().brightness = 128;
+  const size_t written = registry.save();
+
+  Serial.print(F("\nSaved records : "));
+  Serial.println(written);
+  Serial.print(F("Commit count  : "));
+  Serial.println(registry.commitCount());
+}
+
+void loop() {}
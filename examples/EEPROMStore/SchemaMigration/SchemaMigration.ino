@@ -0,0 +1,87 @@
+/**
+ * SchemaMigration - EEPROMVersionedStore で古い形式の設定を引き継ぐ例
+ *
+ * ファームウェア更新で構造体にフィールドを追加しても、登録した
+ * マイグレーションで古いレコードを最新版へ変換し、既存の値を保持します。
+ */
+
+#include <EEPROMVersionedStore.h>
+
+// バージョン 1 : 最初のリリース
+struct ConfigV1 {
+  uint16_t intervalMs;
+  float offset;
+};
+
+// バージョン 2 : ゲインを追加
+struct ConfigV2 {
+  uint16_t intervalMs;
+  float offset;
+  float gain;
+};
+
+// バージョン 3 : 名前を追加
+struct ConfigV3 {
+  uint16_t intervalMs;
+  float offset;
+  float gain;
+  char name[16];
+};
+
+struct ConfigV1ToV2 {
+  typedef ConfigV1 From;
+  typedef ConfigV2 To;
+  static const uint16_t kFromVersion = 1;
+  static void migrate(const ConfigV1& from, ConfigV2& to) {
+    to.intervalMs = from.intervalMs;
+    to.offset = from.offset;
+    to.gain = 1.0f;
+  }
+};
+
+struct ConfigV2ToV3 {
+  typedef ConfigV2 From;
+  typedef ConfigV3 To;
+  static const uint16_t kFromVersion = 2;
+  static void migrate(const ConfigV2& from, ConfigV3& to) {
+    to.intervalMs = from.intervalMs;
+    to.offset = from.offset;
+    to.gain = from.gain;
+    // name は設定しないため、デフォルト値のまま残る
+  }
+};
+
+ConfigV3 defaults = {
+    1000,
+    0.0f,
+    1.0f,
+    "sensor-01",
+};
+
+EEPROMVersionedStore<ConfigV3, 3,
+                     EEPROMMigrations<ConfigV1ToV2, ConfigV2ToV3> >
+    store(0, defaults, 0xC0F1);
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+  }
+
+  if (store.begin()) {
+    Serial.println(store.isMigrated() ? F("Migrated to version 3")
+                                      : F("Loaded version 3"));
+  } else {
+    Serial.println(F("Initialized with defaults"));
+  }
+
+  Serial.print(F("  interval : "));
+  Serial.println(store.data.intervalMs);
+  Serial.print(F("  offset   : "));
+  Serial.println(store.data.offset);
+  Serial.print(F("  gain     : "));
+  Serial.println(store.data.gain);
+  Serial.print(F("  name     : "));
+  Serial.println(store.data.name);
+}
+
+void loop() {}
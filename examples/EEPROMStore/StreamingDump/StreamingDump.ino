@@ -0,0 +1,75 @@
+/**
+ * StreamingDump - EEPROMDumpIterator で EEPROM を少しずつダンプする例
+ *
+ * loop() 1 回につき 1 行だけ出力するため、大きな EEPROM をダンプしている
+ * 間も LED の点滅が止まりません。
+ * シリアルから 'h' を送ると 16 進ダンプ、'b' を送るとバイナリダンプを開始します。
+ * バイナリダンプは (アドレス, バイト数, データ, CRC16) のブロック単位で出力します。
+ */
+
+#include <EEPROMStore.h>
+
+constexpr uint16_t kEepromSize = 512;
+constexpr uint8_t kLedPin = LED_BUILTIN;
+constexpr unsigned long kBlinkIntervalMs = 100;
+
+enum class DumpMode { None, Hex, Binary };
+
+EEPROMSession session(kEepromSize);
+EEPROMDumpIterator dumper(session);
+DumpMode mode = DumpMode::None;
+unsigned long lastBlinkMs = 0;
+
+void startDump(DumpMode nextMode) {
+  dumper.rewind();
+  mode = nextMode;
+}
+
+void dumpStep() {
+  if (mode == DumpMode::Hex) {
+    char line[EEPROMDumpIterator::kLineBufferSize];
+    if (dumper.next(line, sizeof(line)) > 0) {
+      Serial.println(line);
+    }
+  } else if (mode == DumpMode::Binary) {
+    uint8_t block[EEPROMDumpIterator::kBlockBufferSize];
+    const size_t written = dumper.nextBlock(block, sizeof(block));
+    if (written > 0) {
+      Serial.write(block, written);
+    }
+  }
+
+  if (dumper.done()) {
+    mode = DumpMode::None;
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+  }
+  pinMode(kLedPin, OUTPUT);
+  session.begin();
+  Serial.println(F("Send 'h' for hex dump, 'b' for binary dump"));
+}
+
+void loop() {
+  if (Serial.available() > 0) {
+    const char command = static_cast<char>(Serial.read());
+    if (command == 'h') {
+      startDump(DumpMode::Hex);
+    } else if (command == 'b') {
+      startDump(DumpMode::Binary);
+    }
+  }
+
+  if (mode != DumpMode::None) {
+    dumpStep();
+  }
+
+  const unsigned long now = millis();
+  if (now - lastBlinkMs >= kBlinkIntervalMs) {
+    lastBlinkMs = now;
+    digitalWrite(kLedPin, !digitalRead(kLedPin));
+  }
+}
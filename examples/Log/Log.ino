@@ -0,0 +1,47 @@
+#include <Arduino.h>
+
+#include <Log.h>
+#include <Timer.h>
+
+// 出力待ちのログを 2048 byte まで溜める。溢れたら古い行から捨てる
+LogRingBufferN<2048> logBuffer(LogRingBuffer::DROP_OLDEST);
+
+// WARN 以上のログを、ソフトウェアリセットで消えない RAM に残す
+LOG_RETAINED_ATTR uint32_t crashLogArea[128];
+RetainedLogSink crashLog(crashLogArea, sizeof(crashLogArea), Log::WARN);
+
+// 1ms周期の制御ループ
+Timer controlTimer(1000, Timer::MICROS);
+uint32_t counter = 0;
+
+void setup()
+{
+  logger.setLevel(Log::INFO);
+  if (crashLog.wasRetained())
+  {
+    // 前回のリセット前に残したログ
+    crashLog.dump(Serial);
+  }
+  logger.addSink(crashLog);
+  logger.enableAsync(logBuffer);
+  LOG_INFOF("Start example of Log (capacity=%u)", (unsigned)logBuffer.getCapacity());
+}
+
+void loop()
+{
+  if (controlTimer.isDeadline())
+  {
+    counter++;
+    // 引数はレベルが足りないときは評価されない
+    LOG_DEBUGF("counter=%lu", (unsigned long)counter);
+    if (counter % 100 == 0)
+    {
+      // シリアルに書かずにバッファに記録するだけなので、制御ループが止まらない
+      LOG_INFOF("counter=%lu missed=%lu", (unsigned long)counter,
+                (unsigned long)controlTimer.getTotalMissedCycles());
+    }
+  }
+
+  // 空き時間に送信バッファの空きの分だけ送る
+  logger.drain();
+}
@@ -16,6 +16,8 @@ const String PUB_TOPIC = "sample/topic";
 
 WiFiESP32 wifi = WiFiESP32(SSID, PASS);
 MQTTClientESP32 *mqttClient;
+// 切断中のメッセージを 2048 byte まで溜める。同じトピックは新しい値だけを送る
+MQTTPublishQueueN<2048> publishQueue(MQTTPublishQueue::DROP_OLDEST, MQTTPublishQueue::LATEST_VALUE);
 
 void onMessage(String topic, String payload)
 {
@@ -36,19 +38,24 @@ void setup()
   // サブスクライブ設定
   mqttClient->subscribe(PUB_TOPIC);
   mqttClient->registOnMessageCallback(onMessage);
+  // publish() はキューに溜め、healthCheck() でまとめて送る
+  mqttClient->enableQueue(publishQueue);
   delay(3000);
 }
 
 void loop()
 {
   static Timer timer(1000);
-  if (wifi.healthCheck() && mqttClient->healthCheck())
+  // 切断中もキューに溜めておき、再接続後に送る
+  if (timer.isCycleTime()) {
+    String payload = "{\"time\":" + String(millis()) + "}";
+    mqttClient->publish(PUB_TOPIC, payload);
+    logger.debug("queue topic: " + PUB_TOPIC + ", payload: " + payload + ", depth: " +
+                 String(mqttClient->getQueueDepth()) + ", dropped: " + String(mqttClient->getDroppedCount()));
+  }
+  if (wifi.healthCheck())
   {
-    if (timer.isCycleTime()) {
-      String payload = "{\"time\":" + String(millis()) + "}";
-      mqttClient->publish(PUB_TOPIC, payload);
-      logger.debug("send topic: " + PUB_TOPIC + ", payload: " + payload);
-    }
+    mqttClient->healthCheck();
   }
   delay(1);
 }
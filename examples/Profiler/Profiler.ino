@@ -0,0 +1,48 @@
+#include <Arduino.h>
+
+// 通常はプロジェクト全体のビルドフラグ (-DPROFILER_ENABLED=1) で有効にする。
+// Arduino IDE ではビルドフラグを指定しにくいので、PROFILE_ZONE() がこのファイルにしか
+// ないこの例では Profiler.h を読み込む前に定義する (このファイルだけが有効になる)
+#define PROFILER_ENABLED 1
+#include <Log.h>
+#include <Profiler.h>
+#include <Timer.h>
+
+// 5秒ごとに計測結果を出力
+Timer reportTimer(5000);
+
+// 重い処理の代わり
+void readSensor()
+{
+  PROFILE_ZONE("sensor");
+  delayMicroseconds(200 + random(0, 100));
+}
+
+// ときどき遅くなる処理の代わり
+void updateDisplay()
+{
+  PROFILE_ZONE("display");
+  delayMicroseconds(random(0, 20) == 0 ? 3000 : 500);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Start example of Profiler");
+}
+
+void loop()
+{
+  {
+    PROFILE_ZONE("loop");
+    readSensor();
+    updateDisplay();
+  }
+
+  if (reportTimer.isCycleTime())
+  {
+    // 例: display count=9000 min=500us mean=625us max=3001us hist=8:8550,11:450
+    Profiler::dump(logger);
+    Profiler::resetAll();
+  }
+}
@@ -0,0 +1,45 @@
+#include <Arduino.h>
+
+#include <Scheduler.h>
+
+// 最大 8 個のタスクを登録できるスケジューラ
+Scheduler<8> scheduler;
+
+SchedulerBase::TaskId blinkTask;
+
+// 500msごとにLEDを反転
+void blink(void*)
+{
+  digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+}
+
+// 1000msごとにデバイス時間を表示
+void printTime(void*)
+{
+  Serial.println(Timer::getGlobalTime());
+}
+
+// 起動から10秒後に一度だけ呼ばれ、LEDの点滅を止める
+void stopBlink(void*)
+{
+  scheduler.cancel(blinkTask);
+  Serial.println("Stop blinking");
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Start example of Scheduler");
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  blinkTask = scheduler.every(500, blink);
+  scheduler.every(1000, printTime);
+  scheduler.after(10000, stopBlink);
+}
+
+void loop()
+{
+  // 実行時刻が来たタスクだけを呼び出し、次の実行時刻まで休む
+  uint32_t idle = scheduler.run();
+  delay(idle < 10 ? idle : 10);
+}
@@ -5,6 +5,9 @@
 // 1000msごとに発火するタイマーを作成
 Timer timer = Timer(1000);
 
+// 1ms (1000us) 周期の制御ループ用タイマーを作成
+Timer control = Timer(1000, Timer::MICROS);
+
 void setup()
 {
   Serial.begin(115200);
@@ -13,9 +16,21 @@ void setup()
 
 void loop()
 {
+  if (control.isDeadline())
+  {
+    // 1msごとの処理。周期に間に合わなかった場合は飛ばした回数がわかる
+    if (control.getMissedCycles() > 0)
+    {
+      Serial.print("missed cycles: ");
+      Serial.println(control.getMissedCycles());
+    }
+  }
+
   if (timer.isCycleTime())
   {
-    // 1000msごとにデバイス時間を表示
-    Serial.println(timer.getGlobalTime());
+    // 1000msごとにデバイス時間と制御ループの最大遅れ[us]を表示
+    Serial.print(timer.getGlobalTime());
+    Serial.print(", max lateness[us]: ");
+    Serial.println(control.getMaxLateness());
   }
-}
\ No newline at end of file
+}
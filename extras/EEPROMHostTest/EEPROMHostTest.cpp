@@ -0,0 +1,219 @@
+/**
+ * @file EEPROMHostTest.cpp
+ * @brief EEPROMStore と EEPROMLayoutStore をファイルのバックエンドでホスト上で動かす
+ *
+ * @details ビルドと実行（リポジトリのルートで）:
+ *   g++ -std=c++11 -O2 -Isrc extras/EEPROMHostTest/EEPROMHostTest.cpp -o eeprom_host_test
+ *   ./eeprom_host_test [EEPROM ファイル]
+ *
+ * EEPROMMmapBackend を使い、次を確認する。失敗があれば終了コード 1 を返す。
+ *   - EEPROMStore: 保存した内容を開き直して読めること、変更がなければ書き込まないこと、
+ *     差分書き込みモードでは変更範囲とヘッダだけを書くこと、壊れたレコードは
+ *     デフォルト値に戻ること
+ *   - EEPROMLayoutStore: Transaction で書いたフィールドと CRC を開き直して検証できること、
+ *     fail() したトランザクションは何も書かないこと、レイアウト直後を書き換えないこと、
+ *     レイアウト内の CRC フィールドも使えること
+ *   - EEPROMJournalStore: バイト単位で書き換える EEPROM では同じセルの書き換え回数が
+ *     1/N になること、全体を 1 セクタで消去するエミュレーションでは減らないこと
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "EEPROMJournalStore.h"
+#include "EEPROMMmapBackend.h"
+#include "EEPROMStore.h"
+
+namespace
+{
+
+struct Config
+{
+  uint16_t interval;
+  float threshold;
+  char name[16];
+};
+
+struct Layout
+{
+  uint16_t version;
+  uint16_t stateSize;
+  char itemName[4];
+  uint8_t flags[8];
+};
+
+// CRC をレイアウトの中に持つ形式
+struct CheckedLayout
+{
+  uint16_t version;
+  uint16_t crc;
+  uint8_t flags[4];
+};
+
+const uint16_t kEEPROMSize = 512;
+const uint16_t kStoreAddress = 0;
+const uint16_t kTrackedAddress = 64;
+const uint16_t kLayoutAddress = 128;
+const uint16_t kLayoutCRCAddress = 160;
+const uint16_t kCheckedLayoutAddress = 192;
+const uint8_t kGuard = 0x5A;
+const uint8_t kJournalSlots = 8;
+const uint16_t kJournalSaves = 100;
+
+const Config kDefaults = {1000, 25.5f, "sensor01"};
+
+unsigned failures = 0;
+
+void check(bool condition, const char* message)
+{
+  printf("%s %s\n", condition ? "ok  " : "FAIL", message);
+  if (!condition)
+  {
+    failures++;
+  }
+}
+
+void testStore(const char* path)
+{
+  {
+    EEPROMMmapBackend backend(path);
+    EEPROMStore<Config> store(backend, kStoreAddress, kDefaults);
+    check(!store.begin(), "EEPROMStore: empty file starts with defaults");
+    store.data.threshold = 30.0f;
+    check(store.save(), "EEPROMStore: save() writes a changed record");
+    check(!store.save(), "EEPROMStore: save() skips an unchanged record");
+  }
+  {
+    EEPROMMmapBackend backend(path);
+    EEPROMStore<Config> store(backend, kStoreAddress, kDefaults);
+    check(store.begin() && store.data.threshold == 30.0f, "EEPROMStore: record survives reopening the file");
+  }
+  {
+    EEPROMMmapBackend backend(path);
+    EEPROMStore<Config, true> store(backend, kTrackedAddress, kDefaults);
+    store.begin();
+    store.data.interval = 2000;
+    store.save();
+    check(store.lastWriteBytes() < EEPROMStore<Config, true>::requiredSize(),
+          "EEPROMStore<T, true>: save() writes only the changed range and header");
+  }
+  {
+    EEPROMMmapBackend backend(path);
+    EEPROMSession session(kEEPROMSize, backend);
+    session.begin();
+    uint8_t value = 0;
+    session.get(static_cast<uint16_t>(kStoreAddress + sizeof(EEPROMStoreUtil::RecordHeader)), value);
+    session.put(static_cast<uint16_t>(kStoreAddress + sizeof(EEPROMStoreUtil::RecordHeader)),
+                static_cast<uint8_t>(value ^ 0xFF));
+    session.commit();
+
+    EEPROMStore<Config> store(backend, kStoreAddress, kDefaults);
+    check(!store.begin() && store.data.threshold == kDefaults.threshold,
+          "EEPROMStore: corrupted record falls back to defaults");
+  }
+}
+
+void testLayout(const char* path)
+{
+  {
+    EEPROMMmapBackend backend(path);
+    EEPROMSession session(kEEPROMSize, backend);
+    session.begin();
+    session.put(static_cast<uint16_t>(kLayoutAddress + sizeof(Layout)), kGuard);
+    EEPROMLayoutStore<Layout> store(session, kLayoutAddress, kLayoutCRCAddress);
+    {
+      EEPROMLayoutStore<Layout>::Transaction tx(store);
+      tx.writeField(offsetof(Layout, version), static_cast<uint16_t>(2));
+      tx.writeField(offsetof(Layout, stateSize), static_cast<uint16_t>(32));
+      tx.writeBytes(offsetof(Layout, itemName), "ABC", 4);
+      check(tx.commit() && tx.rangeCount() == 1, "Transaction: adjacent fields are coalesced into one write");
+    }
+    {
+      EEPROMLayoutStore<Layout>::Transaction tx(store);
+      tx.writeField(offsetof(Layout, version), static_cast<uint16_t>(99));
+      tx.fail();
+    }
+  }
+  {
+    EEPROMMmapBackend backend(path);
+    EEPROMSession session(kEEPROMSize, backend);
+    session.begin();
+    EEPROMLayoutStore<Layout> store(session, kLayoutAddress, kLayoutCRCAddress);
+    const Layout layout = store.read();
+    check(store.verify(), "EEPROMLayoutStore: CRC verifies after reopening the file");
+    check(layout.version == 2 && layout.stateSize == 32 && memcmp(layout.itemName, "ABC", 4) == 0,
+          "EEPROMLayoutStore: committed fields survive and failed transaction wrote nothing");
+    uint8_t guard = 0;
+    session.get(static_cast<uint16_t>(kLayoutAddress + sizeof(Layout)), guard);
+    check(guard == kGuard, "EEPROMLayoutStore: byte after the layout is left untouched");
+    check(!EEPROMLayoutStore<Layout>(session, kLayoutAddress).verify(),
+          "EEPROMLayoutStore: verify() fails without a CRC address");
+  }
+}
+
+void testCheckedLayout(const char* path)
+{
+  EEPROMMmapBackend backend(path);
+  EEPROMSession session(kEEPROMSize, backend);
+  session.begin();
+  EEPROMLayoutStore<CheckedLayout> store(
+      session, kCheckedLayoutAddress,
+      EEPROMStoreUtil::layoutFieldAddress(kCheckedLayoutAddress, offsetof(CheckedLayout, crc)));
+  {
+    EEPROMLayoutStore<CheckedLayout>::Transaction tx(store);
+    tx.writeField(offsetof(CheckedLayout, version), static_cast<uint16_t>(7));
+    tx.writeBytes(offsetof(CheckedLayout, flags), "\x01\x02\x03\x04", 4);
+  }
+  check(store.verify() && store.read().version == 7, "EEPROMLayoutStore: CRC field inside the layout verifies");
+
+  session.put(static_cast<uint16_t>(kCheckedLayoutAddress + offsetof(CheckedLayout, flags)), static_cast<uint8_t>(9));
+  check(!store.verify(), "EEPROMLayoutStore: CRC field inside the layout detects corruption");
+}
+
+/* sectorSize ごとに消去するバックエンドで 8 スロットのジャーナルに kJournalSaves 回保存し、最大の消去回数を返す */
+uint32_t journalMaxErases(const char* path, uint16_t sectorSize)
+{
+  remove(path);
+  EEPROMMmapBackend backend(path, sectorSize);
+  EEPROMSession session(kEEPROMSize, backend);
+  session.begin();
+  EEPROMJournalStore<Config> store(session, kStoreAddress, kJournalSlots, kDefaults);
+  store.begin();
+  for (uint16_t i = 0; i < kJournalSaves; i++)
+  {
+    store.data.interval = i;
+    store.save();
+  }
+  return backend.maxEraseCount();
+}
+
+void testJournalWear(const char* path)
+{
+  const uint32_t byteErases = journalMaxErases(path, 1);
+  check(byteErases <= (kJournalSaves + kJournalSlots - 1) / kJournalSlots,
+        "EEPROMJournalStore: byte-erasable EEPROM rewrites each cell 1/N as often");
+  // ESP32/ESP8266 のエミュレーションは commit() のたびに領域全体を消去するので分散しない
+  const uint32_t sectorErases = journalMaxErases(path, 4096);
+  check(sectorErases >= kJournalSaves, "EEPROMJournalStore: a single 4096-byte sector is erased on every save");
+  printf("     max erases: byte-erasable=%lu, 4096-byte sector=%lu (saves=%u, slots=%u)\n",
+         static_cast<unsigned long>(byteErases), static_cast<unsigned long>(sectorErases), kJournalSaves,
+         kJournalSlots);
+  remove(path);
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  const char* path = argc > 1 ? argv[1] : "eeprom_host_test.bin";
+  remove(path);
+
+  testStore(path);
+  testLayout(path);
+  testCheckedLayout(path);
+  testJournalWear(path);
+
+  printf("failures=%u\n", failures);
+  remove(path);
+  return failures == 0 ? 0 : 1;
+}
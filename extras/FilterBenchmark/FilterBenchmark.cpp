@@ -0,0 +1,262 @@
+/**
+ * @file FilterBenchmark.cpp
+ * @brief Filter.h の各フィルタの処理時間をホスト上で測定する
+ *
+ * @details ビルドと実行（リポジトリのルートで）:
+ *   g++ -std=c++11 -O2 -Isrc extras/FilterBenchmark/FilterBenchmark.cpp src/Filter.cpp -o filter_benchmark
+ *   ./filter_benchmark
+ *
+ * 256 サンプルのバッファを、1 サンプルずつ呼び出した場合と process() で
+ * まとめて処理した場合とで、1 サンプルあたりの時間 [ns] を比較する。
+ * 最後に、移動中央値を毎回ソートして求めた場合の時間を参考として表示する。
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "Filter.h"
+
+namespace
+{
+
+const size_t kBlockSize = 256;
+const int kRepeat = 20000;
+
+fix input[kBlockSize];
+fix output[kBlockSize];
+volatile fix sink;
+
+void makeInput()
+{
+  for (size_t i = 0; i < kBlockSize; i++)
+  {
+    input[i] = FLOAT_TO_FIX(100.0f * sinf(0.05f * i) + 10.0f * sinf(1.3f * i));
+  }
+}
+
+template <typename Func>
+double measureNs(Func func)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int repeat = 0; repeat < kRepeat; repeat++)
+  {
+    func();
+  }
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  sink = output[kBlockSize - 1];
+  return std::chrono::duration<double, std::nano>(end - start).count() / (static_cast<double>(kRepeat) * kBlockSize);
+}
+
+void print(const char* name, double perSample, double block)
+{
+  printf("%-22s %12.3f %12.3f %8.2fx\n", name, perSample, block, perSample / block);
+}
+
+/**
+ * @brief 窓を毎回コピーしてソートする素朴な移動中央値
+ */
+template <size_t N>
+class SortMedian
+{
+public:
+  SortMedian() : _now(0)
+  {
+    std::fill(_data, _data + N, 0);
+  }
+
+  fix movingMedian(fix xn)
+  {
+    _data[_now] = xn;
+    _now = (_now + 1) % N;
+    fix sorted[N];
+    std::copy(_data, _data + N, sorted);
+    std::nth_element(sorted, sorted + N / 2, sorted + N);
+    return sorted[N / 2];
+  }
+
+private:
+  fix _data[N];
+  size_t _now;
+};
+
+}  // namespace
+
+int main()
+{
+  makeInput();
+  printf("%-22s %12s %12s %9s\n", "filter", "per-sample", "block", "speedup");
+
+  {
+    FirstFilter a(LPF, 2.0f, 1);
+    FirstFilter b(LPF, 2.0f, 1);
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.firstFiltering(input[i]);
+      }
+    });
+    print("FirstFilter", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    MovAveFilter a(16);
+    MovAveFilter b(16);
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingAverage(input[i]);
+      }
+    });
+    print("MovAveFilter(16)", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    MovAveFilterN<16> a;
+    MovAveFilterN<16> b;
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingAverage(input[i]);
+      }
+    });
+    print("MovAveFilterN<16>", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    MovAveFilterN<10, int32_t> a;
+    MovAveFilterN<10, int32_t> b;
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingAverage(input[i]);
+      }
+    });
+    print("MovAveFilterN<10,i32>", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    MovAveFilterT<int64_t, uint8_t, true> a(16);
+    MovAveFilterT<int64_t, uint8_t, true> b(16);
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingAverage(input[i]);
+      }
+    });
+    print("MovAveFilter(16)+var", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    MovMaxFilterT<fix> a(64);
+    MovMaxFilterT<fix> b(64);
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingMax(input[i]);
+      }
+    });
+    print("MovMaxFilter(64)", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    MovMaxFilterN<64, fix> a;
+    MovMaxFilterN<64, fix> b;
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingMax(input[i]);
+      }
+    });
+    print("MovMaxFilterN<64>", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    MovMinMaxFilterT<fix> a(64);
+    MovMinMaxFilterT<fix> b(64);
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingMinMax(input[i]);
+      }
+    });
+    print("MovMinMaxFilter(64)", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    MedianFilterN<15> a;
+    MedianFilterN<15> b;
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingMedian(input[i]);
+      }
+    });
+    print("MedianFilterN<15>", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    HampelFilterN<15> a;
+    HampelFilterN<15> b;
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.filtering(input[i]);
+      }
+    });
+    print("HampelFilterN<15>", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    KalmanFilter a(0.01f, 4.0f);
+    KalmanFilter b(0.01f, 4.0f);
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.filtering(input[i]);
+      }
+    });
+    print("KalmanFilter", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    KalmanFilter2 a(1, 0.001f, 0.01f, 4.0f);
+    KalmanFilter2 b(1, 0.001f, 0.01f, 4.0f);
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.filtering(input[i]);
+      }
+    });
+    print("KalmanFilter2", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    FilterCascade<2> a;
+    FilterCascade<2> b;
+    designButterworthLowPass(a, 50.0f, 1000.0f);
+    designButterworthLowPass(b, 50.0f, 1000.0f);
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.filtering(input[i]);
+      }
+    });
+    print("FilterCascade<2>", perSample, measureNs([&]() { b.process(input, output, kBlockSize); }));
+  }
+
+  {
+    SortMedian<15> a;
+    const double perSample = measureNs([&]() {
+      for (size_t i = 0; i < kBlockSize; i++)
+      {
+        output[i] = a.movingMedian(input[i]);
+      }
+    });
+    printf("%-22s %12.3f\n", "median by sort (15)", perSample);
+  }
+
+  return 0;
+}
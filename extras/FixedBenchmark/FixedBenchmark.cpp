@@ -0,0 +1,185 @@
+/**
+ * @file FixedBenchmark.cpp
+ * @brief Fixed.hpp と float の演算速度・精度をホスト上で比較する
+ *
+ * @details ビルドと実行（リポジトリのルートで）:
+ *   g++ -std=c++11 -O2 -Isrc extras/FixedBenchmark/FixedBenchmark.cpp -o fixed_benchmark
+ *   ./fixed_benchmark
+ *
+ * 同じ入力列に対して加算・乗算・除算を行い、1 演算あたりの時間と
+ * double で計算した値との最大誤差を表示する。
+ * FIX_MUL2 / FIX_DIV2 は fix.hpp のマクロと同じ計算を比較用に再現している。
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "Fixed.hpp"
+
+namespace
+{
+
+const size_t kSampleCount = 4096;
+const int kRepeat = 2000;
+
+/* fix.hpp の FIX_MUL2 / FIX_DIV2 と同じ計算 */
+int32_t legacyMul2(int32_t a, int32_t b)
+{
+  return (a >> 8) * (b >> 8);
+}
+
+int32_t legacyDiv2(int32_t a, int32_t b)
+{
+  return (a << 8) / (b >> 8);
+}
+
+struct Samples
+{
+  std::vector<float> a;
+  std::vector<float> b;
+  std::vector<FixQ16> fa;
+  std::vector<FixQ16> fb;
+};
+
+Samples makeSamples()
+{
+  Samples samples;
+  srand(1);
+  for (size_t i = 0; i < kSampleCount; i++)
+  {
+    // 乗算・除算とも Q16.16 の範囲に収まるよう ±100 に制限する
+    float a = (static_cast<float>(rand()) / RAND_MAX - 0.5f) * 200.0f;
+    float b = (static_cast<float>(rand()) / RAND_MAX - 0.5f) * 200.0f;
+    if (fabsf(b) < 1.0f)
+    {
+      b = b < 0.0f ? -1.0f : 1.0f;
+    }
+    samples.fa.push_back(FixQ16::fromFloat(a));
+    samples.fb.push_back(FixQ16::fromFloat(b));
+    // 量子化の差を誤差に含めないよう、float 側も固定小数点化した値を使う
+    samples.a.push_back(samples.fa.back().toFloat());
+    samples.b.push_back(samples.fb.back().toFloat());
+  }
+  return samples;
+}
+
+template <typename Func>
+double measureNs(Func func)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int repeat = 0; repeat < kRepeat; repeat++)
+  {
+    func();
+  }
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / (static_cast<double>(kRepeat) * kSampleCount);
+}
+
+template <typename Op>
+double maxError(const Samples& samples, Op op, double (*reference)(double, double))
+{
+  double worst = 0.0;
+  for (size_t i = 0; i < kSampleCount; i++)
+  {
+    const double error = fabs(op(i) - reference(samples.a[i], samples.b[i]));
+    if (error > worst)
+    {
+      worst = error;
+    }
+  }
+  return worst;
+}
+
+double refAdd(double a, double b)
+{
+  return a + b;
+}
+
+double refMul(double a, double b)
+{
+  return a * b;
+}
+
+double refDiv(double a, double b)
+{
+  return a / b;
+}
+
+volatile float floatSink;
+volatile int32_t fixSink;
+
+}  // namespace
+
+int main()
+{
+  const Samples samples = makeSamples();
+  std::vector<float> floatOut(kSampleCount);
+  std::vector<FixQ16> fixedOut(kSampleCount);
+  std::vector<int32_t> legacyOut(kSampleCount);
+
+  printf("%-14s %10s %14s\n", "op", "ns/op", "max error");
+
+#define RUN_FLOAT(name, expr, reference)                                                                              \
+  do                                                                                                                  \
+  {                                                                                                                   \
+    const double ns = measureNs([&]() {                                                                               \
+      for (size_t i = 0; i < kSampleCount; i++)                                                                       \
+      {                                                                                                               \
+        const float a = samples.a[i];                                                                                 \
+        const float b = samples.b[i];                                                                                 \
+        floatOut[i] = (expr);                                                                                         \
+      }                                                                                                               \
+      floatSink = floatOut[kSampleCount - 1];                                                                         \
+    });                                                                                                               \
+    const double error = maxError(samples, [&](size_t i) { return floatOut[i]; }, reference);                         \
+    printf("%-14s %10.3f %14.8f\n", name, ns, error);                                                                 \
+  } while (0)
+
+#define RUN_FIXED(name, expr, reference)                                                                              \
+  do                                                                                                                  \
+  {                                                                                                                   \
+    const double ns = measureNs([&]() {                                                                               \
+      for (size_t i = 0; i < kSampleCount; i++)                                                                       \
+      {                                                                                                               \
+        const FixQ16 a = samples.fa[i];                                                                               \
+        const FixQ16 b = samples.fb[i];                                                                               \
+        fixedOut[i] = (expr);                                                                                         \
+      }                                                                                                               \
+      fixSink = fixedOut[kSampleCount - 1].raw();                                                                     \
+    });                                                                                                               \
+    const double error = maxError(samples, [&](size_t i) { return fixedOut[i].toFloat(); }, reference);               \
+    printf("%-14s %10.3f %14.8f\n", name, ns, error);                                                                 \
+  } while (0)
+
+#define RUN_LEGACY(name, expr, reference)                                                                             \
+  do                                                                                                                  \
+  {                                                                                                                   \
+    const double ns = measureNs([&]() {                                                                               \
+      for (size_t i = 0; i < kSampleCount; i++)                                                                       \
+      {                                                                                                               \
+        const int32_t a = samples.fa[i].raw();                                                                        \
+        const int32_t b = samples.fb[i].raw();                                                                        \
+        legacyOut[i] = (expr);                                                                                        \
+      }                                                                                                               \
+      fixSink = legacyOut[kSampleCount - 1];                                                                          \
+    });                                                                                                               \
+    const double error =                                                                                              \
+      maxError(samples, [&](size_t i) { return FixQ16::fromRaw(legacyOut[i]).toFloat(); }, reference);                \
+    printf("%-14s %10.3f %14.8f\n", name, ns, error);                                                                 \
+  } while (0)
+
+  RUN_FLOAT("float add", a + b, refAdd);
+  RUN_FIXED("Fixed add", a + b, refAdd);
+  RUN_FLOAT("float mul", a * b, refMul);
+  RUN_FIXED("Fixed mul", a * b, refMul);
+  RUN_LEGACY("FIX_MUL2", legacyMul2(a, b), refMul);
+  RUN_FLOAT("float div", a / b, refDiv);
+  RUN_FIXED("Fixed div", a / b, refDiv);
+  RUN_LEGACY("FIX_DIV2", legacyDiv2(a, b), refDiv);
+
+  return 0;
+}
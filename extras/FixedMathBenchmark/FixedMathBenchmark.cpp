@@ -0,0 +1,191 @@
+/**
+ * @file FixedMathBenchmark.cpp
+ * @brief FixedMath.hpp の精度と速度を libm と比較する
+ *
+ * @details ビルドと実行（リポジトリのルートで）:
+ *   g++ -std=c++11 -O2 -Isrc extras/FixedMathBenchmark/FixedMathBenchmark.cpp -o fixed_math_benchmark
+ *   ./fixed_math_benchmark
+ *
+ * 各関数について、入力範囲を等間隔に走査したときの double との最大誤差
+ * （LSB = 2^-16 単位）と、1 回あたりの時間を float 版 (expf など) と並べて表示する。
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <vector>
+
+#include "FixedMath.hpp"
+
+namespace
+{
+
+const int kSampleCount = 20000;
+const int kRepeat = 200;
+
+volatile int32_t fixSink;
+volatile float floatSink;
+
+struct Result
+{
+  double maxErrorLsb;
+  double fixedNs;
+  double floatNs;
+};
+
+template <typename Func>
+double measureNs(Func func)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int repeat = 0; repeat < kRepeat; repeat++)
+  {
+    func();
+  }
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / (static_cast<double>(kRepeat) * kSampleCount);
+}
+
+/**
+ * @brief 1 引数関数を [low, high] で評価する
+ */
+template <typename FixedFunc, typename FloatFunc>
+Result runUnary(double low, double high, FixedFunc fixedFunc, FloatFunc floatFunc, double (*reference)(double))
+{
+  std::vector<FixQ16> fixedIn;
+  std::vector<float> floatIn;
+  for (int i = 0; i < kSampleCount; i++)
+  {
+    const FixQ16 x = FixQ16::fromFloat(static_cast<float>(low + (high - low) * i / (kSampleCount - 1)));
+    fixedIn.push_back(x);
+    floatIn.push_back(x.toFloat());
+  }
+
+  Result result = {0.0, 0.0, 0.0};
+  for (int i = 0; i < kSampleCount; i++)
+  {
+    const double expected = reference(static_cast<double>(fixedIn[i].raw()) / 65536.0);
+    const double error = fabs(fixedFunc(fixedIn[i]).raw() - expected * 65536.0);
+    if (error > result.maxErrorLsb)
+    {
+      result.maxErrorLsb = error;
+    }
+  }
+
+  result.fixedNs = measureNs([&]() {
+    int32_t sum = 0;
+    for (int i = 0; i < kSampleCount; i++)
+    {
+      sum += fixedFunc(fixedIn[i]).raw();
+    }
+    fixSink = sum;
+  });
+  result.floatNs = measureNs([&]() {
+    float sum = 0.0f;
+    for (int i = 0; i < kSampleCount; i++)
+    {
+      sum += floatFunc(floatIn[i]);
+    }
+    floatSink = sum;
+  });
+  return result;
+}
+
+/**
+ * @brief atan2 を円周上の点と原点付近の点で評価する
+ */
+Result runAtan2()
+{
+  std::vector<FixQ16> ys;
+  std::vector<FixQ16> xs;
+  for (int i = 0; i < kSampleCount; i++)
+  {
+    const double angle = -M_PI + 2.0 * M_PI * i / (kSampleCount - 1);
+    const double radius = (i % 2 == 0) ? 100.0 : 0.01;
+    ys.push_back(FixQ16::fromFloat(static_cast<float>(radius * ::sin(angle))));
+    xs.push_back(FixQ16::fromFloat(static_cast<float>(radius * ::cos(angle))));
+  }
+
+  Result result = {0.0, 0.0, 0.0};
+  for (int i = 0; i < kSampleCount; i++)
+  {
+    const double expected = ::atan2(ys[i].raw(), xs[i].raw());
+    double error = fabs(FixedMath::atan2(ys[i], xs[i]).raw() - expected * 65536.0);
+    // -π と π は同じ角度
+    if (error > M_PI * 65536.0)
+    {
+      error = fabs(error - 2.0 * M_PI * 65536.0);
+    }
+    if (error > result.maxErrorLsb)
+    {
+      result.maxErrorLsb = error;
+    }
+  }
+
+  result.fixedNs = measureNs([&]() {
+    int32_t sum = 0;
+    for (int i = 0; i < kSampleCount; i++)
+    {
+      sum += FixedMath::atan2(ys[i], xs[i]).raw();
+    }
+    fixSink = sum;
+  });
+  result.floatNs = measureNs([&]() {
+    float sum = 0.0f;
+    for (int i = 0; i < kSampleCount; i++)
+    {
+      sum += atan2f(ys[i].toFloat(), xs[i].toFloat());
+    }
+    floatSink = sum;
+  });
+  return result;
+}
+
+void print(const char* name, const char* range, const Result& result)
+{
+  printf("%-6s %-18s %10.3f %12.3f %12.3f\n", name, range, result.maxErrorLsb, result.fixedNs, result.floatNs);
+}
+
+double refExp(double x)
+{
+  return ::exp(x);
+}
+
+double refLog(double x)
+{
+  return ::log(x);
+}
+
+double refSqrt(double x)
+{
+  return ::sqrt(x);
+}
+
+double refSin(double x)
+{
+  return ::sin(x);
+}
+
+double refCos(double x)
+{
+  return ::cos(x);
+}
+
+}  // namespace
+
+int main()
+{
+  printf("%-6s %-18s %10s %12s %12s\n", "func", "range", "max LSB", "fixed ns", "float ns");
+
+  print("exp", "[-11.7, 0]", runUnary(-11.7, 0.0, FixedMath::exp, expf, refExp));
+  print("exp", "[0, 10.39]", runUnary(0.0, 10.39, FixedMath::exp, expf, refExp));
+  print("log", "[2^-16, 1]", runUnary(1.0 / 65536.0, 1.0, FixedMath::log, logf, refLog));
+  print("log", "[1, 32767]", runUnary(1.0, 32767.0, FixedMath::log, logf, refLog));
+  print("sqrt", "[0, 32767]", runUnary(0.0, 32767.0, FixedMath::sqrt, sqrtf, refSqrt));
+  print("sin", "[-2pi, 2pi]", runUnary(-2.0 * M_PI, 2.0 * M_PI, FixedMath::sin, sinf, refSin));
+  print("cos", "[-2pi, 2pi]", runUnary(-2.0 * M_PI, 2.0 * M_PI, FixedMath::cos, cosf, refCos));
+  print("sin", "[-100, 100]", runUnary(-100.0, 100.0, FixedMath::sin, sinf, refSin));
+  print("atan2", "r = 100, 0.01", runAtan2());
+
+  return 0;
+}
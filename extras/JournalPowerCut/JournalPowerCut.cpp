@@ -0,0 +1,115 @@
+/**
+ * @file JournalPowerCut.cpp
+ * @brief EEPROMJournalStore が書き込み途中の電源断に耐えることをホスト上で確認する
+ *
+ * @details ビルドと実行（リポジトリのルートで）:
+ *   g++ -std=c++11 -O2 -Isrc extras/JournalPowerCut/JournalPowerCut.cpp -o journal_power_cut
+ *   ./journal_power_cut
+ *
+ * EEPROMPowerCutSimulator で save() 1 回分の書き込みのすべてのバイト位置で電源を切り、
+ * 再起動後の begin() が保存前のレコードか保存後のレコードのどちらかを返すことを確認する。
+ * スロットが一周する前後も確認するため、電源断の前に保存する回数も変える。
+ * 失敗があれば終了コード 1 を返す。
+ */
+
+#include <stdio.h>
+
+#include "EEPROMJournalStore.h"
+#include "EEPROMPowerCutSimulator.h"
+
+namespace
+{
+
+struct Record
+{
+  uint32_t counter;
+  float value;
+  uint8_t label[10];
+};
+
+const uint16_t kEEPROMSize = 512;
+const uint8_t kSlotCount = 4;
+const uint16_t kMagic = 0x4A52;
+
+Record makeRecord(uint32_t counter)
+{
+  Record record;
+  memset(&record, 0, sizeof(record));
+  record.counter = counter;
+  record.value = static_cast<float>(counter) * 0.5f;
+  for (size_t i = 0; i < sizeof(record.label); i++)
+  {
+    record.label[i] = static_cast<uint8_t>(counter * 7 + i);
+  }
+  return record;
+}
+
+bool sameRecord(const Record& a, const Record& b)
+{
+  return memcmp(&a, &b, sizeof(Record)) == 0;
+}
+
+/* previousSaves 回保存した後、次の保存の cutAfter バイト目で電源を切る */
+bool runCase(unsigned previousSaves, size_t cutAfter, size_t& saveBytes)
+{
+  EEPROMPowerCutSimulator<kEEPROMSize> eeprom;
+  EEPROMSession session(kEEPROMSize, eeprom);
+  const Record defaults = makeRecord(0);
+
+  {
+    EEPROMJournalStore<Record> store(session, 0, kSlotCount, defaults, kMagic);
+    store.begin();
+    for (unsigned i = 1; i <= previousSaves; i++)
+    {
+      store.data = makeRecord(i);
+      store.save();
+    }
+
+    const size_t before = eeprom.bytesWritten();
+    store.data = makeRecord(previousSaves + 1);
+    eeprom.cutPowerAfter(cutAfter);
+    store.forceSave();
+    saveBytes = eeprom.bytesWritten() - before;
+    eeprom.powerCycle();
+  }
+
+  EEPROMJournalStore<Record> rebooted(session, 0, kSlotCount, defaults, kMagic);
+  rebooted.begin();
+  const Record oldRecord = makeRecord(previousSaves);
+  const Record newRecord = makeRecord(previousSaves + 1);
+  if (sameRecord(rebooted.data, oldRecord) || sameRecord(rebooted.data, newRecord))
+  {
+    return true;
+  }
+  printf("FAIL: previousSaves=%u cutAfter=%u counter=%lu\n", previousSaves, static_cast<unsigned>(cutAfter),
+         static_cast<unsigned long>(rebooted.data.counter));
+  return false;
+}
+
+}  // namespace
+
+int main()
+{
+  // 電源断なしで保存 1 回分の書き込みバイト数を調べる
+  size_t fullSave = 0;
+  runCase(0, static_cast<size_t>(-1), fullSave);
+
+  unsigned cases = 0;
+  unsigned failures = 0;
+  for (unsigned previousSaves = 0; previousSaves <= kSlotCount * 2u; previousSaves++)
+  {
+    for (size_t cutAfter = 0; cutAfter <= fullSave; cutAfter++)
+    {
+      size_t written = 0;
+      if (!runCase(previousSaves, cutAfter, written))
+      {
+        failures++;
+      }
+      cases++;
+    }
+  }
+
+  printf("slots=%u bytes/save=%u cases=%u failures=%u\n", kSlotCount, static_cast<unsigned>(fullSave), cases,
+         failures);
+  return failures == 0 ? 0 : 1;
+}
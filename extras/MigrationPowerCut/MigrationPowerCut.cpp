@@ -0,0 +1,159 @@
+/**
+ * @file MigrationPowerCut.cpp
+ * @brief EEPROMVersionedStore の変換が書き込み途中の電源断に耐えることをホスト上で確認する
+ *
+ * @details ビルドと実行（リポジトリのルートで）:
+ *   g++ -std=c++11 -O2 -Isrc extras/MigrationPowerCut/MigrationPowerCut.cpp -o migration_power_cut
+ *   ./migration_power_cut
+ *
+ * EEPROMStore<ConfigV0> で保存したバージョンなしのレコードと、バージョン 1 のレコードを用意し、
+ * begin() の変換で書き込むすべてのバイト位置で電源を切る。再起動後の begin() が変換前の値を
+ * 引き継いだ最新版を返すこと、requiredSize() より後ろを書き換えないことを確認する。
+ * 失敗があれば終了コード 1 を返す。
+ */
+
+#include <stdio.h>
+
+#include "EEPROMPowerCutSimulator.h"
+#include "EEPROMVersionedStore.h"
+
+namespace
+{
+
+// バージョンなし (EEPROMStore で保存していた形式)。変換後より大きい
+struct ConfigV0
+{
+  uint32_t intervalMs;
+  char name[24];
+};
+
+struct ConfigV1
+{
+  uint32_t intervalMs;
+  float gain;
+};
+
+struct ConfigV2
+{
+  uint32_t intervalMs;
+  float gain;
+  uint8_t mode;
+};
+
+struct ConfigV0ToV1
+{
+  typedef ConfigV0 From;
+  typedef ConfigV1 To;
+  static const uint16_t kFromVersion = 0;
+  static void migrate(const ConfigV0& from, ConfigV1& to)
+  {
+    to.intervalMs = from.intervalMs;
+    to.gain = 1.0f;
+  }
+};
+
+struct ConfigV1ToV2
+{
+  typedef ConfigV1 From;
+  typedef ConfigV2 To;
+  static const uint16_t kFromVersion = 1;
+  static void migrate(const ConfigV1& from, ConfigV2& to)
+  {
+    to.intervalMs = from.intervalMs;
+    to.gain = from.gain;
+  }
+};
+
+typedef EEPROMVersionedStore<ConfigV1, 1, EEPROMMigrations<ConfigV0ToV1> > StoreV1;
+typedef EEPROMVersionedStore<ConfigV2, 2, EEPROMMigrations<ConfigV0ToV1, ConfigV1ToV2> > StoreV2;
+
+const uint16_t kEEPROMSize = 256;
+const uint16_t kMagic = 0xC0F1;
+const uint8_t kGuard = 0xA5;
+const ConfigV2 kDefaults = {100, 0.5f, 3};
+
+/* 古い形式のレコードを書き、requiredSize() より後ろを kGuard で埋める */
+void prepare(EEPROMPowerCutSimulator<kEEPROMSize>& eeprom, bool legacy)
+{
+  eeprom.erase();
+  if (legacy)
+  {
+    ConfigV0 defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    EEPROMStore<ConfigV0> store(eeprom, 0, defaults, kMagic);
+    store.begin();
+    store.data.intervalMs = 1234;
+    strcpy(store.data.name, "legacy");
+    store.save();
+  }
+  else
+  {
+    const ConfigV1 defaults = {0, 0.0f};
+    StoreV1 store(eeprom, 0, defaults, kMagic);
+    store.begin();
+    store.data.intervalMs = 1234;
+    store.data.gain = 2.5f;
+    store.save();
+  }
+  memset(eeprom.memory() + StoreV2::requiredSize(), kGuard, kEEPROMSize - StoreV2::requiredSize());
+}
+
+/* 変換の cutAfter バイト目で電源を切り、再起動後の内容を確認する */
+bool runCase(bool legacy, size_t cutAfter, size_t& migrateBytes)
+{
+  EEPROMPowerCutSimulator<kEEPROMSize> eeprom;
+  prepare(eeprom, legacy);
+
+  const size_t before = eeprom.bytesWritten();
+  eeprom.cutPowerAfter(cutAfter);
+  {
+    StoreV2 store(eeprom, 0, kDefaults, kMagic);
+    store.begin();
+  }
+  migrateBytes = eeprom.bytesWritten() - before;
+  eeprom.powerCycle();
+
+  StoreV2 rebooted(eeprom, 0, kDefaults, kMagic);
+  const bool loaded = rebooted.begin();
+  const float gain = legacy ? 1.0f : 2.5f;
+  bool ok = loaded && rebooted.data.intervalMs == 1234 && rebooted.data.gain == gain &&
+            rebooted.data.mode == kDefaults.mode;
+  for (uint16_t address = StoreV2::requiredSize(); address < kEEPROMSize; address++)
+  {
+    ok = ok && eeprom.memory()[address] == kGuard;
+  }
+  if (!ok)
+  {
+    printf("FAIL: legacy=%d cutAfter=%u loaded=%d interval=%lu\n", legacy ? 1 : 0, static_cast<unsigned>(cutAfter),
+           loaded ? 1 : 0, static_cast<unsigned long>(rebooted.data.intervalMs));
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main()
+{
+  unsigned cases = 0;
+  unsigned failures = 0;
+  for (int legacy = 0; legacy <= 1; legacy++)
+  {
+    // 電源断なしで変換 1 回分の書き込みバイト数を調べる
+    size_t fullMigration = 0;
+    runCase(legacy != 0, static_cast<size_t>(-1), fullMigration);
+
+    for (size_t cutAfter = 0; cutAfter <= fullMigration; cutAfter++)
+    {
+      size_t written = 0;
+      if (!runCase(legacy != 0, cutAfter, written))
+      {
+        failures++;
+      }
+      cases++;
+    }
+    printf("%s: bytes/migration=%u\n", legacy ? "legacy" : "version 1", static_cast<unsigned>(fullMigration));
+  }
+
+  printf("requiredSize=%u cases=%u failures=%u\n", static_cast<unsigned>(StoreV2::requiredSize()), cases, failures);
+  return failures == 0 ? 0 : 1;
+}
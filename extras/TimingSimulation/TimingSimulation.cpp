@@ -0,0 +1,136 @@
+/**
+ * @file TimingSimulation.cpp
+ * @brief VirtualClock で Scheduler と Timer を実時間より速く動かす
+ *
+ * @details ビルドと実行（リポジトリのルートで）:
+ *   g++ -std=c++11 -O2 -Isrc extras/TimingSimulation/TimingSimulation.cpp src/Clock.cpp src/Timer.cpp \
+ *     src/Scheduler.cpp -o timing_simulation
+ *   ./timing_simulation
+ *
+ * 1 時間分のメインループを VirtualClock で進め、Scheduler のタスクの実行回数と、
+ * 1kHz の制御ループ (Timer の MICROS モード) が処理時間のばらつきで
+ * 周期に間に合わなかった回数・最大遅れを表示する。
+ * ループは次の実行時刻まで時刻を一気に進めるので、実機の 1 時間が数百 ms で終わる。
+ *
+ * あわせて、after(0) で自分を登録し直すタスクが 1 回の run() で 1 回だけ呼ばれることを確かめる
+ * (呼ばれ続けると時刻が進まないので終わらない)。MICROS モードの Timer を 40 分呼ばなかったとき
+ * (2^31 us を超える) に遅れとして数えることも確かめる。失敗があれば終了コード 1 を返す。
+ *
+ * このファイルは Clock.cpp より先にリンクするので、グローバルな Timer のコンストラクタが
+ * 既定の時刻の取得元 (VirtualClock) を Clock.cpp の静的初期化より先に使っても動くことも確かめる。
+ */
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include "Clock.h"
+#include "Scheduler.h"
+#include "Timer.h"
+
+namespace
+{
+
+VirtualClock simulatedClock;
+
+// Clock.cpp より先に構築される (既定の時刻の取得元が定数初期化されていないと落ちる)
+Timer startupTimer(100);
+
+uint32_t sensorCount = 0;
+uint32_t reportCount = 0;
+
+void readSensor(void*)
+{
+  sensorCount++;
+  // センサの読み出しに 300us かかるとする
+  simulatedClock.advanceMicros(300);
+}
+
+void report(void*)
+{
+  reportCount++;
+}
+
+SchedulerBase* rearmScheduler = nullptr;
+uint32_t rearmCount = 0;
+
+/* 次の run() でもう一度呼ばれるように登録し直す */
+void rearm(void*)
+{
+  rearmCount++;
+  rearmScheduler->after(0, rearm);
+}
+
+/* 簡単な線形合同法 (実行ごとに同じ結果にするため) */
+uint32_t nextRandom()
+{
+  static uint32_t state = 12345;
+  state = state * 1103515245UL + 12345UL;
+  return state >> 16;
+}
+
+}  // namespace
+
+int main()
+{
+  const bool startupOk = startupTimer.getPeriod() == 100 && startupTimer.getTimeToDeadline() == 100;
+  printf("global Timer       : period %u ms%s\n", startupTimer.getPeriod(), startupOk ? "" : "  FAIL");
+
+  Clock::use(&simulatedClock);
+
+  Scheduler<8> scheduler;
+  scheduler.every(20, readSensor);
+  scheduler.every(1000, report);
+
+  Timer control(1000, Timer::MICROS);
+  uint32_t controlCount = 0;
+
+  const uint64_t kDurationMicros = 3600ULL * 1000 * 1000;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while (simulatedClock.elapsedMicros() < kDurationMicros)
+  {
+    if (control.isDeadline())
+    {
+      controlCount++;
+      // 制御計算は通常 200〜800us、2% の確率で 2500us かかるとする (周期を超える)
+      simulatedClock.advanceMicros(nextRandom() % 100 < 2 ? 2500 : 200 + nextRandom() % 601);
+    }
+    scheduler.run();
+
+    // 次の実行時刻まで時刻を進める (実機ならスリープする時間)
+    const uint32_t idle = control.getTimeToDeadline();
+    simulatedClock.advanceMicros(idle > 0 ? idle : 1);
+  }
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  printf("simulated          : %.0f s\n", simulatedClock.elapsedMicros() / 1e6);
+  printf("wall clock         : %.3f s\n", std::chrono::duration<double>(end - start).count());
+  printf("control cycles     : %u\n", controlCount);
+  printf("missed cycles      : %u\n", control.getTotalMissedCycles());
+  printf("max lateness [us]  : %u\n", control.getMaxLateness());
+  printf("sensor task runs   : %u\n", sensorCount);
+  printf("report task runs   : %u\n", reportCount);
+
+  Scheduler<2> rearmTasks;
+  rearmScheduler = &rearmTasks;
+  rearmTasks.after(0, rearm);
+  const uint32_t idle = rearmTasks.run();
+  const uint32_t firstRuns = rearmCount;
+  simulatedClock.advanceMillis(1);
+  rearmTasks.run();
+  const bool rearmOk = firstRuns == 1 && idle == 1 && rearmCount == 2;
+  printf("re-armed task runs : %u in run(), idle %u ms, %u after 1 ms%s\n", firstRuns, idle, rearmCount - firstRuns,
+         rearmOk ? "" : "  FAIL");
+
+  // 2^31 us (約 35.8 分) を超えて呼ばなかった場合も、遅れとして間に合わなかった周期を数える
+  control.isDeadline();
+  simulatedClock.advanceMicros(control.getTimeToDeadline());
+  simulatedClock.setMicros(simulatedClock.elapsedMicros() + 40ULL * 60 * 1000 * 1000);
+  const bool lateFired = control.isDeadline();
+  const bool longGapOk = lateFired && control.getMissedCycles() == 40UL * 60 * 1000;
+  printf("40 min unpolled    : fired=%d, missed %u cycles%s\n", lateFired ? 1 : 0, control.getMissedCycles(),
+         longGapOk ? "" : "  FAIL");
+
+  Clock::use(nullptr);
+  return startupOk && rearmOk && longGapOk ? 0 : 1;
+}
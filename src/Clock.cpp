@@ -0,0 +1,41 @@
+/**
+ * @file Clock.cpp
+ * @brief 時刻の取得元を差し替えるためのクラス
+ * @author Tatsuya Miyazaki
+ */
+
+#include "Clock.h"
+
+namespace
+{
+
+// コンストラクタが constexpr なので定数初期化され、ほかの翻訳単位の静的初期化より先に使える
+#if __has_include(<Arduino.h>)
+ArduinoClock defaultClock;
+#else
+VirtualClock defaultClock;
+#endif
+
+Clock* currentClock = &defaultClock;
+
+}  // namespace
+
+/**
+ * @brief 現在の時刻の取得元を返す
+ *
+ * @return Clock& 時刻の取得元
+ */
+Clock& Clock::current(void)
+{
+  return *currentClock;
+}
+
+/**
+ * @brief 時刻の取得元を差し替える
+ *
+ * @param clock 時刻の取得元 (nullptr なら既定に戻す)。差し替えている間は破棄しないこと
+ */
+void Clock::use(Clock* clock)
+{
+  currentClock = clock != nullptr ? clock : &defaultClock;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file Clock.h
+ * @brief 時刻の取得元を差し替えるためのクラス
+ * @author Tatsuya Miyazaki
+ *
+ * @details Timer、Scheduler、TimedPatternPlayer、Log、MQTTClientESP32 などの
+ * 時間で動くクラスは millis() / micros() を直接呼ばず、Clock::nowMillis() /
+ * Clock::nowMicros() を使う。Clock::use() で VirtualClock に差し替えると、
+ * 時刻を手動で進められるので、ホスト上で実時間より速くシミュレーションしたり、
+ * 時間に依存する処理を決まった時刻で確かめたりできる。
+ *
+ * 既定の時刻の取得元は、Arduino 環境では ArduinoClock、それ以外
+ * (Arduino.h がないホスト) では 0 から始まる VirtualClock。
+ *
+ * @code
+ * VirtualClock clock;
+ * Clock::use(&clock);
+ * Timer timer(10);
+ * clock.advanceMillis(10);
+ * timer.isDeadline();  // true
+ * Clock::use(nullptr);  // 既定に戻す
+ * @endcode
+ */
+
+#pragma once
+
+#if __has_include(<Arduino.h>)
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief 時刻の取得元
+ */
+class Clock
+{
+public:
+  // 既定の時刻の取得元を定数初期化するため constexpr にする
+  // (ほかの翻訳単位のグローバルな Timer のコンストラクタから呼ばれても使えるように)
+  constexpr Clock() {}
+  virtual ~Clock() {}
+
+  /** 起動からの時間[ms] */
+  virtual uint32_t millis(void) = 0;
+  /** 起動からの時間[us] */
+  virtual uint32_t micros(void) = 0;
+
+  static Clock& current(void);
+  static void use(Clock* clock);
+
+  /** 現在の時刻の取得元での時間[ms] */
+  static uint32_t nowMillis(void) { return current().millis(); }
+  /** 現在の時刻の取得元での時間[us] */
+  static uint32_t nowMicros(void) { return current().micros(); }
+};
+
+#if __has_include(<Arduino.h>)
+/**
+ * @brief Arduino の millis() / micros() を使う時刻の取得元
+ */
+class ArduinoClock : public Clock
+{
+public:
+  constexpr ArduinoClock() {}
+
+  uint32_t millis(void) override { return ::millis(); }
+  uint32_t micros(void) override { return ::micros(); }
+};
+#endif
+
+/**
+ * @brief 手動で進める時刻の取得元
+ *
+ * 内部では 64 ビットの [us] で時刻を持ち、millis() と micros() は
+ * 実機と同じように 32 ビットで一周する。
+ */
+class VirtualClock : public Clock
+{
+public:
+  constexpr explicit VirtualClock(uint64_t startMicros = 0) : _micros(startMicros) {}
+
+  uint32_t millis(void) override { return (uint32_t)(_micros / 1000); }
+  uint32_t micros(void) override { return (uint32_t)_micros; }
+
+  /* 時刻を ms 進める */
+  void advanceMillis(uint32_t ms) { _micros += (uint64_t)ms * 1000; }
+  /* 時刻を us 進める */
+  void advanceMicros(uint32_t us) { _micros += us; }
+  /* 時刻を設定する[us] */
+  void setMicros(uint64_t us) { _micros = us; }
+  /* 起動からの時間[us] (一周しない) */
+  uint64_t elapsedMicros(void) const { return _micros; }
+
+private:
+  /** 起動からの時間[us] */
+  uint64_t _micros;
+};
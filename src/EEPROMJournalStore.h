@@ -0,0 +1,302 @@
+#ifndef EEPROM_JOURNAL_STORE_H
+#define EEPROM_JOURNAL_STORE_H
+
+#include "EEPROMStore.h"
+
+namespace EEPROMStoreUtil {
+
+/**
+ * @brief ジャーナル 1 レコード分のヘッダ。
+ *
+ * CRC はシーケンス番号と本体の両方を対象に計算する。
+ */
+struct JournalHeader {
+  uint16_t magic;
+  uint16_t crc;
+  uint32_t sequence;
+};
+
+/**
+ * @brief シーケンス番号 a が b より新しいか判定する。
+ *
+ * 32bit の周回を考慮し、差分の符号で判定する。
+ *
+ * @param a 比較するシーケンス番号
+ * @param b 基準のシーケンス番号
+ * @return true a の方が新しい場合
+ * @return false a が b と同じか古い場合
+ */
+constexpr bool isNewerSequence(uint32_t a, uint32_t b) {
+  return static_cast<int32_t>(a - b) > 0;
+}
+
+/**
+ * @brief ジャーナルレコードの CRC16 を計算する。
+ *
+ * @param sequence シーケンス番号
+ * @param payload 本体の先頭アドレス
+ * @param len 本体のバイト数
+ * @return uint16_t 計算結果
+ */
+inline uint16_t calcJournalCRC(uint32_t sequence, const uint8_t* payload,
+                               size_t len) {
+  CRC16Accumulator crc;
+  crc.update(&sequence, sizeof(sequence));
+  crc.update(payload, len);
+  return crc.finalize();
+}
+
+}  // namespace EEPROMStoreUtil
+
+/**
+ * @brief 構造体を複数スロットへ順番に書き込むウェアレベリング付きストア。
+ *
+ * 特徴:
+ *   - save() のたびに次のスロットへ (シーケンス番号, CRC, 本体) を追記する
+ *   - begin() で全スロットを走査し、CRC が正しい最新のレコードを復元する
+ *   - 本体を書き込んだ後にヘッダを書くため、書き込み途中で電源が切れても
+ *     直前に保存したレコードが残る
+ *   - バイト単位で書き換える EEPROM (AVR など) では書き込みが N スロットに分散し、
+ *     同じセルへの書き込み回数が 1/N になる
+ *
+ * ESP32/ESP8266 の EEPROM はフラッシュのエミュレーションで、commit() のたびに領域全体を
+ * 消去して書き直すため、スロットを増やしても消去回数は減らない (電源断への耐性だけが得られる)。
+ *
+ * 使い方:
+ *   struct Config {
+ *     uint16_t interval;
+ *     float threshold;
+ *   };
+ *
+ *   Config defaults = {1000, 25.5f};
+ *   EEPROMSession session(512);
+ *   EEPROMJournalStore<Config> store(session, 0, 8, defaults);
+ *
+ *   void setup() {
+ *     store.begin();
+ *     store.data.threshold = 30.0f;
+ *     store.save();
+ *   }
+ *
+ * begin() は全スロットの CRC を検証するため、処理時間はスロット数に比例する。
+ *
+ * スロットが 1 つでは直前のレコードを上書きしてしまい電源断に耐えられないため、
+ * スロット数は kMinSlotCount (2) 以上にする。満たさない場合 begin() は false を返し、
+ * EEPROM には何も書き込まない。
+ *
+ * @tparam T 保存対象の構造体
+ */
+template <typename T>
+class EEPROMJournalStore {
+ public:
+  /// 電源断に耐えるために必要な最小スロット数
+  static constexpr uint8_t kMinSlotCount = 2;
+
+  /// 読み書き対象のデータ本体
+  T data;
+
+  /**
+   * @brief 保存領域とデフォルト値を指定して初期化する。
+   *
+   * @param session 使用する EEPROM セッション
+   * @param address 保存領域の先頭アドレス
+   * @param slotCount スロット数(kMinSlotCount 以上)
+   * @param defaults 初期化時に使用するデフォルト値
+   * @param magic 保存領域を識別するマジック値
+   */
+  EEPROMJournalStore(const EEPROMSession& session, uint16_t address,
+                     uint8_t slotCount, const T& defaults,
+                     uint16_t magic = 0xBEEF)
+      : data(defaults),
+        _session(session),
+        _address(address),
+        _slotCount(slotCount),
+        _defaults(defaults),
+        _magic(magic),
+        _slot(0),
+        _sequence(0),
+        _crc(0),
+        _hasRecord(false) {}
+
+  /**
+   * @brief 最新のレコードを読み込み、無効ならデフォルト値で初期化する。
+   *
+   * @return true EEPROM から有効なレコードを読み込めた場合
+   * @return false デフォルト値で初期化した場合、またはスロット数が不足している場合
+   */
+  bool begin() {
+    if (!isValid() || !_session.begin()) {
+      return false;
+    }
+
+    if (load()) {
+      return true;
+    }
+
+    data = _defaults;
+    forceSave();
+    return false;
+  }
+
+  /**
+   * @brief 現在のデータを次のスロットへ保存する。
+   *
+   * @return true データが変更され、書き込みを行った場合
+   * @return false 変更がなく、書き込みを省略した場合
+   */
+  bool save() {
+    if (_hasRecord && dataCRC(_sequence) == _crc) {
+      return false;
+    }
+
+    append();
+    return true;
+  }
+
+  /**
+   * @brief 差分判定を行わずに現在のデータを次のスロットへ書き込む。
+   */
+  void forceSave() { append(); }
+
+  /**
+   * @brief データをデフォルト値へ戻して保存する。
+   */
+  void reset() {
+    data = _defaults;
+    forceSave();
+  }
+
+  /**
+   * @brief 1 スロットあたりのサイズを返す。
+   *
+   * @return uint16_t ヘッダと本体を含むサイズ
+   */
+  static constexpr uint16_t slotSize() {
+    return sizeof(EEPROMStoreUtil::JournalHeader) + sizeof(T);
+  }
+
+  /**
+   * @brief 指定したスロット数で必要な EEPROM サイズを返す。
+   *
+   * @param slotCount スロット数
+   * @return uint16_t 必要サイズ
+   */
+  static constexpr uint16_t requiredSize(uint8_t slotCount) {
+    return static_cast<uint16_t>(slotSize() * slotCount);
+  }
+
+  /**
+   * @brief 次のストアを配置できる先頭アドレスを返す。
+   *
+   * @return uint16_t 次の先頭アドレス
+   */
+  uint16_t nextAddress() const {
+    return static_cast<uint16_t>(_address + requiredSize(_slotCount));
+  }
+
+  /**
+   * @brief スロット数が電源断に耐える数(kMinSlotCount 以上)か判定する。
+   *
+   * @return true 使用できる場合
+   * @return false スロット数が不足している場合(書き込みは行わない)
+   */
+  bool isValid() const { return _slotCount >= kMinSlotCount; }
+
+  /**
+   * @brief 最新レコードが格納されているスロット番号を返す。
+   *
+   * @return uint8_t スロット番号
+   */
+  uint8_t currentSlot() const { return _slot; }
+
+  /**
+   * @brief 最新レコードのシーケンス番号を返す。
+   *
+   * @return uint32_t シーケンス番号
+   */
+  uint32_t sequence() const { return _sequence; }
+
+ private:
+  uint16_t slotAddress(uint8_t slot) const {
+    return static_cast<uint16_t>(_address + slotSize() * slot);
+  }
+
+  uint16_t dataCRC(uint32_t sequence) const {
+    return EEPROMStoreUtil::calcJournalCRC(
+        sequence, reinterpret_cast<const uint8_t*>(&data), sizeof(T));
+  }
+
+  void append() {
+    if (!isValid()) {
+      return;
+    }
+    const uint8_t slot =
+        _hasRecord ? static_cast<uint8_t>((_slot + 1) % _slotCount) : 0;
+    const uint32_t sequence = _sequence + 1;
+
+    EEPROMStoreUtil::JournalHeader header;
+    header.magic = _magic;
+    header.crc = dataCRC(sequence);
+    header.sequence = sequence;
+
+    // 本体を先に書き、ヘッダを最後に書く。途中で電源が切れた場合は
+    // このスロットの CRC が一致しなくなり、前回のレコードが最新として残る。
+    _session.put(static_cast<uint16_t>(slotAddress(slot) +
+                                       sizeof(EEPROMStoreUtil::JournalHeader)),
+                 data);
+    _session.put(slotAddress(slot), header);
+    _session.commit();
+
+    _slot = slot;
+    _sequence = sequence;
+    _crc = header.crc;
+    _hasRecord = true;
+  }
+
+  bool load() {
+    T temp;
+    _hasRecord = false;
+    for (uint8_t slot = 0; slot < _slotCount; slot++) {
+      EEPROMStoreUtil::JournalHeader header;
+      _session.get(slotAddress(slot), header);
+      if (header.magic != _magic) {
+        continue;
+      }
+      if (_hasRecord &&
+          !EEPROMStoreUtil::isNewerSequence(header.sequence, _sequence)) {
+        continue;
+      }
+
+      _session.get(static_cast<uint16_t>(
+                       slotAddress(slot) + sizeof(EEPROMStoreUtil::JournalHeader)),
+                   temp);
+      if (EEPROMStoreUtil::calcJournalCRC(
+              header.sequence, reinterpret_cast<const uint8_t*>(&temp),
+              sizeof(T)) != header.crc) {
+        continue;
+      }
+
+      data = temp;
+      _slot = slot;
+      _sequence = header.sequence;
+      _crc = header.crc;
+      _hasRecord = true;
+    }
+    return _hasRecord;
+  }
+
+  const EEPROMSession& _session;
+  uint16_t _address;
+  uint8_t _slotCount;
+  T _defaults;
+  uint16_t _magic;
+  uint8_t _slot;
+  uint32_t _sequence;
+  uint16_t _crc;
+  bool _hasRecord;
+};
+
+template <typename T>
+constexpr uint8_t EEPROMJournalStore<T>::kMinSlotCount;
+
+#endif  // EEPROM_JOURNAL_STORE_H
@@ -0,0 +1,291 @@
+#ifndef EEPROM_MMAP_BACKEND_H
+#define EEPROM_MMAP_BACKEND_H
+
+#include "EEPROMStore.h"
+
+#if !EEPROM_STORE_HAS_ARDUINO && __has_include(<sys/mman.h>)
+#define EEPROM_STORE_HAS_MMAP_BACKEND 1
+#else
+#define EEPROM_STORE_HAS_MMAP_BACKEND 0
+#endif
+
+#if EEPROM_STORE_HAS_MMAP_BACKEND
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+/**
+ * @brief ファイルをメモリマップして EEPROM を再現するホスト用バックエンド。
+ *
+ * ESP32 / ESP8266 のフラッシュエミュレーションと同じく、書き込みは RAM 上の
+ * キャッシュに対して行い、commit() で変更のあったセクタだけを消去・再書き込み
+ * する。書き込んだバイト数とセクタごとの消去回数を記録するため、
+ * 保存処理の書き込み量やフラッシュ寿命の見積もりに使える。
+ *
+ * 使い方:
+ *   EEPROMMmapBackend backend("eeprom.bin");
+ *   EEPROMStore<Config> store(backend, 0, defaults);
+ *
+ *   store.begin();
+ *   store.save();
+ *   printf("%lu bytes, %lu erases\n",
+ *          static_cast<unsigned long>(backend.bytesWritten()),
+ *          static_cast<unsigned long>(backend.eraseCount()));
+ *
+ * ファイルが存在しない場合は消去済み(0xFF)の状態で作成する。
+ */
+class EEPROMMmapBackend : public EEPROMBackend {
+ public:
+  /**
+   * @brief 保存先ファイルとセクタサイズを指定して初期化する。
+   *
+   * @param path 保存先ファイルのパス
+   * @param sectorSize 消去単位のバイト数。1 を指定するとバイト単位で書き換える
+   *                   EEPROM (AVR など) に近い動作になる
+   */
+  explicit EEPROMMmapBackend(const char* path, uint16_t sectorSize = 4096)
+      : _path(path),
+        _sectorSize(sectorSize == 0 ? 1 : sectorSize),
+        _fd(-1),
+        _flash(nullptr),
+        _mappedSize(0),
+        _size(0),
+        _bytesWritten(0),
+        _eraseCount(0),
+        _commitCount(0) {}
+
+  ~EEPROMMmapBackend() override { end(); }
+
+  EEPROMMmapBackend(const EEPROMMmapBackend&) = delete;
+  EEPROMMmapBackend& operator=(const EEPROMMmapBackend&) = delete;
+
+  /**
+   * @brief ファイルを開いてメモリマップする。
+   *
+   * @param size 使用するサイズ
+   * @return true 成功した場合
+   * @return false ファイルを開けなかった場合
+   */
+  bool begin(uint16_t size) override {
+    if (_flash != nullptr) {
+      if (size == _size) {
+        return true;
+      }
+      end();
+    }
+
+    _fd = open(_path, O_RDWR | O_CREAT, 0644);
+    if (_fd < 0) {
+      return false;
+    }
+
+    struct stat status;
+    if (fstat(_fd, &status) != 0) {
+      closeFile();
+      return false;
+    }
+
+    const size_t mappedSize = roundUpToSector(size);
+    const size_t fileSize = static_cast<size_t>(status.st_size);
+    if (fileSize < mappedSize &&
+        ftruncate(_fd, static_cast<off_t>(mappedSize)) != 0) {
+      closeFile();
+      return false;
+    }
+
+    void* mapped =
+        mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (mapped == MAP_FAILED) {
+      closeFile();
+      return false;
+    }
+
+    _flash = static_cast<uint8_t*>(mapped);
+    _mappedSize = mappedSize;
+    _size = size;
+    if (fileSize < mappedSize) {
+      // 新しく確保した領域は消去済みの状態にする
+      memset(_flash + fileSize, 0xFF, mappedSize - fileSize);
+    }
+    _cache.assign(_flash, _flash + mappedSize);
+    _sectorErases.assign(mappedSize / _sectorSize, 0);
+    return true;
+  }
+
+  /**
+   * @brief 未確定の書き込みを確定してファイルを閉じる。
+   */
+  void end() override {
+    if (_flash == nullptr) {
+      return;
+    }
+    commit();
+    munmap(_flash, _mappedSize);
+    _flash = nullptr;
+    _mappedSize = 0;
+    _size = 0;
+    closeFile();
+  }
+
+  uint8_t read(uint16_t address) override {
+    return clip(address, 1) > 0 ? _cache[address] : 0xFF;
+  }
+
+  void write(uint16_t address, uint8_t value) override {
+    if (clip(address, 1) > 0) {
+      _cache[address] = value;
+    }
+  }
+
+  void readBytes(uint16_t address, uint8_t* data, size_t length) override {
+    const size_t available = clip(address, length);
+    if (available > 0) {
+      memcpy(data, _cache.data() + address, available);
+    }
+    memset(data + available, 0xFF, length - available);
+  }
+
+  void writeBytes(uint16_t address, const uint8_t* data,
+                  size_t length) override {
+    const size_t available = clip(address, length);
+    if (available > 0) {
+      memcpy(_cache.data() + address, data, available);
+    }
+  }
+
+  /**
+   * @brief 変更のあったセクタを消去して書き込む。
+   *
+   * @return true 成功した場合
+   * @return false 開いていない場合、またはファイルへの同期に失敗した場合
+   */
+  bool commit() override {
+    if (_flash == nullptr) {
+      return false;
+    }
+
+    _commitCount++;
+    bool changed = false;
+    for (size_t sector = 0; sector < _sectorErases.size(); sector++) {
+      const size_t offset = sector * _sectorSize;
+      if (memcmp(_flash + offset, _cache.data() + offset, _sectorSize) == 0) {
+        continue;
+      }
+      memcpy(_flash + offset, _cache.data() + offset, _sectorSize);
+      _sectorErases[sector]++;
+      _eraseCount++;
+      _bytesWritten += _sectorSize;
+      changed = true;
+    }
+
+    if (!changed) {
+      return true;
+    }
+    return msync(_flash, _mappedSize, MS_SYNC) == 0;
+  }
+
+  /**
+   * @brief フラッシュへ書き込んだ総バイト数を返す。
+   *
+   * @return uint64_t 書き込みバイト数（消去したセクタ全体を含む）
+   */
+  uint64_t bytesWritten() const { return _bytesWritten; }
+
+  /**
+   * @brief 全セクタの消去回数の合計を返す。
+   *
+   * @return uint64_t 消去回数
+   */
+  uint64_t eraseCount() const { return _eraseCount; }
+
+  /**
+   * @brief 指定セクタの消去回数を返す。
+   *
+   * @param sector セクタ番号
+   * @return uint32_t 消去回数
+   */
+  uint32_t eraseCount(size_t sector) const {
+    return sector < _sectorErases.size() ? _sectorErases[sector] : 0;
+  }
+
+  /**
+   * @brief 最も多く消去されたセクタの消去回数を返す。
+   *
+   * @return uint32_t 消去回数
+   */
+  uint32_t maxEraseCount() const {
+    uint32_t maxCount = 0;
+    for (size_t sector = 0; sector < _sectorErases.size(); sector++) {
+      if (_sectorErases[sector] > maxCount) {
+        maxCount = _sectorErases[sector];
+      }
+    }
+    return maxCount;
+  }
+
+  /**
+   * @brief commit() の呼び出し回数を返す。
+   *
+   * @return uint64_t 呼び出し回数
+   */
+  uint64_t commitCount() const { return _commitCount; }
+
+  /**
+   * @brief セクタ数を返す。
+   *
+   * @return size_t セクタ数
+   */
+  size_t sectorCount() const { return _sectorErases.size(); }
+
+  /**
+   * @brief 統計値をすべて 0 に戻す。
+   */
+  void resetStatistics() {
+    _bytesWritten = 0;
+    _eraseCount = 0;
+    _commitCount = 0;
+    _sectorErases.assign(_sectorErases.size(), 0);
+  }
+
+ private:
+  size_t roundUpToSector(size_t size) const {
+    const size_t sectors = (size + _sectorSize - 1) / _sectorSize;
+    return (sectors == 0 ? 1 : sectors) * _sectorSize;
+  }
+
+  // 開いていない間は常に 0 を返す
+  size_t clip(uint16_t address, size_t length) const {
+    if (_flash == nullptr || address >= _size) {
+      return 0;
+    }
+    return length < static_cast<size_t>(_size - address) ? length
+                                                          : _size - address;
+  }
+
+  void closeFile() {
+    if (_fd >= 0) {
+      close(_fd);
+      _fd = -1;
+    }
+  }
+
+  const char* _path;
+  size_t _sectorSize;
+  int _fd;
+  uint8_t* _flash;
+  size_t _mappedSize;
+  uint16_t _size;
+  std::vector<uint8_t> _cache;
+  std::vector<uint32_t> _sectorErases;
+  uint64_t _bytesWritten;
+  uint64_t _eraseCount;
+  uint64_t _commitCount;
+};
+
+#endif  // EEPROM_STORE_HAS_MMAP_BACKEND
+
+#endif  // EEPROM_MMAP_BACKEND_H
@@ -0,0 +1,122 @@
+#ifndef EEPROM_POWER_CUT_SIMULATOR_H
+#define EEPROM_POWER_CUT_SIMULATOR_H
+
+#include "EEPROMStore.h"
+
+/**
+ * @brief 書き込み途中の電源断を再現する RAM 上の EEPROM バックエンド。
+ *
+ * EEPROMSession に渡して EEPROMStore や EEPROMJournalStore をホスト上で
+ * 動作確認できる。書き込みは 1 バイト単位で即座に反映され、
+ * cutPowerAfter() で指定したバイト数を書き込んだ時点で以降の書き込みが失われる。
+ *
+ * 使い方:
+ *   EEPROMPowerCutSimulator<512> eeprom;
+ *   EEPROMSession session(512, eeprom);
+ *   EEPROMJournalStore<Config> store(session, 0, 4, defaults);
+ *
+ *   store.begin();
+ *   store.data.value = 1;
+ *   eeprom.cutPowerAfter(3);  // 3 バイト書いたところで電源断
+ *   store.save();
+ *   eeprom.powerCycle();      // 再起動
+ *   store.begin();            // 電源断前のレコードが読み込まれる
+ *
+ * @tparam Size EEPROM サイズ
+ */
+template <uint16_t Size>
+class EEPROMPowerCutSimulator : public EEPROMBackend {
+ public:
+  /**
+   * @brief 消去済み(0xFF)の状態で初期化する。
+   */
+  EEPROMPowerCutSimulator()
+      : _writeBudget(0), _cutScheduled(false), _bytesWritten(0) {
+    erase();
+  }
+
+  bool begin(uint16_t size) override { return size <= Size; }
+  void end() override {}
+
+  uint8_t read(uint16_t address) override {
+    return address < Size ? _memory[address] : 0xFF;
+  }
+
+  /**
+   * @brief 1 バイト書き込む。電源断後の書き込みは捨てられる。
+   *
+   * @param address 書き込み先アドレス
+   * @param value 書き込む値
+   */
+  void write(uint16_t address, uint8_t value) override {
+    if (isPoweredOff() || address >= Size) {
+      return;
+    }
+    if (_cutScheduled) {
+      _writeBudget--;
+    }
+    _memory[address] = value;
+    _bytesWritten++;
+  }
+
+  /**
+   * @brief 書き込みを確定する。電源断後は失敗する。
+   *
+   * @return true 確定に成功した場合
+   * @return false 電源断中の場合
+   */
+  bool commit() override { return !isPoweredOff(); }
+
+  /**
+   * @brief 指定したバイト数を書き込んだ時点で電源断を発生させる。
+   *
+   * @param bytes 電源断までに書き込めるバイト数
+   */
+  void cutPowerAfter(size_t bytes) {
+    _writeBudget = bytes;
+    _cutScheduled = true;
+  }
+
+  /**
+   * @brief 電源断状態を解除する。書き込み済みの内容は保持される。
+   */
+  void powerCycle() {
+    _cutScheduled = false;
+    _writeBudget = 0;
+  }
+
+  /**
+   * @brief 電源断中か判定する。
+   *
+   * @return true 電源断中の場合
+   * @return false 書き込み可能な場合
+   */
+  bool isPoweredOff() const { return _cutScheduled && _writeBudget == 0; }
+
+  /**
+   * @brief 全体を消去済み(0xFF)に戻す。
+   */
+  void erase() { memset(_memory, 0xFF, sizeof(_memory)); }
+
+  /**
+   * @brief これまでに書き込んだバイト数を返す。
+   *
+   * @return size_t 書き込みバイト数
+   */
+  size_t bytesWritten() const { return _bytesWritten; }
+
+  /**
+   * @brief 内部メモリを返す。任意のバイトを破損させる確認などに使う。
+   *
+   * @return uint8_t* 内部メモリの先頭アドレス
+   */
+  uint8_t* memory() { return _memory; }
+
+ private:
+  uint8_t _memory[Size];
+  size_t _writeBudget;
+  bool _cutScheduled;
+  size_t _bytesWritten;
+};
+
+#endif  // EEPROM_POWER_CUT_SIMULATOR_H
@@ -0,0 +1,346 @@
+#ifndef EEPROM_REGISTRY_H
+#define EEPROM_REGISTRY_H
+
+#include "EEPROMStore.h"
+
+namespace EEPROMStoreUtil {
+
+/**
+ * @brief EEPROMRegistry の 1 レコード分を保持するノード。
+ *
+ * 先頭アドレスをテンプレート引数で受け取り、次のノードのアドレスを
+ * コンパイル時に計算して再帰的に連結する。アドレスは size_t で計算し、
+ * uint16_t に収まるかは EEPROMRegistryAt で検査する。
+ *
+ * @tparam Address このレコードの先頭アドレス
+ * @tparam Alignment レコード先頭の境界
+ * @tparam Ts このレコード以降の構造体
+ */
+template <size_t Address, uint16_t Alignment, typename... Ts>
+struct RegistryNode;
+
+template <size_t Address, uint16_t Alignment>
+struct RegistryNode<Address, Alignment> {
+  static constexpr size_t kEndAddress = Address;
+
+  bool load(const EEPROMSession&, uint16_t, size_t&) { return true; }
+  size_t save(const EEPROMSession&, uint16_t, bool) { return 0; }
+  void reset() {}
+};
+
+template <size_t Address, uint16_t Alignment, typename T, typename... Rest>
+struct RegistryNode<Address, Alignment, T, Rest...> {
+  typedef T Value;
+  static constexpr uint16_t kAddress = static_cast<uint16_t>(Address);
+  static constexpr size_t kSize = sizeof(RecordHeader) + sizeof(T);
+  typedef RegistryNode<(Address + kSize + Alignment - 1) / Alignment *
+                           Alignment,
+                       Alignment, Rest...>
+      Next;
+  static constexpr size_t kEndAddress = Next::kEndAddress;
+
+  RegistryNode(const T& defaultValue, const Rest&... rest)
+      : data(defaultValue), defaults(defaultValue), crc(0), next(rest...) {}
+
+  /**
+   * @brief 自分以降のレコードを読み込み、無効なものをデフォルト値で書き込む。
+   *
+   * commit() は呼ばない。
+   *
+   * @param session 使用する EEPROM セッション
+   * @param magic 保存領域を識別するマジック値
+   * @param written 書き込んだレコード数の加算先
+   * @return true すべて読み込めた場合
+   * @return false デフォルト値で初期化したレコードがある場合
+   */
+  bool load(const EEPROMSession& session, uint16_t magic, size_t& written) {
+    RecordHeader header;
+    session.get(kAddress, header);
+    session.get(static_cast<uint16_t>(kAddress + sizeof(RecordHeader)), data);
+    crc = calcCRC(reinterpret_cast<const uint8_t*>(&data), sizeof(T));
+
+    bool loaded = header.magic == magic && header.crc == crc;
+    if (!loaded) {
+      data = defaults;
+      write(session, magic);
+      written++;
+    }
+    return next.load(session, magic, written) && loaded;
+  }
+
+  /**
+   * @brief 自分以降で変更のあったレコードを書き込む。commit() は呼ばない。
+   *
+   * @param session 使用する EEPROM セッション
+   * @param magic 保存領域を識別するマジック値
+   * @param force true の場合は変更がなくても書き込む
+   * @return size_t 書き込んだレコード数
+   */
+  size_t save(const EEPROMSession& session, uint16_t magic, bool force) {
+    size_t written = 0;
+    if (force ||
+        calcCRC(reinterpret_cast<const uint8_t*>(&data), sizeof(T)) != crc) {
+      write(session, magic);
+      written = 1;
+    }
+    return written + next.save(session, magic, force);
+  }
+
+  /**
+   * @brief このレコードだけを書き込む。commit() は呼ばない。
+   *
+   * @param session 使用する EEPROM セッション
+   * @param magic 保存領域を識別するマジック値
+   */
+  void write(const EEPROMSession& session, uint16_t magic) {
+    RecordHeader header;
+    header.magic = magic;
+    header.crc = calcCRC(reinterpret_cast<const uint8_t*>(&data), sizeof(T));
+    session.put(kAddress, header);
+    session.put(static_cast<uint16_t>(kAddress + sizeof(RecordHeader)), data);
+    crc = header.crc;
+  }
+
+  /**
+   * @brief 自分以降のレコードをデフォルト値へ戻す。
+   */
+  void reset() {
+    data = defaults;
+    next.reset();
+  }
+
+  T data;
+  T defaults;
+  /** 最後に EEPROM と同期した内容の CRC */
+  uint16_t crc;
+  Next next;
+};
+
+/**
+ * @brief I 番目のノードを取り出す。
+ */
+template <size_t I, typename Node>
+struct RegistryNodeAt {
+  typedef RegistryNodeAt<I - 1, typename Node::Next> Inner;
+  typedef typename Inner::Type Type;
+
+  static Type& get(Node& node) { return Inner::get(node.next); }
+  static const Type& get(const Node& node) { return Inner::get(node.next); }
+};
+
+template <typename Node>
+struct RegistryNodeAt<0, Node> {
+  typedef Node Type;
+
+  static Type& get(Node& node) { return node; }
+  static const Type& get(const Node& node) { return node; }
+};
+
+}  // namespace EEPROMStoreUtil
+
+/**
+ * @brief 複数の構造体を 1 つの EEPROM セッションでまとめて保存するクラス。
+ *
+ * 特徴:
+ *   - 各構造体の保存先アドレスをコンパイル時に計算し、重ならないように配置する
+ *   - 各レコードの先頭を Alignment バイト境界に揃える
+ *   - begin() は EEPROM の初期化を 1 回だけ行う
+ *   - save() は変更のあったレコードだけを書き込み、commit() を 1 回だけ呼ぶ
+ *   - 各レコードは EEPROMStore と同じ形式(マジック値, CRC, 本体)で保存する
+ *
+ * 使い方:
+ *   EEPROMRegistry<SensorConfig, NetworkConfig> registry(sensorDefaults,
+ *                                                        networkDefaults);
+ *
+ *   void setup() {
+ *     registry.begin();
+ *     registry.get<0>().tempThreshold = 30.0f;
+ *     registry.get<1>().port = 8081;
+ *     registry.save();  // 2 レコードを書き込み、commit() は 1 回
+ *   }
+ *
+ * 保存先アドレスは address<I>() で、全体のサイズは requiredSize() で取得できる。
+ * 最後のレコードの終わりが 16 bit のアドレスに収まらない場合はコンパイルエラーになる。
+ *
+ * @tparam BaseAddress 先頭レコードのアドレス
+ * @tparam Alignment レコード先頭の境界(1 以上)
+ * @tparam Magic 保存領域を識別するマジック値
+ * @tparam Ts 保存する構造体
+ */
+template <uint16_t BaseAddress, uint16_t Alignment, uint16_t Magic,
+          typename... Ts>
+class EEPROMRegistryAt {
+  static_assert(Alignment > 0, "alignment must be at least 1");
+  typedef EEPROMStoreUtil::RegistryNode<BaseAddress, Alignment, Ts...> Records;
+  static_assert(Records::kEndAddress <= 0xFFFF,
+                "records must fit in the 16-bit EEPROM address space");
+
+ public:
+#if EEPROM_STORE_HAS_BACKEND
+  /**
+   * @brief 各構造体のデフォルト値を指定して初期化する。
+   *
+   * @param defaults 各構造体のデフォルト値(Ts と同じ順番)
+   */
+  explicit EEPROMRegistryAt(const Ts&... defaults)
+      : _records(defaults...),
+        _session(endAddress()),
+        _commitCount(0) {}
+#endif
+
+  /**
+   * @brief 読み書き先のバックエンドと各構造体のデフォルト値を指定して初期化する。
+   *
+   * @param backend 読み書き先のバックエンド
+   * @param defaults 各構造体のデフォルト値(Ts と同じ順番)
+   */
+  explicit EEPROMRegistryAt(EEPROMBackend& backend, const Ts&... defaults)
+      : _records(defaults...),
+        _session(endAddress(), backend),
+        _commitCount(0) {}
+
+  /**
+   * @brief EEPROM を初期化し、すべてのレコードを読み込む。
+   *
+   * 無効なレコードはデフォルト値で初期化し、最後にまとめて commit() する。
+   *
+   * @return true すべてのレコードを読み込めた場合
+   * @return false 初期化に失敗した、またはデフォルト値で初期化したレコードがある場合
+   */
+  bool begin() {
+    if (!_session.begin()) {
+      return false;
+    }
+
+    size_t written = 0;
+    const bool loaded = _records.load(_session, Magic, written);
+    if (written > 0) {
+      commit();
+    }
+    return loaded;
+  }
+
+  /**
+   * @brief 変更のあったレコードを書き込み、まとめて commit() する。
+   *
+   * @return size_t 書き込んだレコード数。0 の場合は commit() しない
+   */
+  size_t save() {
+    const size_t written = _records.save(_session, Magic, false);
+    if (written > 0) {
+      commit();
+    }
+    return written;
+  }
+
+  /**
+   * @brief すべてのレコードをデフォルト値へ戻して保存する。
+   */
+  void reset() {
+    _records.reset();
+    saveAll();
+  }
+
+  /**
+   * @brief 差分判定を行わずにすべてのレコードを書き込む。
+   */
+  void saveAll() {
+    _records.save(_session, Magic, true);
+    commit();
+  }
+
+  template <size_t I>
+  /**
+   * @brief I 番目の構造体を返す。
+   *
+   * @tparam I 構造体の番号(Ts の順番)
+   * @return I 番目の構造体への参照
+   */
+  typename EEPROMStoreUtil::RegistryNodeAt<I, Records>::Type::Value& get() {
+    return EEPROMStoreUtil::RegistryNodeAt<I, Records>::get(_records).data;
+  }
+
+  template <size_t I>
+  const typename EEPROMStoreUtil::RegistryNodeAt<I, Records>::Type::Value& get()
+      const {
+    return EEPROMStoreUtil::RegistryNodeAt<I, Records>::get(_records).data;
+  }
+
+  template <size_t I>
+  /**
+   * @brief I 番目の構造体の保存先アドレスを返す。
+   *
+   * @tparam I 構造体の番号(Ts の順番)
+   * @return uint16_t 保存先アドレス
+   */
+  static constexpr uint16_t address() {
+    return EEPROMStoreUtil::RegistryNodeAt<I, Records>::Type::kAddress;
+  }
+
+  /**
+   * @brief 登録した構造体の数を返す。
+   *
+   * @return size_t 構造体の数
+   */
+  static constexpr size_t count() { return sizeof...(Ts); }
+
+  /**
+   * @brief 最後のレコードの次のアドレスを返す。
+   *
+   * @return uint16_t 次の先頭アドレス
+   */
+  static constexpr uint16_t endAddress() {
+    return static_cast<uint16_t>(Records::kEndAddress);
+  }
+
+  /**
+   * @brief 保存領域を識別するマジック値を返す。
+   *
+   * @return uint16_t マジック値
+   */
+  static constexpr uint16_t magic() { return Magic; }
+
+  /**
+   * @brief すべてのレコードが必要とする EEPROM サイズを返す。
+   *
+   * @return uint16_t 必要サイズ
+   */
+  static constexpr uint16_t requiredSize() {
+    return static_cast<uint16_t>(endAddress() - BaseAddress);
+  }
+
+  /**
+   * @brief これまでに commit() した回数を返す。
+   *
+   * @return uint32_t commit() 回数
+   */
+  uint32_t commitCount() const { return _commitCount; }
+
+  /**
+   * @brief 共有している EEPROM セッションを返す。
+   *
+   * @return const EEPROMSession& EEPROM セッション
+   */
+  const EEPROMSession& session() const { return _session; }
+
+ private:
+  void commit() {
+    _session.commit();
+    _commitCount++;
+  }
+
+  Records _records;
+  EEPROMSession _session;
+  uint32_t _commitCount;
+};
+
+/**
+ * @brief アドレス 0 から 4 バイト境界で配置し、EEPROMStore と同じマジック値
+ * (0xBEEF)を使う EEPROMRegistryAt。
+ *
+ * @tparam Ts 保存する構造体
+ */
+template <typename... Ts>
+using EEPROMRegistry = EEPROMRegistryAt<0, 4, 0xBEEF, Ts...>;
+
+#endif  // EEPROM_REGISTRY_H
@@ -20,26 +20,247 @@
 #define EEPROM_STORE_HAS_BACKEND 0
 #endif
 
+/** CRC16 をビット単位で計算する（テーブル不要、最も遅い） */
+#define EEPROM_STORE_CRC_BITWISE 0
+/** CRC16 を 16 エントリのニブルテーブルで計算する（32 バイト） */
+#define EEPROM_STORE_CRC_NIBBLE 1
+/** CRC16 を 256 エントリのバイトテーブルで計算する（512 バイト） */
+#define EEPROM_STORE_CRC_TABLE256 2
+
+#ifndef EEPROM_STORE_CRC_MODE
+// RAM の少ない AVR ではニブルテーブル、それ以外はバイトテーブルを既定にする
+#if defined(__AVR__)
+#define EEPROM_STORE_CRC_MODE EEPROM_STORE_CRC_NIBBLE
+#else
+#define EEPROM_STORE_CRC_MODE EEPROM_STORE_CRC_TABLE256
+#endif
+#endif
+
 namespace EEPROMStoreUtil {
 
+/** CRC16-CCITT の生成多項式 */
+constexpr uint16_t kCRC16Polynomial = 0x1021;
+/** CRC16-CCITT の初期値 */
+constexpr uint16_t kCRC16Init = 0xFFFF;
+
 /**
- * @brief バイト列から CRC16-CCITT を計算する。
+ * @brief CRC レジスタを指定ビット数だけシフトする。
  *
+ * @param crc CRC レジスタ値
+ * @param count シフトするビット数
+ * @return uint16_t シフト後の CRC レジスタ値
+ */
+constexpr uint16_t crc16Shift(uint16_t crc, uint8_t count) {
+  return count == 0
+             ? crc
+             : crc16Shift(static_cast<uint16_t>(
+                              (crc & 0x8000) ? (crc << 1) ^ kCRC16Polynomial
+                                             : crc << 1),
+                          static_cast<uint8_t>(count - 1));
+}
+
+/**
+ * @brief バイトテーブルの 1 エントリを計算する。
+ *
+ * @param index テーブルのインデックス(0-255)
+ * @return uint16_t テーブル値
+ */
+constexpr uint16_t crc16ByteEntry(uint16_t index) {
+  return crc16Shift(static_cast<uint16_t>(index << 8), 8);
+}
+
+/**
+ * @brief ニブルテーブルの 1 エントリを計算する。
+ *
+ * @param index テーブルのインデックス(0-15)
+ * @return uint16_t テーブル値
+ */
+constexpr uint16_t crc16NibbleEntry(uint16_t index) {
+  return crc16Shift(static_cast<uint16_t>(index << 12), 4);
+}
+
+#define EEPROM_STORE_CRC_BYTE4(n)                                      \
+  crc16ByteEntry(n), crc16ByteEntry(n + 1), crc16ByteEntry(n + 2), \
+      crc16ByteEntry(n + 3)
+#define EEPROM_STORE_CRC_BYTE16(n)                                   \
+  EEPROM_STORE_CRC_BYTE4(n), EEPROM_STORE_CRC_BYTE4(n + 4),          \
+      EEPROM_STORE_CRC_BYTE4(n + 8), EEPROM_STORE_CRC_BYTE4(n + 12)
+#define EEPROM_STORE_CRC_BYTE64(n)                                   \
+  EEPROM_STORE_CRC_BYTE16(n), EEPROM_STORE_CRC_BYTE16(n + 16),       \
+      EEPROM_STORE_CRC_BYTE16(n + 32), EEPROM_STORE_CRC_BYTE16(n + 48)
+
+/**
+ * @brief コンパイル時に生成する CRC16 テーブル。
+ *
+ * ヘッダのみで定義を完結させるため、テンプレートの静的メンバとして持つ。
+ */
+template <typename Dummy = void>
+struct CRC16Tables {
+  /** 1 バイト単位で引くテーブル */
+  static constexpr uint16_t byteTable[256] = {
+      EEPROM_STORE_CRC_BYTE64(0), EEPROM_STORE_CRC_BYTE64(64),
+      EEPROM_STORE_CRC_BYTE64(128), EEPROM_STORE_CRC_BYTE64(192)};
+  /** 4 ビット単位で引くテーブル */
+  static constexpr uint16_t nibbleTable[16] = {
+      crc16NibbleEntry(0),  crc16NibbleEntry(1),  crc16NibbleEntry(2),
+      crc16NibbleEntry(3),  crc16NibbleEntry(4),  crc16NibbleEntry(5),
+      crc16NibbleEntry(6),  crc16NibbleEntry(7),  crc16NibbleEntry(8),
+      crc16NibbleEntry(9),  crc16NibbleEntry(10), crc16NibbleEntry(11),
+      crc16NibbleEntry(12), crc16NibbleEntry(13), crc16NibbleEntry(14),
+      crc16NibbleEntry(15)};
+};
+
+template <typename Dummy>
+constexpr uint16_t CRC16Tables<Dummy>::byteTable[256];
+template <typename Dummy>
+constexpr uint16_t CRC16Tables<Dummy>::nibbleTable[16];
+
+#undef EEPROM_STORE_CRC_BYTE64
+#undef EEPROM_STORE_CRC_BYTE16
+#undef EEPROM_STORE_CRC_BYTE4
+
+/**
+ * @brief ビット単位の計算で CRC16-CCITT を更新する。
+ *
+ * @param crc 途中までの CRC 値
  * @param data 計算対象の先頭アドレス
  * @param len 計算対象のバイト数
- * @return uint16_t 計算結果
+ * @return uint16_t 更新後の CRC 値
  */
-inline uint16_t calcCRC(const uint8_t* data, size_t len) {
-  uint16_t crc = 0xFFFF;
+inline uint16_t updateCRCBitwise(uint16_t crc, const uint8_t* data,
+                                 size_t len) {
   for (size_t i = 0; i < len; i++) {
     crc ^= static_cast<uint16_t>(data[i]) << 8;
     for (uint8_t bit = 0; bit < 8; bit++) {
-      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      crc = (crc & 0x8000) ? (crc << 1) ^ kCRC16Polynomial : crc << 1;
     }
   }
   return crc;
 }
 
+/**
+ * @brief ニブルテーブルで CRC16-CCITT を更新する。
+ *
+ * @param crc 途中までの CRC 値
+ * @param data 計算対象の先頭アドレス
+ * @param len 計算対象のバイト数
+ * @return uint16_t 更新後の CRC 値
+ */
+inline uint16_t updateCRCNibble(uint16_t crc, const uint8_t* data,
+                                size_t len) {
+  const uint16_t* table = CRC16Tables<>::nibbleTable;
+  for (size_t i = 0; i < len; i++) {
+    crc = static_cast<uint16_t>((crc << 4) ^
+                                table[(crc >> 12) ^ (data[i] >> 4)]);
+    crc = static_cast<uint16_t>((crc << 4) ^
+                                table[(crc >> 12) ^ (data[i] & 0x0F)]);
+  }
+  return crc;
+}
+
+/**
+ * @brief バイトテーブルで CRC16-CCITT を更新する。
+ *
+ * @param crc 途中までの CRC 値
+ * @param data 計算対象の先頭アドレス
+ * @param len 計算対象のバイト数
+ * @return uint16_t 更新後の CRC 値
+ */
+inline uint16_t updateCRCTable(uint16_t crc, const uint8_t* data, size_t len) {
+  const uint16_t* table = CRC16Tables<>::byteTable;
+  for (size_t i = 0; i < len; i++) {
+    crc = static_cast<uint16_t>((crc << 8) ^ table[(crc >> 8) ^ data[i]]);
+  }
+  return crc;
+}
+
+/**
+ * @brief EEPROM_STORE_CRC_MODE で選択した方式で CRC16-CCITT を更新する。
+ *
+ * @param crc 途中までの CRC 値
+ * @param data 計算対象の先頭アドレス
+ * @param len 計算対象のバイト数
+ * @return uint16_t 更新後の CRC 値
+ */
+inline uint16_t updateCRC(uint16_t crc, const uint8_t* data, size_t len) {
+#if EEPROM_STORE_CRC_MODE == EEPROM_STORE_CRC_BITWISE
+  return updateCRCBitwise(crc, data, len);
+#elif EEPROM_STORE_CRC_MODE == EEPROM_STORE_CRC_NIBBLE
+  return updateCRCNibble(crc, data, len);
+#else
+  return updateCRCTable(crc, data, len);
+#endif
+}
+
+/**
+ * @brief バイト列から CRC16-CCITT を計算する。
+ *
+ * @param data 計算対象の先頭アドレス
+ * @param len 計算対象のバイト数
+ * @return uint16_t 計算結果
+ */
+inline uint16_t calcCRC(const uint8_t* data, size_t len) {
+  return updateCRC(kCRC16Init, data, len);
+}
+
+/**
+ * @brief CRC16-CCITT を分割したデータから逐次計算するクラス。
+ *
+ * 使い方:
+ *   EEPROMStoreUtil::CRC16Accumulator crc;
+ *   crc.update(header, sizeof(header));
+ *   crc.update(body, sizeof(body));
+ *   uint16_t value = crc.finalize();
+ *
+ * 一括で calcCRC() した場合と同じ値になる。
+ */
+class CRC16Accumulator {
+ public:
+  CRC16Accumulator() : _crc(kCRC16Init) {}
+
+  /**
+   * @brief 計算途中の値を初期値へ戻す。
+   */
+  void init() { _crc = kCRC16Init; }
+
+  /**
+   * @brief バイト列を計算に追加する。
+   *
+   * @param data 追加するデータ
+   * @param len 追加するバイト数
+   */
+  void update(const void* data, size_t len) {
+    _crc = updateCRC(_crc, static_cast<const uint8_t*>(data), len);
+  }
+
+  /**
+   * @brief 1 バイトを計算に追加する。
+   *
+   * @param value 追加する値
+   */
+  void update(uint8_t value) { _crc = updateCRC(_crc, &value, 1); }
+
+  /**
+   * @brief 計算結果を返す。
+   *
+   * 内部状態は変更しないため、続けて update() することもできる。
+   *
+   * @return uint16_t 計算結果
+   */
+  uint16_t finalize() const { return _crc; }
+
+ private:
+  uint16_t _crc;
+};
+
+/**
+ * @brief EEPROMStore が本体の前に保存するヘッダ。
+ */
+struct RecordHeader {
+  uint16_t magic;
+  uint16_t crc;
+};
+
 /**
  * @brief EEPROM 上のセクション情報を表す。
  */
@@ -72,6 +293,18 @@ constexpr uint16_t layoutFieldAddress(uint16_t baseAddress, size_t fieldOffset)
   return static_cast<uint16_t>(baseAddress + fieldOffset);
 }
 
+/**
+ * @brief アドレスを指定した境界に切り上げる。
+ *
+ * @param address 切り上げるアドレス
+ * @param alignment 境界のバイト数(1 以上)
+ * @return uint16_t 切り上げたアドレス
+ */
+constexpr uint16_t alignAddress(uint16_t address, uint16_t alignment) {
+  return static_cast<uint16_t>((address + alignment - 1) / alignment *
+                               alignment);
+}
+
 /**
  * @brief ダンプ表示用の単純な 8bit チェックサムを計算する。
  *
@@ -87,9 +320,50 @@ inline uint8_t calcChecksum(const uint8_t* data, size_t len) {
   return checksum;
 }
 
+/// ダンプ 1 行に表示するバイト数
+constexpr uint8_t kDumpRowBytes = 16;
+
+/// バイナリダンプ 1 ブロックに含める最大バイト数
+constexpr uint8_t kDumpBlockBytes = 32;
+
+/**
+ * @brief 16 進ダンプの見出し行を返す。
+ *
+ * @return const char* 見出し行
+ */
+inline const char* hexDumpHeader() {
+  return "Add  +0 +1 +2 +3 +4 +5 +6 +7 +8 +9 +A +B +C +D +E +F Sum";
+}
+
+/**
+ * @brief 16 進ダンプ 1 行に必要なバッファサイズを返す。
+ *
+ * @param len 表示対象バイト数
+ * @return size_t 終端文字を含むバッファサイズ
+ */
+constexpr size_t hexRowBufferSize(size_t len) {
+  return 5 + len * 3 + 3 + 1;
+}
+
+/**
+ * @brief 1 バイトを 2 文字の 16 進表記で書き込む。
+ *
+ * @param out 出力先。2 文字分の領域が必要
+ * @param value 変換する値
+ * @return char* 書き込んだ直後の位置
+ */
+inline char* writeHexByte(char* out, uint8_t value) {
+  static const char kHexDigits[] = "0123456789ABCDEF";
+  out[0] = kHexDigits[value >> 4];
+  out[1] = kHexDigits[value & 0x0F];
+  return out + 2;
+}
+
 /**
  * @brief EEPROM ダンプ 1 行分の 16 進文字列を生成する。
  *
+ * 変換表を使って 1 文字ずつ書き込むため snprintf() を使わない。
+ *
  * @param buffer 出力先バッファ
  * @param bufferSize 出力先バッファサイズ
  * @param address 行先頭のアドレス
@@ -102,46 +376,511 @@ inline size_t formatHexRow(char* buffer, size_t bufferSize, uint16_t address,
   if (buffer == nullptr || bufferSize == 0 || data == nullptr || len == 0) {
     return 0;
   }
-
-  int written = snprintf(buffer, bufferSize, "%04X ", address);
-  if (written < 0 || static_cast<size_t>(written) >= bufferSize) {
-    if (bufferSize > 0) {
-      buffer[0] = '\0';
-    }
+  if (bufferSize < hexRowBufferSize(len)) {
+    buffer[0] = '\0';
     return 0;
   }
 
-  size_t offset = static_cast<size_t>(written);
+  char* out = writeHexByte(buffer, static_cast<uint8_t>(address >> 8));
+  out = writeHexByte(out, static_cast<uint8_t>(address));
+  *out++ = ' ';
   for (size_t i = 0; i < len; i++) {
-    written = snprintf(buffer + offset, bufferSize - offset, "%02X ", data[i]);
-    if (written < 0 || static_cast<size_t>(written) >= (bufferSize - offset)) {
-      buffer[0] = '\0';
-      return 0;
-    }
-    offset += static_cast<size_t>(written);
+    out = writeHexByte(out, data[i]);
+    *out++ = ' ';
   }
+  *out++ = ':';
+  out = writeHexByte(out, calcChecksum(data, len));
+  *out = '\0';
+  return static_cast<size_t>(out - buffer);
+}
 
-  written = snprintf(buffer + offset, bufferSize - offset, ":%02X",
-                     calcChecksum(data, len));
-  if (written < 0 || static_cast<size_t>(written) >= (bufferSize - offset)) {
-    buffer[0] = '\0';
+/**
+ * @brief バイナリダンプ 1 ブロックに必要なバッファサイズを返す。
+ *
+ * @param len ブロックに含めるバイト数
+ * @return size_t バッファサイズ
+ */
+constexpr size_t binaryBlockSize(size_t len) { return 2 + 1 + len + 2; }
+
+/**
+ * @brief バイナリダンプ 1 ブロックを生成する。
+ *
+ * 形式はすべてリトルエンディアンで次の通り。
+ *   アドレス(2) | バイト数(1) | データ(len) | CRC16(2)
+ * CRC16 はアドレス、バイト数、データを対象に calcCRC() と同じ方式で計算する。
+ *
+ * @param buffer 出力先バッファ
+ * @param bufferSize 出力先バッファサイズ
+ * @param address ブロック先頭のアドレス
+ * @param data 出力対象データ
+ * @param len 出力対象バイト数(255 以下)
+ * @return size_t 出力したバイト数。失敗時は 0
+ */
+inline size_t formatBinaryBlock(uint8_t* buffer, size_t bufferSize,
+                                uint16_t address, const uint8_t* data,
+                                size_t len) {
+  if (buffer == nullptr || data == nullptr || len == 0 || len > 0xFF ||
+      bufferSize < binaryBlockSize(len)) {
     return 0;
   }
-  offset += static_cast<size_t>(written);
-  return offset;
+
+  buffer[0] = static_cast<uint8_t>(address);
+  buffer[1] = static_cast<uint8_t>(address >> 8);
+  buffer[2] = static_cast<uint8_t>(len);
+  memcpy(buffer + 3, data, len);
+  const uint16_t crc = calcCRC(buffer, 3 + len);
+  buffer[3 + len] = static_cast<uint8_t>(crc);
+  buffer[4 + len] = static_cast<uint8_t>(crc >> 8);
+  return binaryBlockSize(len);
 }
 
+template <typename Func>
+/**
+ * @brief 2 つのバイト列を比較し、異なる連続範囲ごとに関数を呼び出す。
+ *
+ * @tparam Func 範囲を受け取る関数の型。`func(offset, length)` の形で呼ぶ
+ * @param before 比較元のバイト列
+ * @param after 比較先のバイト列
+ * @param len 比較するバイト数
+ * @param func 異なる範囲ごとに呼び出す関数
+ * @return size_t 異なっていたバイト数の合計
+ */
+size_t forEachChangedRange(const uint8_t* before, const uint8_t* after,
+                           size_t len, Func func) {
+  size_t changed = 0;
+  size_t index = 0;
+  while (index < len) {
+    if (before[index] == after[index]) {
+      index++;
+      continue;
+    }
+
+    const size_t start = index;
+    while (index < len && before[index] != after[index]) {
+      index++;
+    }
+    func(start, index - start);
+    changed += index - start;
+  }
+  return changed;
+}
+
+/**
+ * @brief 最後に EEPROM と同期した内容を保持するシャドウコピー。
+ *
+ * EEPROMStore の差分書き込みモードで使用する。
+ *
+ * @tparam T 保存対象の構造体
+ * @tparam Enabled false の場合はメモリを消費しない空実装になる
+ */
+template <typename T, bool Enabled>
+class ShadowCopy {
+ public:
+  ShadowCopy() : _value(), _valid(false) {}
+
+  /**
+   * @brief EEPROM と同期した内容を記録する。
+   *
+   * @param value 同期した値
+   */
+  void update(const T& value) {
+    memcpy(&_value, &value, sizeof(T));
+    _valid = true;
+  }
+
+  /**
+   * @brief 記録を無効にする。
+   */
+  void invalidate() { _valid = false; }
+
+  /**
+   * @brief 有効な記録を持っているか判定する。
+   *
+   * @return true 有効な記録がある場合
+   * @return false 記録がない場合
+   */
+  bool isValid() const { return _valid; }
+
+  /**
+   * @brief 記録と指定値がバイト単位で一致するか判定する。
+   *
+   * @param value 比較する値
+   * @return true 一致する場合
+   * @return false 異なる場合、または記録がない場合
+   */
+  bool equals(const T& value) const {
+    return _valid && memcmp(&_value, &value, sizeof(T)) == 0;
+  }
+
+  template <typename Func>
+  /**
+   * @brief 記録と指定値の異なる範囲ごとに関数を呼び出す。
+   *
+   * @tparam Func 範囲を受け取る関数の型。`func(offset, length)` の形で呼ぶ
+   * @param value 比較する値
+   * @param func 異なる範囲ごとに呼び出す関数
+   * @return size_t 異なっていたバイト数の合計
+   */
+  size_t forEachChanged(const T& value, Func func) const {
+    return forEachChangedRange(reinterpret_cast<const uint8_t*>(&_value),
+                               reinterpret_cast<const uint8_t*>(&value),
+                               sizeof(T), func);
+  }
+
+ private:
+  T _value;
+  bool _valid;
+};
+
+template <typename T>
+class ShadowCopy<T, false> {
+ public:
+  void update(const T&) {}
+  void invalidate() {}
+  bool isValid() const { return false; }
+  bool equals(const T&) const { return false; }
+
+  template <typename Func>
+  size_t forEachChanged(const T&, Func) const {
+    return 0;
+  }
+};
+
+/**
+ * @brief 書き込み対象のバイト範囲を固定長の表で管理する。
+ *
+ * 重なる範囲や隣接する範囲は 1 つにまとめる。表が一杯になった場合は
+ * 最も間隔の狭い範囲どうしを結合するため、範囲を取りこぼすことはない。
+ *
+ * @tparam N 保持できる範囲の最大数
+ */
+template <uint8_t N>
+class DirtyRanges {
+  static_assert(N >= 2, "DirtyRanges needs at least two ranges to merge");
+
+ public:
+  /**
+   * @brief 1 つの範囲 [start, end) を表す。
+   */
+  struct Range {
+    uint16_t start;
+    uint16_t end;
+  };
+
+  DirtyRanges() : _count(0) {}
+
+  /**
+   * @brief すべての範囲を削除する。
+   */
+  void clear() { _count = 0; }
+
+  /**
+   * @brief 範囲 [start, end) を追加する。
+   *
+   * @param start 開始位置
+   * @param end 終了位置(この位置は含まない)
+   */
+  void add(uint16_t start, uint16_t end) {
+    if (start >= end) {
+      return;
+    }
+
+    Range range = {start, end};
+    uint8_t index = 0;
+    while (index < _count) {
+      if (range.start <= _ranges[index].end &&
+          _ranges[index].start <= range.end) {
+        range.start = min16(range.start, _ranges[index].start);
+        range.end = max16(range.end, _ranges[index].end);
+        remove(index);
+        continue;
+      }
+      index++;
+    }
+
+    if (_count == N) {
+      mergeClosest();
+    }
+    insert(range);
+  }
+
+  /**
+   * @brief 保持している範囲の数を返す。
+   *
+   * @return uint8_t 範囲の数
+   */
+  uint8_t count() const { return _count; }
+
+  /**
+   * @brief 指定番目の範囲を返す。範囲は開始位置の昇順に並ぶ。
+   *
+   * @param index 範囲の番号
+   * @return const Range& 範囲
+   */
+  const Range& operator[](uint8_t index) const { return _ranges[index]; }
+
+  /**
+   * @brief 範囲の合計バイト数を返す。
+   *
+   * @return size_t 合計バイト数
+   */
+  size_t totalBytes() const {
+    size_t total = 0;
+    for (uint8_t index = 0; index < _count; index++) {
+      total += _ranges[index].end - _ranges[index].start;
+    }
+    return total;
+  }
+
+ private:
+  static uint16_t min16(uint16_t a, uint16_t b) { return a < b ? a : b; }
+  static uint16_t max16(uint16_t a, uint16_t b) { return a > b ? a : b; }
+
+  void remove(uint8_t index) {
+    for (uint8_t i = index; i + 1 < _count; i++) {
+      _ranges[i] = _ranges[i + 1];
+    }
+    _count--;
+  }
+
+  void insert(const Range& range) {
+    uint8_t index = _count;
+    while (index > 0 && _ranges[index - 1].start > range.start) {
+      _ranges[index] = _ranges[index - 1];
+      index--;
+    }
+    _ranges[index] = range;
+    _count++;
+  }
+
+  void mergeClosest() {
+    uint8_t closest = 0;
+    for (uint8_t i = 1; i + 1 < _count; i++) {
+      if (_ranges[i + 1].start - _ranges[i].end <
+          _ranges[closest + 1].start - _ranges[closest].end) {
+        closest = i;
+      }
+    }
+    _ranges[closest].end = _ranges[closest + 1].end;
+    remove(static_cast<uint8_t>(closest + 1));
+  }
+
+  Range _ranges[N];
+  uint8_t _count;
+};
+
 }  // namespace EEPROMStoreUtil
 
+/**
+ * @brief EEPROM の読み書き先を差し替えるためのバックエンドインタフェース。
+ *
+ * EEPROMSession はこのインタフェースを通して読み書きする。
+ * Arduino の EEPROM ライブラリを使う ArduinoEEPROMBackend のほか、
+ * ホスト上でのシミュレーションやベンチマーク用の実装を渡せる。
+ */
+class EEPROMBackend {
+ public:
+  virtual ~EEPROMBackend() {}
+
+  /**
+   * @brief 指定サイズで使用可能な状態に初期化する。
+   *
+   * @param size 使用するサイズ
+   * @return true 初期化に成功した場合
+   * @return false 初期化に失敗した場合
+   */
+  virtual bool begin(uint16_t size) = 0;
+
+  /**
+   * @brief 使用を終了する。
+   */
+  virtual void end() = 0;
+
+  /**
+   * @brief 1 バイト読み出す。
+   *
+   * @param address 読み出し元アドレス
+   * @return uint8_t 読み出した値
+   */
+  virtual uint8_t read(uint16_t address) = 0;
+
+  /**
+   * @brief 1 バイト書き込む。
+   *
+   * @param address 書き込み先アドレス
+   * @param value 書き込む値
+   */
+  virtual void write(uint16_t address, uint8_t value) = 0;
+
+  /**
+   * @brief 書き込みを確定する。
+   *
+   * @return true 確定に成功した場合
+   * @return false 確定に失敗した場合
+   */
+  virtual bool commit() = 0;
+
+  /**
+   * @brief バイト列をまとめて読み出す。
+   *
+   * 連続領域を直接扱える実装ではオーバーライドして高速化する。
+   *
+   * @param address 読み出し元アドレス
+   * @param data 読み出し結果の格納先
+   * @param length 読み出すバイト数
+   */
+  virtual void readBytes(uint16_t address, uint8_t* data, size_t length) {
+    for (size_t index = 0; index < length; index++) {
+      data[index] = read(static_cast<uint16_t>(address + index));
+    }
+  }
+
+  /**
+   * @brief バイト列をまとめて書き込む。
+   *
+   * 連続領域を直接扱える実装ではオーバーライドして高速化する。
+   *
+   * @param address 書き込み先アドレス
+   * @param data 書き込むデータ
+   * @param length 書き込むバイト数
+   */
+  virtual void writeBytes(uint16_t address, const uint8_t* data,
+                          size_t length) {
+    for (size_t index = 0; index < length; index++) {
+      write(static_cast<uint16_t>(address + index), data[index]);
+    }
+  }
+};
+
 #if EEPROM_STORE_HAS_BACKEND
 
 /**
- * @brief Arduino EEPROM API へのアクセスをまとめる薄いラッパー。
+ * @brief Arduino の EEPROM ライブラリを使うバックエンド。
+ */
+class ArduinoEEPROMBackend : public EEPROMBackend {
+ public:
+  bool begin(uint16_t size) override {
+#if defined(ESP32) || defined(ESP8266)
+    return EEPROM.begin(size);
+#else
+    (void)size;
+    return true;
+#endif
+  }
+
+  void end() override {
+#if defined(ESP32) || defined(ESP8266)
+    EEPROM.end();
+#endif
+  }
+
+  uint8_t read(uint16_t address) override { return EEPROM.read(address); }
+
+  void write(uint16_t address, uint8_t value) override {
+#if defined(__AVR__)
+    // 値が変わらないセルは書き換えない
+    EEPROM.update(address, value);
+#else
+    EEPROM.write(address, value);
+#endif
+  }
+
+  bool commit() override {
+#if defined(ESP32) || defined(ESP8266)
+    return EEPROM.commit();
+#else
+    return true;
+#endif
+  }
+
+#if defined(ESP32) || defined(ESP8266) || defined(__AVR__)
+  /**
+   * @brief 連続したバイト列をまとめて読み出す。
+   *
+   * ESP32 / ESP8266 は RAM 上のキャッシュから memcpy し、AVR は
+   * eeprom_read_block() で読むため、1 バイトごとの仮想関数呼び出しがない。
+   *
+   * @param address 読み出し元アドレス
+   * @param data 読み出し結果の格納先
+   * @param length 読み出すバイト数
+   */
+  void readBytes(uint16_t address, uint8_t* data, size_t length) override {
+#if defined(__AVR__)
+    eeprom_read_block(data, reinterpret_cast<const void*>(address), length);
+#else
+    const size_t available = clip(address, length);
+    if (available > 0) {
+#if defined(ESP32)
+      EEPROM.readBytes(address, data, available);
+#else
+      memcpy(data, EEPROM.getConstDataPtr() + address, available);
+#endif
+    }
+    memset(data + available, 0xFF, length - available);
+#endif
+  }
+
+  /**
+   * @brief 連続したバイト列をまとめて書き込む。
+   *
+   * ESP32 / ESP8266 は RAM 上のキャッシュへ memcpy し(EEPROM.put() と同じ)、
+   * AVR は eeprom_update_block() で値が変わるセルだけを書き換える。
+   *
+   * @param address 書き込み先アドレス
+   * @param data 書き込むデータ
+   * @param length 書き込むバイト数
+   */
+  void writeBytes(uint16_t address, const uint8_t* data,
+                  size_t length) override {
+#if defined(__AVR__)
+    eeprom_update_block(data, reinterpret_cast<void*>(address), length);
+#else
+    const size_t available = clip(address, length);
+    if (available == 0) {
+      return;
+    }
+#if defined(ESP32)
+    EEPROM.writeBytes(address, data, available);
+#else
+    // getDataPtr() は変更ありとして扱われ、commit() で書き込まれる
+    memcpy(EEPROM.getDataPtr() + address, data, available);
+#endif
+#endif
+  }
+#endif
+
+  /**
+   * @brief 共有インスタンスを返す。
+   *
+   * @return ArduinoEEPROMBackend& 共有インスタンス
+   */
+  static ArduinoEEPROMBackend& instance() {
+    static ArduinoEEPROMBackend backend;
+    return backend;
+  }
+
+#if defined(ESP32) || defined(ESP8266)
+ private:
+  static size_t clip(uint16_t address, size_t length) {
+    const size_t size = EEPROM.length();
+    if (address >= size) {
+      return 0;
+    }
+    return length < size - address ? length : size - address;
+  }
+#endif
+};
+
+#endif  // EEPROM_STORE_HAS_BACKEND
+
+/**
+ * @brief EEPROM へのアクセスをまとめる薄いラッパー。
  *
  * 特徴:
  *   - `begin()` / `end()` / `commit()` をまとめて扱える
  *   - `put()` / `get()` / `putBytes()` / `getBytes()` を統一した形で使える
  *   - EEPROM全体の16進ダンプを生成できる
+ *   - EEPROMBackend を渡すと読み書き先を差し替えられる
  *
  * 主な用途:
  *   - プロジェクト固有の保存クラスから EEPROM 操作を直接分離する
@@ -149,12 +888,24 @@ inline size_t formatHexRow(char* buffer, size_t bufferSize, uint16_t address,
  */
 class EEPROMSession {
  public:
+#if EEPROM_STORE_HAS_BACKEND
+  /**
+   * @brief Arduino の EEPROM を使うセッションを初期化する。
+   *
+   * @param size 使用する EEPROM サイズ
+   */
+  explicit EEPROMSession(uint16_t size)
+      : _size(size), _backend(&ArduinoEEPROMBackend::instance()) {}
+#endif
+
   /**
-   * @brief セッションを初期化する。
+   * @brief 指定したバックエンドを使うセッションを初期化する。
    *
    * @param size 使用する EEPROM サイズ
+   * @param backend 読み書き先のバックエンド
    */
-  explicit EEPROMSession(uint16_t size) : _size(size) {}
+  EEPROMSession(uint16_t size, EEPROMBackend& backend)
+      : _size(size), _backend(&backend) {}
 
   /**
    * @brief EEPROM を使用可能な状態に初期化する。
@@ -162,22 +913,12 @@ class EEPROMSession {
    * @return true 初期化に成功した場合
    * @return false 初期化に失敗した場合
    */
-  bool begin() const {
-#if defined(ESP32) || defined(ESP8266)
-    return EEPROM.begin(_size);
-#else
-    return true;
-#endif
-  }
+  bool begin() const { return _backend->begin(_size); }
 
   /**
-   * @brief EEPROM セッションを終了する。
-   */
-  void end() const {
-#if defined(ESP32) || defined(ESP8266)
-    EEPROM.end();
-#endif
-  }
+   * @brief EEPROM セッションを終了する。
+   */
+  void end() const { _backend->end(); }
 
   template <typename T>
   /**
@@ -188,7 +929,7 @@ class EEPROMSession {
    * @param value 書き込む値
    */
   void put(uint16_t address, const T& value) const {
-    EEPROM.put(address, value);
+    putBytes(address, &value, sizeof(T));
   }
 
   template <typename T>
@@ -200,7 +941,7 @@ class EEPROMSession {
    * @param value 読み出し結果の格納先
    */
   void get(uint16_t address, T& value) const {
-    EEPROM.get(address, value);
+    getBytes(address, &value, sizeof(T));
   }
 
   /**
@@ -211,10 +952,7 @@ class EEPROMSession {
    * @param length 書き込むバイト数
    */
   void putBytes(uint16_t address, const void* data, size_t length) const {
-    const uint8_t* bytes = static_cast<const uint8_t*>(data);
-    for (size_t index = 0; index < length; index++) {
-      EEPROM.write(address + static_cast<uint16_t>(index), bytes[index]);
-    }
+    _backend->writeBytes(address, static_cast<const uint8_t*>(data), length);
   }
 
   /**
@@ -225,10 +963,7 @@ class EEPROMSession {
    * @param length 読み出すバイト数
    */
   void getBytes(uint16_t address, void* data, size_t length) const {
-    uint8_t* bytes = static_cast<uint8_t*>(data);
-    for (size_t index = 0; index < length; index++) {
-      bytes[index] = EEPROM.read(address + static_cast<uint16_t>(index));
-    }
+    _backend->readBytes(address, static_cast<uint8_t*>(data), length);
   }
 
   /**
@@ -237,7 +972,7 @@ class EEPROMSession {
    * @param address 読み出し元アドレス
    * @return uint8_t 読み出した値
    */
-  uint8_t read(uint16_t address) const { return EEPROM.read(address); }
+  uint8_t read(uint16_t address) const { return _backend->read(address); }
 
   /**
    * @brief EEPROM への書き込みを確定する。
@@ -245,52 +980,210 @@ class EEPROMSession {
    * @return true 確定に成功した場合
    * @return false 確定に失敗した場合
    */
-  bool commit() const {
-#if defined(ESP32) || defined(ESP8266)
-    return EEPROM.commit();
-#else
-    return true;
-#endif
-  }
+  bool commit() const { return _backend->commit(); }
+
+  /**
+   * @brief セッションで使用する EEPROM サイズを返す。
+   *
+   * @return uint16_t EEPROM サイズ
+   */
+  uint16_t size() const { return _size; }
 
   template <typename Writer>
   /**
    * @brief EEPROM の内容を 16 進ダンプとして出力する。
    *
+   * 各行はスタック上のバッファに生成し、`const char*` として渡す。
+   * `String` を受け取る関数もそのまま使える。
+   *
    * @tparam Writer 出力関数の型
    * @param writer 1 行ずつ受け取る関数
    * @param startAddress ダンプ開始アドレス
    * @param length ダンプするバイト数。0 の場合は末尾まで
    */
   void dump(Writer writer, uint16_t startAddress = 0,
-            uint16_t length = 0) const {
-    const uint16_t dumpLength =
-        length == 0 ? static_cast<uint16_t>(_size - startAddress) : length;
-    uint16_t address = startAddress;
-    char line[80];
-
-    writer(String("Add  +0 +1 +2 +3 +4 +5 +6 +7 +8 +9 +A +B +C +D +E +F Sum"));
-    while (address < static_cast<uint16_t>(startAddress + dumpLength)) {
-      uint8_t row[16] = {};
-      uint8_t rowLength = 0;
-      for (; rowLength < 16 &&
-             address < static_cast<uint16_t>(startAddress + dumpLength);
-           rowLength++, address++) {
-        row[rowLength] = EEPROM.read(address);
-      }
+            uint16_t length = 0) const;
 
-      if (EEPROMStoreUtil::formatHexRow(
-              line, sizeof(line),
-              static_cast<uint16_t>(address - rowLength), row, rowLength) > 0) {
-        writer(String(line));
-      }
+  template <typename Writer>
+  /**
+   * @brief EEPROM の内容を CRC16 付きのバイナリブロックとして出力する。
+   *
+   * ブロックの形式は EEPROMStoreUtil::formatBinaryBlock() を参照。
+   *
+   * @tparam Writer 出力関数の型。`writer(const uint8_t* data, size_t len)`
+   * @param writer 1 ブロックずつ受け取る関数
+   * @param startAddress ダンプ開始アドレス
+   * @param length ダンプするバイト数。0 の場合は末尾まで
+   */
+  void dumpBinary(Writer writer, uint16_t startAddress = 0,
+                  uint16_t length = 0) const;
+
+ private:
+  uint16_t _size;
+  EEPROMBackend* _backend;
+};
+
+/**
+ * @brief EEPROM のダンプを 1 行ずつ生成するクラス。
+ *
+ * next() を呼ぶたびに 1 行(または 1 ブロック)だけ読み出して生成するため、
+ * loop() の中で少しずつ出力して他の処理を止めないようにできる。
+ *
+ * 使い方:
+ *   EEPROMDumpIterator dumper(session);
+ *
+ *   void loop() {
+ *     char line[EEPROMDumpIterator::kLineBufferSize];
+ *     if (dumper.next(line, sizeof(line)) > 0) {
+ *       Serial.println(line);
+ *     }
+ *     // 他の処理
+ *   }
+ *
+ * バイナリ形式の場合は nextBlock() を使う。
+ */
+class EEPROMDumpIterator {
+ public:
+  /// next() に渡すバッファに必要なサイズ
+  static constexpr size_t kLineBufferSize =
+      EEPROMStoreUtil::hexRowBufferSize(EEPROMStoreUtil::kDumpRowBytes);
+
+  /// nextBlock() に渡すバッファに必要なサイズ
+  static constexpr size_t kBlockBufferSize =
+      EEPROMStoreUtil::binaryBlockSize(EEPROMStoreUtil::kDumpBlockBytes);
+
+  /**
+   * @brief ダンプ範囲を指定して初期化する。
+   *
+   * @param session ダンプ対象の EEPROM セッション
+   * @param startAddress ダンプ開始アドレス
+   * @param length ダンプするバイト数。0 の場合は末尾まで
+   */
+  explicit EEPROMDumpIterator(const EEPROMSession& session,
+                              uint16_t startAddress = 0, uint16_t length = 0)
+      : _session(session),
+        _start(startAddress),
+        _end(static_cast<uint16_t>(
+            length == 0 || length > session.size() - startAddress
+                ? session.size()
+                : startAddress + length)),
+        _address(startAddress),
+        _headerPending(true) {}
+
+  /**
+   * @brief 次の 1 行を 16 進文字列として生成する。
+   *
+   * 最初の呼び出しでは見出し行を返す。
+   *
+   * @param buffer 出力先バッファ(kLineBufferSize 以上)
+   * @param bufferSize 出力先バッファサイズ
+   * @return size_t 出力した文字数。終端に達した、またはバッファ不足の場合は 0
+   */
+  size_t next(char* buffer, size_t bufferSize) {
+    if (buffer == nullptr || bufferSize < kLineBufferSize) {
+      return 0;
+    }
+    if (_headerPending) {
+      _headerPending = false;
+      const char* header = EEPROMStoreUtil::hexDumpHeader();
+      const size_t headerLength = strlen(header);
+      memcpy(buffer, header, headerLength + 1);
+      return headerLength;
+    }
+
+    uint8_t row[EEPROMStoreUtil::kDumpRowBytes];
+    const uint16_t address = _address;
+    const size_t rowLength = readChunk(row, sizeof(row));
+    return EEPROMStoreUtil::formatHexRow(buffer, bufferSize, address, row,
+                                         rowLength);
+  }
+
+  /**
+   * @brief 次の 1 ブロックをバイナリ形式で生成する。
+   *
+   * @param buffer 出力先バッファ(kBlockBufferSize 以上)
+   * @param bufferSize 出力先バッファサイズ
+   * @return size_t 出力したバイト数。終端に達した、またはバッファ不足の場合は 0
+   */
+  size_t nextBlock(uint8_t* buffer, size_t bufferSize) {
+    if (buffer == nullptr || bufferSize < kBlockBufferSize) {
+      return 0;
     }
+
+    uint8_t block[EEPROMStoreUtil::kDumpBlockBytes];
+    const uint16_t address = _address;
+    const size_t blockLength = readChunk(block, sizeof(block));
+    return EEPROMStoreUtil::formatBinaryBlock(buffer, bufferSize, address,
+                                              block, blockLength);
+  }
+
+  /**
+   * @brief すべて出力し終えたか判定する。
+   *
+   * @return true 終端に達した場合
+   * @return false 未出力の範囲が残っている場合
+   */
+  bool done() const { return !_headerPending && _address >= _end; }
+
+  /**
+   * @brief 先頭から出力し直す。
+   */
+  void rewind() {
+    _address = _start;
+    _headerPending = true;
   }
 
+  /**
+   * @brief 次に出力するアドレスを返す。
+   *
+   * @return uint16_t 次のアドレス
+   */
+  uint16_t address() const { return _address; }
+
  private:
-  uint16_t _size;
+  size_t readChunk(uint8_t* data, size_t capacity) {
+    _headerPending = false;
+    if (_address >= _end) {
+      return 0;
+    }
+    const size_t remaining = static_cast<size_t>(_end - _address);
+    const size_t length = remaining < capacity ? remaining : capacity;
+    _session.getBytes(_address, data, length);
+    _address = static_cast<uint16_t>(_address + length);
+    return length;
+  }
+
+  const EEPROMSession& _session;
+  uint16_t _start;
+  uint16_t _end;
+  uint16_t _address;
+  bool _headerPending;
 };
 
+template <typename Writer>
+void EEPROMSession::dump(Writer writer, uint16_t startAddress,
+                         uint16_t length) const {
+  EEPROMDumpIterator dumper(*this, startAddress, length);
+  char line[EEPROMDumpIterator::kLineBufferSize];
+  while (dumper.next(line, sizeof(line)) > 0) {
+    writer(static_cast<const char*>(line));
+  }
+}
+
+template <typename Writer>
+void EEPROMSession::dumpBinary(Writer writer, uint16_t startAddress,
+                               uint16_t length) const {
+  EEPROMDumpIterator dumper(*this, startAddress, length);
+  uint8_t block[EEPROMDumpIterator::kBlockBufferSize];
+  size_t written = 0;
+  while ((written = dumper.nextBlock(block, sizeof(block))) > 0) {
+    writer(static_cast<const uint8_t*>(block), written);
+  }
+}
+
+template <typename Layout>
+class EEPROMLayoutTransaction;
+
 /**
  * @brief 任意レイアウト構造体を EEPROM 上の固定位置に保存するクラス。
  *
@@ -307,7 +1200,7 @@ class EEPROMSession {
  *   };
  *
  *   EEPROMSession session(512);
- *   EEPROMLayoutStore<Layout> store(session, 10);
+ *   EEPROMLayoutStore<Layout> store(session, 10, 30);
  *
  *   void setup() {
  *     session.begin();
@@ -315,19 +1208,44 @@ class EEPROMSession {
  *     store.writeField(offsetof(Layout, version), static_cast<uint16_t>(2));
  *   }
  *
+ * 複数フィールドをまとめて書き込む場合は Transaction を使う。
+ *
+ * CRC の保存先:
+ *   Transaction はレイアウト全体の CRC (kCRCSize = 2 バイト)を、コンストラクタで
+ *   指定した crcAddress に保存する。このライブラリは CRC の場所を自動では確保
+ *   しないため、呼び出し元が次のどちらかで 2 バイトを用意する。
+ *     - レイアウトの外: ほかのデータと重ならないアドレスを指定する
+ *     - レイアウトの中: uint16_t の CRC フィールドを Layout に用意し、
+ *       layoutFieldAddress(baseAddress, offsetof(Layout, crc)) を指定する。
+ *       CRC の計算ではこの 2 バイトを除く
+ *   crcAddress を省略した場合は CRC を保存せず、verify() は常に false を返す。
+ *
  * @tparam Layout レイアウトを表す構造体
  */
 template <typename Layout>
 class EEPROMLayoutStore {
  public:
+  /// 複数フィールドの書き込みをまとめるトランザクション
+  typedef EEPROMLayoutTransaction<Layout> Transaction;
+
+  /// CRC を保存しないことを表す crcAddress
+  static constexpr uint16_t kNoCRC = 0xFFFF;
+  /// crcAddress に保存する CRC のバイト数
+  static constexpr uint16_t kCRCSize = sizeof(uint16_t);
+
   /**
    * @brief レイアウトストアを初期化する。
    *
    * @param session 使用する EEPROM セッション
    * @param baseAddress レイアウト先頭アドレス
+   * @param crcAddress Transaction が CRC を保存するアドレス。呼び出し元が
+   *                   kCRCSize バイトを確保しておく。kNoCRC の場合は保存しない
    */
-  EEPROMLayoutStore(const EEPROMSession& session, uint16_t baseAddress)
-      : _session(session), _baseAddress(baseAddress) {}
+  EEPROMLayoutStore(const EEPROMSession& session, uint16_t baseAddress,
+                    uint16_t crcAddress = kNoCRC)
+      : _session(session),
+        _baseAddress(baseAddress),
+        _crcAddress(crcAddress) {}
 
   /**
    * @brief レイアウト全体を EEPROM に書き込む。
@@ -403,9 +1321,278 @@ class EEPROMLayoutStore {
     return EEPROMStoreUtil::layoutFieldAddress(_baseAddress, offset);
   }
 
+  /**
+   * @brief CRC を保存するか判定する。
+   *
+   * @return true crcAddress を指定した場合
+   * @return false CRC を保存しない場合
+   */
+  bool hasCRC() const { return _crcAddress != kNoCRC; }
+
+  /**
+   * @brief レイアウト全体の CRC を保存するアドレスを返す。
+   *
+   * @return uint16_t コンストラクタで指定したアドレス。省略時は kNoCRC
+   */
+  uint16_t crcAddress() const { return _crcAddress; }
+
+  /**
+   * @brief レイアウトの CRC を計算する。
+   *
+   * CRC の保存先がレイアウトの中にある場合は、その 2 バイトを除いて計算する。
+   *
+   * @param layout 計算対象のレイアウト
+   * @return uint16_t CRC
+   */
+  uint16_t calcCRC(const Layout& layout) const {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&layout);
+    if (!isCRCInLayout()) {
+      return EEPROMStoreUtil::calcCRC(bytes, sizeof(Layout));
+    }
+    const size_t offset = _crcAddress - _baseAddress;
+    EEPROMStoreUtil::CRC16Accumulator crc;
+    crc.update(bytes, offset);
+    crc.update(bytes + offset + kCRCSize, sizeof(Layout) - offset - kCRCSize);
+    return crc.finalize();
+  }
+
+  /**
+   * @brief 保存されているレイアウト全体の CRC が一致するか判定する。
+   *
+   * @return true Transaction で書き込んだ内容が壊れていない場合
+   * @return false CRC が一致しない、または CRC を保存しない場合
+   */
+  bool verify() const {
+    if (!hasCRC()) {
+      return false;
+    }
+    Layout layout = read();
+    uint16_t crc = 0;
+    _session.get(_crcAddress, crc);
+    return calcCRC(layout) == crc;
+  }
+
+  /**
+   * @brief レイアウトが使う EEPROM サイズを返す。
+   *
+   * レイアウトの外に置く CRC の kCRCSize バイトは含まない。
+   *
+   * @return uint16_t レイアウトのサイズ
+   */
+  static constexpr uint16_t requiredSize() { return sizeof(Layout); }
+
+  /**
+   * @brief 使用している EEPROM セッションを返す。
+   *
+   * @return const EEPROMSession& EEPROM セッション
+   */
+  const EEPROMSession& session() const { return _session; }
+
  private:
+  bool isCRCInLayout() const {
+    return hasCRC() && _crcAddress >= _baseAddress &&
+           static_cast<size_t>(_crcAddress) + kCRCSize <=
+               static_cast<size_t>(_baseAddress) + sizeof(Layout);
+  }
+
   const EEPROMSession& _session;
   uint16_t _baseAddress;
+  uint16_t _crcAddress;
+};
+
+template <typename Layout>
+constexpr uint16_t EEPROMLayoutStore<Layout>::kNoCRC;
+
+template <typename Layout>
+constexpr uint16_t EEPROMLayoutStore<Layout>::kCRCSize;
+
+/**
+ * @brief EEPROMLayoutStore への複数フィールドの書き込みをまとめるクラス。
+ *
+ * 特徴:
+ *   - 書き込みは RAM 上のレイアウトのコピーに対して行い、変更範囲を記録する
+ *   - 重なる範囲や隣接する範囲はまとめて 1 回で書き込む
+ *   - commit() で変更範囲とレイアウト全体の CRC を書き込み、EEPROM の
+ *     commit() を 1 回だけ呼ぶ(CRC はストアに crcAddress を指定した場合のみ)
+ *   - 明示的に commit() しなかった場合は破棄時に commit() する。ただし
+ *     エラーが発生していた場合は何も書き込まずに破棄する
+ *
+ * 使い方:
+ *   {
+ *     EEPROMLayoutStore<Layout>::Transaction tx(store);
+ *     tx.writeField(offsetof(Layout, version), static_cast<uint16_t>(2));
+ *     tx.writeField(offsetof(Layout, stateSize), static_cast<uint16_t>(32));
+ *     if (!isValid()) {
+ *       tx.fail();  // 何も書き込まずに破棄する
+ *     }
+ *   }  // ここで 1 回だけ commit() される
+ *
+ * @tparam Layout レイアウトを表す構造体
+ */
+template <typename Layout>
+class EEPROMLayoutTransaction {
+ public:
+  /// 記録できる変更範囲の最大数。超えた場合は近い範囲どうしを結合する
+  static constexpr uint8_t kMaxRanges = 8;
+
+  /**
+   * @brief 現在のレイアウトを読み込んでトランザクションを開始する。
+   *
+   * @param store 対象のレイアウトストア
+   */
+  explicit EEPROMLayoutTransaction(const EEPROMLayoutStore<Layout>& store)
+      : _store(store),
+        _staged(store.read()),
+        _error(false),
+        _finished(false),
+        _writtenBytes(0) {}
+
+  /**
+   * @brief 未確定なら確定する。エラー発生後はロールバックする。
+   */
+  ~EEPROMLayoutTransaction() {
+    if (!_finished) {
+      if (_error) {
+        rollback();
+      } else {
+        commit();
+      }
+    }
+  }
+
+  EEPROMLayoutTransaction(const EEPROMLayoutTransaction&) = delete;
+  EEPROMLayoutTransaction& operator=(const EEPROMLayoutTransaction&) = delete;
+
+  template <typename Field>
+  /**
+   * @brief 指定フィールドへの書き込みを登録する。
+   *
+   * @tparam Field フィールドの型
+   * @param offset レイアウト先頭からのオフセット
+   * @param value 書き込む値
+   * @return true 登録できた場合
+   * @return false 範囲外、または確定済みの場合
+   */
+  bool writeField(size_t offset, const Field& value) {
+    return writeBytes(offset, &value, sizeof(Field));
+  }
+
+  /**
+   * @brief 指定位置へのバイト列の書き込みを登録する。
+   *
+   * 範囲外を指定した場合はエラー状態になり、破棄時にロールバックされる。
+   *
+   * @param offset レイアウト先頭からのオフセット
+   * @param data 書き込むデータ
+   * @param length 書き込むバイト数
+   * @return true 登録できた場合
+   * @return false 範囲外、または確定済みの場合
+   */
+  bool writeBytes(size_t offset, const void* data, size_t length) {
+    if (_finished || offset > sizeof(Layout) ||
+        length > sizeof(Layout) - offset) {
+      _error = true;
+      return false;
+    }
+
+    uint8_t* staged = reinterpret_cast<uint8_t*>(&_staged);
+    if (memcmp(staged + offset, data, length) == 0) {
+      return true;
+    }
+    memcpy(staged + offset, data, length);
+    _ranges.add(static_cast<uint16_t>(offset),
+                static_cast<uint16_t>(offset + length));
+    return true;
+  }
+
+  /**
+   * @brief 登録済みの書き込みを反映したレイアウトを返す。
+   *
+   * @return const Layout& 反映後のレイアウト
+   */
+  const Layout& staged() const { return _staged; }
+
+  /**
+   * @brief エラー状態にする。破棄時に何も書き込まずにロールバックする。
+   */
+  void fail() { _error = true; }
+
+  /**
+   * @brief エラー状態か判定する。
+   *
+   * @return true エラーが発生している場合
+   * @return false エラーが発生していない場合
+   */
+  bool hasError() const { return _error; }
+
+  /**
+   * @brief 変更範囲とレイアウト全体の CRC を書き込み、確定する。
+   *
+   * @return true 確定に成功した場合
+   * @return false エラー状態、確定済み、または EEPROM の確定に失敗した場合
+   */
+  bool commit() {
+    if (_finished || _error) {
+      return false;
+    }
+    _finished = true;
+
+    const EEPROMSession& session = _store.session();
+    const uint8_t* staged = reinterpret_cast<const uint8_t*>(&_staged);
+    const bool hasCRC = _store.hasCRC();
+    const uint16_t crc = hasCRC ? _store.calcCRC(_staged) : 0;
+    uint16_t storedCRC = 0;
+    if (hasCRC) {
+      session.get(_store.crcAddress(), storedCRC);
+    }
+    if (_ranges.count() == 0 && storedCRC == crc) {
+      return true;
+    }
+
+    for (uint8_t index = 0; index < _ranges.count(); index++) {
+      const uint16_t start = _ranges[index].start;
+      const uint16_t length =
+          static_cast<uint16_t>(_ranges[index].end - start);
+      session.putBytes(_store.addressOf(start), staged + start, length);
+    }
+    _writtenBytes = _ranges.totalBytes();
+    if (hasCRC) {
+      // レイアウト内の CRC フィールドへ書く場合も範囲より後に書くため上書きされない
+      session.put(_store.crcAddress(), crc);
+      _writtenBytes += sizeof(crc);
+    }
+    return session.commit();
+  }
+
+  /**
+   * @brief 何も書き込まずにトランザクションを終了する。
+   */
+  void rollback() {
+    _finished = true;
+    _ranges.clear();
+  }
+
+  /**
+   * @brief commit() で書き込んだバイト数を返す。
+   *
+   * @return size_t CRC を含む書き込みバイト数
+   */
+  size_t writtenBytes() const { return _writtenBytes; }
+
+  /**
+   * @brief 現在記録している変更範囲の数を返す。
+   *
+   * @return uint8_t 変更範囲の数
+   */
+  uint8_t rangeCount() const { return _ranges.count(); }
+
+ private:
+  const EEPROMLayoutStore<Layout>& _store;
+  Layout _staged;
+  EEPROMStoreUtil::DirtyRanges<kMaxRanges> _ranges;
+  bool _error;
+  bool _finished;
+  size_t _writtenBytes;
 };
 
 /**
@@ -416,6 +1603,7 @@ class EEPROMLayoutStore {
  *   - マジックナンバーによる初期化済み判定
  *   - EEPROM.put/get による簡潔な読み書き
  *   - デフォルト値による自動初期化
+ *   - TrackChanges = true で前回同期時からの変更範囲のみを書き込む
  *
  * 使い方:
  *   struct Config {
@@ -433,14 +1621,23 @@ class EEPROMLayoutStore {
  *     store.save();
  *   }
  *
+ * 差分書き込みモード:
+ *   EEPROMStore<Config, true> store(0, defaultCfg);
+ *
+ *   最後に読み込み・保存した内容のシャドウコピーを RAM に持ち、save() では
+ *   変更されたバイト範囲とヘッダのみを書き込む。変更がない場合は CRC の
+ *   計算も省略する。シャドウコピーの分だけ sizeof(T) の RAM を追加で使う。
+ *
  * @tparam T 保存対象の構造体
+ * @tparam TrackChanges true の場合は差分書き込みモードで動作する
  */
-template <typename T>
+template <typename T, bool TrackChanges = false>
 class EEPROMStore {
  public:
   /// 読み書き対象のデータ本体
   T data;
 
+#if EEPROM_STORE_HAS_BACKEND
   /**
    * @brief 保存先アドレスとデフォルト値を指定して初期化する。
    *
@@ -452,7 +1649,25 @@ class EEPROMStore {
       : _address(address),
         _defaults(defaults),
         _magic(magic),
-        _session(storageSizeFor(address)) {}
+        _session(storageSizeFor(address)),
+        _lastWriteBytes(0) {}
+#endif
+
+  /**
+   * @brief 読み書き先のバックエンドを指定して初期化する。
+   *
+   * @param backend 読み書き先のバックエンド
+   * @param address 保存先アドレス
+   * @param defaults 初期化時に使用するデフォルト値
+   * @param magic 保存領域を識別するマジック値
+   */
+  EEPROMStore(EEPROMBackend& backend, uint16_t address, const T& defaults,
+              uint16_t magic = 0xBEEF)
+      : _address(address),
+        _defaults(defaults),
+        _magic(magic),
+        _session(storageSizeFor(address), backend),
+        _lastWriteBytes(0) {}
 
   /**
    * @brief EEPROM からデータを読み込み、無効ならデフォルト値で初期化する。
@@ -481,6 +1696,10 @@ class EEPROMStore {
    * @return false 変更がなく、書き込みを省略した場合
    */
   bool save() {
+    if (_shadow.isValid()) {
+      return saveChanges();
+    }
+
     Header newHeader;
     newHeader.magic = _magic;
     newHeader.crc = dataCRC();
@@ -489,12 +1708,15 @@ class EEPROMStore {
     _session.get(_address, currentHeader);
     if (currentHeader.magic == newHeader.magic &&
         currentHeader.crc == newHeader.crc) {
+      _lastWriteBytes = 0;
       return false;
     }
 
     _session.put(_address, newHeader);
-    _session.put(static_cast<uint16_t>(_address + sizeof(Header)), data);
+    _session.put(dataAddress(), data);
     _session.commit();
+    _shadow.update(data);
+    _lastWriteBytes = requiredSize();
     return true;
   }
 
@@ -507,8 +1729,10 @@ class EEPROMStore {
     header.crc = dataCRC();
 
     _session.put(_address, header);
-    _session.put(static_cast<uint16_t>(_address + sizeof(Header)), data);
+    _session.put(dataAddress(), data);
     _session.commit();
+    _shadow.update(data);
+    _lastWriteBytes = requiredSize();
   }
 
   /**
@@ -535,16 +1759,49 @@ class EEPROMStore {
    */
   uint16_t nextAddress() const { return _address + requiredSize(); }
 
+  /**
+   * @brief 直前の save() / forceSave() で書き込んだバイト数を返す。
+   *
+   * @return size_t ヘッダを含む書き込みバイト数。書き込みを省略した場合は 0
+   */
+  size_t lastWriteBytes() const { return _lastWriteBytes; }
+
  private:
-  struct Header {
-    uint16_t magic;
-    uint16_t crc;
-  };
+  typedef EEPROMStoreUtil::RecordHeader Header;
 
   static constexpr uint16_t storageSizeFor(uint16_t address) {
     return static_cast<uint16_t>(address + requiredSize() + 64);
   }
 
+  uint16_t dataAddress() const {
+    return static_cast<uint16_t>(_address + sizeof(Header));
+  }
+
+  bool saveChanges() {
+    if (_shadow.equals(data)) {
+      _lastWriteBytes = 0;
+      return false;
+    }
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&data);
+    const uint16_t address = dataAddress();
+    const EEPROMSession& session = _session;
+    const size_t changed = _shadow.forEachChanged(
+        data, [&session, bytes, address](size_t offset, size_t length) {
+          session.putBytes(static_cast<uint16_t>(address + offset),
+                           bytes + offset, length);
+        });
+
+    Header header;
+    header.magic = _magic;
+    header.crc = dataCRC();
+    _session.put(_address, header);
+    _session.commit();
+    _shadow.update(data);
+    _lastWriteBytes = sizeof(Header) + changed;
+    return true;
+  }
+
   uint16_t dataCRC() const {
     return EEPROMStoreUtil::calcCRC(
         reinterpret_cast<const uint8_t*>(&data), sizeof(T));
@@ -557,14 +1814,13 @@ class EEPROMStore {
       return false;
     }
 
-    T temp;
-    _session.get(static_cast<uint16_t>(_address + sizeof(Header)), temp);
-    if (EEPROMStoreUtil::calcCRC(reinterpret_cast<const uint8_t*>(&temp),
-                                 sizeof(T)) != header.crc) {
+    // 失敗時は begin() でデフォルト値に戻すため、data へ直接読み込む
+    _session.get(dataAddress(), data);
+    if (dataCRC() != header.crc) {
       return false;
     }
 
-    data = temp;
+    _shadow.update(data);
     return true;
   }
 
@@ -572,8 +1828,8 @@ class EEPROMStore {
   T _defaults;
   uint16_t _magic;
   EEPROMSession _session;
+  EEPROMStoreUtil::ShadowCopy<T, TrackChanges> _shadow;
+  size_t _lastWriteBytes;
 };
 
-#endif  // EEPROM_STORE_HAS_BACKEND
-
 #endif  // EEPROM_STORE_H
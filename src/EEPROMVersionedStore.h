@@ -0,0 +1,448 @@
+#ifndef EEPROM_VERSIONED_STORE_H
+#define EEPROM_VERSIONED_STORE_H
+
+#include "EEPROMStore.h"
+
+namespace EEPROMStoreUtil {
+
+/**
+ * @brief スキーマバージョン付きレコードのヘッダ。
+ */
+struct VersionedHeader {
+  uint16_t magic;
+  uint16_t crc;
+  uint16_t version;
+  uint16_t size;
+};
+
+/**
+ * @brief 2 つの型が同じか判定する。
+ */
+template <typename A, typename B>
+struct IsSame {
+  static constexpr bool value = false;
+};
+
+template <typename A>
+struct IsSame<A, A> {
+  static constexpr bool value = true;
+};
+
+/**
+ * @brief 連続したマイグレーションを順に適用する。
+ *
+ * 中間バージョンの値はこの関数の中でだけ保持し、最後のマイグレーションは
+ * 呼び出し元の格納先へ直接書き込む。
+ */
+template <typename... Steps>
+struct MigrationChain;
+
+template <typename Step>
+struct MigrationChain<Step> {
+  template <typename T>
+  static void apply(const typename Step::From& from, T& out) {
+    static_assert(IsSame<typename Step::To, T>::value,
+                  "the last migration must produce the stored type");
+    Step::migrate(from, out);
+  }
+};
+
+template <typename Step, typename Next, typename... Rest>
+struct MigrationChain<Step, Next, Rest...> {
+  template <typename T>
+  static void apply(const typename Step::From& from, T& out) {
+    static_assert(IsSame<typename Step::To, typename Next::From>::value,
+                  "migrations must be listed in version order");
+    static_assert(Step::kFromVersion + 1 == Next::kFromVersion,
+                  "migration versions must be consecutive");
+    typename Step::To to = {};
+    Step::migrate(from, to);
+    MigrationChain<Next, Rest...>::apply(to, out);
+  }
+};
+
+}  // namespace EEPROMStoreUtil
+
+/**
+ * @brief マイグレーション関数をコンパイル時に登録するレジストリ。
+ *
+ * 各ステップは次のメンバを持つ型として定義する。
+ *   - `From` : 変換元の構造体
+ *   - `To` : 変換先の構造体
+ *   - `kFromVersion` : 変換元のスキーマバージョン(変換先は +1)
+ *   - `static void migrate(const From& from, To& to)` : 変換処理
+ *
+ * ステップは古いバージョンから順に並べる。
+ *
+ * @tparam Steps マイグレーションステップ
+ */
+template <typename... Steps>
+struct EEPROMMigrations;
+
+template <>
+struct EEPROMMigrations<> {
+  /// 変換元の構造体の最大サイズ
+  static constexpr size_t kMaxFromSize = 0;
+
+  template <typename T>
+  static bool run(const EEPROMSession&, uint16_t,
+                  const EEPROMStoreUtil::VersionedHeader&, T&) {
+    return false;
+  }
+
+  template <typename T>
+  static bool runLegacy(const EEPROMSession&, uint16_t, uint16_t, T&) {
+    return false;
+  }
+};
+
+template <typename Step, typename... Rest>
+struct EEPROMMigrations<Step, Rest...> {
+  /// 変換元の構造体の最大サイズ
+  static constexpr size_t kMaxFromSize =
+      sizeof(typename Step::From) > EEPROMMigrations<Rest...>::kMaxFromSize
+          ? sizeof(typename Step::From)
+          : EEPROMMigrations<Rest...>::kMaxFromSize;
+
+  /**
+   * @brief 保存済みバージョンに対応するステップから最新版まで変換する。
+   *
+   * @tparam T 最新バージョンの構造体
+   * @param session 使用する EEPROM セッション
+   * @param address 本体の保存先アドレス
+   * @param header 保存済みレコードのヘッダ
+   * @param out 変換結果の格納先。事前にデフォルト値を入れておく
+   * @return true 変換できた場合
+   * @return false 対応するステップがない、またはデータが壊れている場合
+   */
+  template <typename T>
+  static bool run(const EEPROMSession& session, uint16_t address,
+                  const EEPROMStoreUtil::VersionedHeader& header, T& out) {
+    typedef typename Step::From From;
+    if (header.version != Step::kFromVersion) {
+      return EEPROMMigrations<Rest...>::run(session, address, header, out);
+    }
+    if (header.size != sizeof(From)) {
+      return false;
+    }
+    return convert(session, address, header.crc, out);
+  }
+
+  /**
+   * @brief EEPROMStore<From> で保存したバージョンなしのレコードを変換する。
+   *
+   * バージョンなしのレコードはバージョン 0 として扱い、kFromVersion が 0 の
+   * ステップから最新版まで変換する。
+   *
+   * @tparam T 最新バージョンの構造体
+   * @param session 使用する EEPROM セッション
+   * @param address 本体の保存先アドレス(RecordHeader の直後)
+   * @param crc RecordHeader に保存された CRC
+   * @param out 変換結果の格納先。事前にデフォルト値を入れておく
+   * @return true 変換できた場合
+   * @return false バージョン 0 のステップがない、またはデータが壊れている場合
+   */
+  template <typename T>
+  static bool runLegacy(const EEPROMSession& session, uint16_t address,
+                        uint16_t crc, T& out) {
+    if (Step::kFromVersion != 0) {
+      return EEPROMMigrations<Rest...>::runLegacy(session, address, crc, out);
+    }
+    return convert(session, address, crc, out);
+  }
+
+ private:
+  template <typename T>
+  static bool convert(const EEPROMSession& session, uint16_t address,
+                      uint16_t crc, T& out) {
+    typedef typename Step::From From;
+    From from;
+    session.get(address, from);
+    if (EEPROMStoreUtil::calcCRC(reinterpret_cast<const uint8_t*>(&from),
+                                 sizeof(From)) != crc) {
+      return false;
+    }
+
+    EEPROMStoreUtil::MigrationChain<Step, Rest...>::apply(from, out);
+    return true;
+  }
+};
+
+template <typename Step, typename... Rest>
+constexpr size_t EEPROMMigrations<Step, Rest...>::kMaxFromSize;
+
+/**
+ * @brief スキーマバージョン付きで構造体を保存し、古い形式を自動変換するクラス。
+ *
+ * 特徴:
+ *   - ヘッダにスキーマバージョンと本体サイズを保存する
+ *   - begin() で古いバージョンのレコードを見つけた場合、登録した
+ *     マイグレーションを順に適用して最新版へ変換し、書き戻す
+ *   - EEPROMStore<From> で保存したバージョンなしのレコード(RecordHeader
+ *     + 本体)はバージョン 0 として扱う。kFromVersion = 0 のステップを
+ *     登録すると、EEPROMStore から移行できる
+ *   - 変換先は data へ直接書き込むため、T の一時コピーをスタックに置かない
+ *   - マイグレーションで値が設定されないフィールドはデフォルト値になる
+ *
+ * EEPROM 上の配置:
+ *   [ヘッダ 8 byte][本体 max(sizeof(T), 変換元の最大サイズ)]
+ *   [退避用ヘッダ 8 byte][退避用本体 sizeof(T)]
+ *
+ *   変換結果はまず後ろの退避領域へ書いて確定し、その後で本来の位置へ
+ *   書き戻す。書き戻しの途中で電源が切れても、次の begin() で退避領域から
+ *   復元するため、変換前の値は失われない。退避領域は変換時にしか
+ *   書き込まないが、requiredSize() に含まれるため他の領域と重ねないこと。
+ *   通常の save() は EEPROMStore と同じく上書き保存で、電源断への耐性はない。
+ *
+ * 使い方:
+ *   struct ConfigV1 { uint16_t interval; };
+ *   struct ConfigV2 { uint16_t interval; float threshold; };
+ *
+ *   struct ConfigV1ToV2 {
+ *     typedef ConfigV1 From;
+ *     typedef ConfigV2 To;
+ *     static const uint16_t kFromVersion = 1;
+ *     static void migrate(const ConfigV1& from, ConfigV2& to) {
+ *       to.interval = from.interval;
+ *     }
+ *   };
+ *
+ *   ConfigV2 defaults = {1000, 25.5f};
+ *   EEPROMVersionedStore<ConfigV2, 2, EEPROMMigrations<ConfigV1ToV2> > store(
+ *       0, defaults);
+ *
+ * 新しい T が古い T より大きい場合や、EEPROMStore から移行する場合は、
+ * 後ろに配置した領域と重ならないよう requiredSize() を基準にアドレスを
+ * 割り当てておくこと。
+ *
+ * @tparam T 最新バージョンの構造体
+ * @tparam Version 最新のスキーマバージョン
+ * @tparam Migrations EEPROMMigrations で登録したマイグレーション
+ */
+template <typename T, uint16_t Version,
+          typename Migrations = EEPROMMigrations<> >
+class EEPROMVersionedStore {
+ public:
+  /// 読み書き対象のデータ本体
+  T data;
+
+#if EEPROM_STORE_HAS_BACKEND
+  /**
+   * @brief 保存先アドレスとデフォルト値を指定して初期化する。
+   *
+   * @param address 保存先アドレス
+   * @param defaults 初期化時に使用するデフォルト値
+   * @param magic 保存領域を識別するマジック値
+   */
+  EEPROMVersionedStore(uint16_t address, const T& defaults,
+                       uint16_t magic = 0xBEEF)
+      : _address(address),
+        _defaults(defaults),
+        _magic(magic),
+        _session(storageSizeFor(address)),
+        _migrated(false) {}
+#endif
+
+  /**
+   * @brief 読み書き先のバックエンドを指定して初期化する。
+   *
+   * @param backend 読み書き先のバックエンド
+   * @param address 保存先アドレス
+   * @param defaults 初期化時に使用するデフォルト値
+   * @param magic 保存領域を識別するマジック値
+   */
+  EEPROMVersionedStore(EEPROMBackend& backend, uint16_t address,
+                       const T& defaults, uint16_t magic = 0xBEEF)
+      : _address(address),
+        _defaults(defaults),
+        _magic(magic),
+        _session(storageSizeFor(address), backend),
+        _migrated(false) {}
+
+  /**
+   * @brief EEPROM からデータを読み込み、必要なら最新版へ変換する。
+   *
+   * 変換できない場合はデフォルト値で初期化する。
+   *
+   * @return true 有効なデータを読み込めた、または変換できた場合
+   * @return false デフォルト値で初期化した場合
+   */
+  bool begin() {
+    _migrated = false;
+    if (!_session.begin()) {
+      return false;
+    }
+
+    if (load(_address)) {
+      discardScratch();
+      return true;
+    }
+
+    // 前回の変換が書き戻しの途中で止まった場合は、退避領域から復元する
+    if (load(scratchAddress())) {
+      writeRecord(_address);
+      discardScratch();
+      _migrated = true;
+      return true;
+    }
+
+    EEPROMStoreUtil::VersionedHeader header;
+    _session.get(_address, header);
+    if (header.magic == _magic) {
+      data = _defaults;
+      if (Migrations::run(_session, dataAddress(), header, data) ||
+          Migrations::runLegacy(_session, legacyDataAddress(), header.crc,
+                                data)) {
+        // 変換前のレコードを残したまま退避領域を確定してから書き戻す
+        writeRecord(scratchAddress());
+        writeRecord(_address);
+        discardScratch();
+        _migrated = true;
+        return true;
+      }
+    }
+
+    data = _defaults;
+    forceSave();
+    return false;
+  }
+
+  /**
+   * @brief 現在のデータを EEPROM に保存する。
+   *
+   * @return true データが変更され、書き込みを行った場合
+   * @return false 変更がなく、書き込みを省略した場合
+   */
+  bool save() {
+    EEPROMStoreUtil::VersionedHeader header;
+    _session.get(_address, header);
+    if (header.magic == _magic && header.version == Version &&
+        header.size == sizeof(T) && header.crc == dataCRC()) {
+      return false;
+    }
+
+    forceSave();
+    return true;
+  }
+
+  /**
+   * @brief 差分判定を行わずに現在のデータを書き込む。
+   */
+  void forceSave() { writeRecord(_address); }
+
+  /**
+   * @brief データをデフォルト値へ戻して保存する。
+   */
+  void reset() {
+    data = _defaults;
+    forceSave();
+  }
+
+  /**
+   * @brief 直前の begin() で古いバージョンから変換したか判定する。
+   *
+   * @return true 変換した場合
+   * @return false 変換していない場合
+   */
+  bool isMigrated() const { return _migrated; }
+
+  /**
+   * @brief 最新のスキーマバージョンを返す。
+   *
+   * @return uint16_t スキーマバージョン
+   */
+  static constexpr uint16_t version() { return Version; }
+
+  /**
+   * @brief このストアが必要とする EEPROM サイズを返す。
+   *
+   * @return uint16_t ヘッダ、本体、変換時の退避領域を含む必要サイズ
+   */
+  static constexpr uint16_t requiredSize() {
+    return static_cast<uint16_t>(kScratchOffset + kRecordSize);
+  }
+
+  /**
+   * @brief 次のストアを配置できる先頭アドレスを返す。
+   *
+   * @return uint16_t 次の先頭アドレス
+   */
+  uint16_t nextAddress() const { return _address + requiredSize(); }
+
+ private:
+  typedef EEPROMStoreUtil::VersionedHeader Header;
+
+  static constexpr size_t kRecordSize = sizeof(Header) + sizeof(T);
+  // 変換前のレコード(バージョンなしの EEPROMStore 形式を含む)と重ならない位置
+  static constexpr size_t kScratchOffset =
+      sizeof(Header) + (sizeof(T) > Migrations::kMaxFromSize
+                            ? sizeof(T)
+                            : Migrations::kMaxFromSize);
+
+  static constexpr uint16_t storageSizeFor(uint16_t address) {
+    return static_cast<uint16_t>(address + requiredSize() + 64);
+  }
+
+  uint16_t dataAddress() const {
+    return static_cast<uint16_t>(_address + sizeof(Header));
+  }
+
+  uint16_t legacyDataAddress() const {
+    return static_cast<uint16_t>(_address +
+                                 sizeof(EEPROMStoreUtil::RecordHeader));
+  }
+
+  uint16_t scratchAddress() const {
+    return static_cast<uint16_t>(_address + kScratchOffset);
+  }
+
+  // address に最新バージョンの有効なレコードがあれば data へ読み込む
+  bool load(uint16_t address) {
+    Header header;
+    _session.get(address, header);
+    if (header.magic != _magic || header.version != Version ||
+        header.size != sizeof(T)) {
+      return false;
+    }
+    _session.get(static_cast<uint16_t>(address + sizeof(Header)), data);
+    return dataCRC() == header.crc;
+  }
+
+  // 本体、ヘッダの順に書き込んで確定する
+  void writeRecord(uint16_t address) {
+    Header header;
+    header.magic = _magic;
+    header.crc = dataCRC();
+    header.version = Version;
+    header.size = sizeof(T);
+
+    _session.put(static_cast<uint16_t>(address + sizeof(Header)), data);
+    _session.put(address, header);
+    _session.commit();
+  }
+
+  // 退避領域が残っていればマジック値を壊して無効にする
+  void discardScratch() {
+    Header header;
+    _session.get(scratchAddress(), header);
+    if (header.magic != _magic) {
+      return;
+    }
+    header.magic = static_cast<uint16_t>(~_magic);
+    _session.put(scratchAddress(), header);
+    _session.commit();
+  }
+
+  uint16_t dataCRC() const {
+    return EEPROMStoreUtil::calcCRC(reinterpret_cast<const uint8_t*>(&data),
+                                    sizeof(T));
+  }
+
+  uint16_t _address;
+  T _defaults;
+  uint16_t _magic;
+  EEPROMSession _session;
+  bool _migrated;
+};
+
+#endif  // EEPROM_VERSIONED_STORE_H
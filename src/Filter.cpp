@@ -8,11 +8,13 @@
 /*                                                                     */
 /***********************************************************************/
 
+#if __has_include(<Arduino.h>)
 #include <Arduino.h>
+#endif
 
 #include "Filter.h"
+#include "FixedMath.hpp"
 
-#include <float.h>
 #include <math.h>
 
 
@@ -30,6 +32,17 @@ fix FirstFilter::calcTC(float freq, uint16_t cycleTime)
   return (FLOAT_TO_FIX(freq));
 }
 
+/* フィルタの時定数を固定小数点演算だけで計算する関数 */
+fix FirstFilter::calcTCFix(fix freq, uint16_t cycleTime)
+{
+  /* 2π [Q16.16] */
+  const int64_t twoPi = 411775;
+  const FixQ16 radPerHz =
+    FixQ16::fromRaw(FixedUtil::saturate<int32_t>((twoPi * cycleTime + 500) / 1000));
+  const FixQ16 omega = FixQ16::fromFix(freq) * radPerHz;
+  return (FixQ16::fromInt(1) - FixedMath::exp(-omega)).toFix();
+}
+
 /* 時定数からカットオフ周波数を計算 */
 float FirstFilter::calcFREQ(fix tc, uint16_t cycleTime)
 {
@@ -40,10 +53,22 @@ float FirstFilter::calcFREQ(fix tc, uint16_t cycleTime)
 
 /* フィルタを使う構造体の初期化 */
 FirstFilter::FirstFilter(enum eFILT_MODE fimo, float freq, uint16_t cycleTime, fix x0)
-  : _out(0), _mode(fimo), _tc(calcTC(freq, cycleTime)), _lpf(x0)
+  : _out(0), _mode(fimo), _tc(calcTC(freq, cycleTime)), _lpf(x0), _cycleTime(cycleTime)
 {
 }
 
+/* カットオフ周波数を変更する */
+void FirstFilter::setFrequency(float freq)
+{
+  _tc = calcTC(freq, _cycleTime);
+}
+
+/* カットオフ周波数を変更する（浮動小数点演算を使わない） */
+void FirstFilter::setFrequencyFix(fix freq)
+{
+  _tc = calcTCFix(freq, _cycleTime);
+}
+
 // ローパスフィルタ値を返す
 fix FirstFilter::getLPF(void)
 {
@@ -75,110 +100,318 @@ fix FirstFilter::firstFiltering(fix in)
   return (_out);
 }
 
+/* バッファ全体に1次フィルタをかける関数 (in と out は同じでもよい) */
+void FirstFilter::process(const fix* in, fix* out, size_t n)
+{
+  if (n == 0)
+    return;
+
+  fix lpf = _lpf;
+  const fix tc = _tc;
+  if (_mode == LPF)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      lpf += FIX_MUL(in[i] - lpf, tc);
+      out[i] = lpf;
+    }
+  }
+  else if (_mode == HPF)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      const fix x = in[i];
+      lpf += FIX_MUL(x - lpf, tc);
+      out[i] = x - lpf;
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      lpf += FIX_MUL(in[i] - lpf, tc);
+      out[i] = 0;
+    }
+  }
+  _lpf = lpf;
+  _out = out[n - 1];
+}
+
+/* バッファ全体に1次フィルタをかけ、結果で上書きする関数 */
+void FirstFilter::process(fix* data, size_t n)
+{
+  process(data, data, n);
+}
+
 /***********************************************************************/
-/*                          移動平均フィルタ                           */
+/*                          移動中央値フィルタ                         */
 /***********************************************************************/
 
-#define NEXT(n, size) (((n) + 1) % (size))
-#define BEFORE(n, size) (((n) + (size)-1) % (size))
+HampelFilter::HampelFilter(uint8_t size, float nSigma, fix x0)
+  : HampelFilterBase(FilterUtil::RuntimeWindow<uint8_t>(size), nSigma)
+{
+  attach(new fix[this->size()], new fix[this->size()], x0);
+}
 
-MovAveFilter::MovAveFilter(uint8_t size, fix x0) : _out(x0), _size(size), _now(0), _sum(x0 * size)
+HampelFilter::~HampelFilter()
 {
-  _data = new fix[_size];
-  setData(x0);
+  delete[] buffer();
+  delete[] sortedBuffer();
 }
 
-MovAveFilter::~MovAveFilter()
+/***********************************************************************/
+/*                          カルマンフィルタ                           */
+/***********************************************************************/
+
+/* Q2.30 の 1.0 */
+static const int64_t kKalmanOne = (int64_t)1 << 30;
+
+/* 分散 (float) を fix にする (負の値は 0) */
+static fix toVariance(float value)
 {
-  delete[] _data;
+  return value > 0.0f ? FLOAT_TO_FIX(value) : 0;
 }
 
-/**
- * @brief 指定した値で移動平均バッファの値を初期化する
- *
- * @param x0
- */
-void MovAveFilter::setData(fix x0)
+/* p / s を Q2.30 で求める (s が 0 以下ならゲイン 1) */
+static int64_t kalmanGain(int64_t p, int64_t s)
 {
-  for (uint8_t i = 0; i < _size; i++)
-  {
-    _data[i] = x0;
-  }
-  _sum = (int64_t)x0 * (int64_t)_size;
+  return s > 0 ? (p << 30) / s : kKalmanOne;
 }
 
-fix MovAveFilter::movingAverage(fix xn)
+/* Q2.30 のゲインを掛ける */
+static int64_t mulGain(int64_t gain, int64_t value)
 {
-  _sum -= (int64_t)_data[_now]; /* 一番古いのを消して */
-  _sum += (int64_t)xn;          /* 一番新しいのを足す */
-  _data[_now] = xn;             /* バッファに書きこむ */
-  _now = NEXT(_now, _size);
+  return FixedUtil::roundShiftRight(gain * value, 30);
+}
 
-  _out = (fix)(_sum / (int64_t)_size);
-  return _out;
+/* fix 同士を掛ける (丸めあり) */
+static int64_t mulFix(int64_t a, int64_t b)
+{
+  return FixedUtil::roundShiftRight(a * b, FIX_SHIFT_BIT);
 }
 
-// フィルタ出力値を返す
-fix MovAveFilter::getOut(void)
+KalmanFilter::KalmanFilter(float q, float r, fix x0, float p0)
+  : _x(x0), _p(toVariance(p0)), _q(toVariance(q)), _r(toVariance(r)), _gain(0)
 {
-  return _out;
 }
 
-/***********************************************************************/
-/*                          移動最大フィルタ                           */
-/***********************************************************************/
+/* 雑音の分散を変更する */
+void KalmanFilter::setNoise(float q, float r)
+{
+  _q = toVariance(q);
+  _r = toVariance(r);
+}
 
-MovMaxFilter::MovMaxFilter(uint8_t size, float x0) : _size(size), _now(0), _out(-1.0 * FLT_MAX)
+/* 推定値と推定誤差の分散を初期化する */
+void KalmanFilter::setData(fix x0, float p0)
 {
-  _data = new float[_size];
-  setData(x0);
+  _x = x0;
+  _p = toVariance(p0);
 }
 
-MovMaxFilter::~MovMaxFilter()
+/* 観測値 z で推定値を更新する */
+fix KalmanFilter::filtering(fix z)
 {
-  delete[] _data;
+  /* 予測 */
+  const int64_t p = (int64_t)_p + _q;
+  /* 更新 */
+  const int64_t gain = kalmanGain(p, p + _r);
+  _x = FixedUtil::saturate<int32_t>(_x + mulGain(gain, (int64_t)z - _x));
+  _p = FixedUtil::saturate<int32_t>(mulGain(kKalmanOne - gain, p));
+  _gain = (int32_t)gain;
+  return _x;
 }
 
-/**
- * @brief 指定した値で移動最大バッファの値を初期化する
- *
- * @param x0
- */
-void MovMaxFilter::setData(float x0)
+/* バッファ全体にフィルタをかける関数 (in と out は同じでもよい) */
+void KalmanFilter::process(const fix* in, fix* out, size_t n)
 {
-  for (uint8_t i = 0; i < _size; i++)
+  for (size_t i = 0; i < n; i++)
   {
-    _data[i] = x0;
+    out[i] = filtering(in[i]);
   }
-  _out = x0;
 }
 
-float MovMaxFilter::movingMax(float xn)
+/* バッファ全体にフィルタをかけ、結果で上書きする関数 */
+void KalmanFilter::process(fix* data, size_t n)
 {
-  if (xn > _out)
-  {
-    _out = xn;
-    _data[_now] = xn;
-  }
-  else if (_data[_now] == _out)
+  process(data, data, n);
+}
+
+// 直前のカルマンゲインを返す
+fix KalmanFilter::getGain(void) const
+{
+  return (fix)FixedUtil::roundShiftRight(_gain, 30 - FIX_SHIFT_BIT);
+}
+
+// 推定誤差の分散を返す
+fix KalmanFilter::getVariance(void) const
+{
+  return _p;
+}
+
+// フィルタ出力値(推定値)を返す
+fix KalmanFilter::getOut(void) const
+{
+  return _x;
+}
+
+KalmanFilter2::KalmanFilter2(uint16_t cycleTime, float qPos, float qVel, float r, fix x0, float p0)
+  : _dt((fix)((((int64_t)cycleTime << FIX_SHIFT_BIT) + 500) / 1000))
+{
+  setNoise(qPos, qVel, r);
+  setData(x0, 0, p0);
+}
+
+/* 雑音の分散を変更する */
+void KalmanFilter2::setNoise(float qPos, float qVel, float r)
+{
+  _qPos = toVariance(qPos);
+  _qVel = toVariance(qVel);
+  _r = toVariance(r);
+}
+
+/* 推定値と推定誤差の共分散を初期化する */
+void KalmanFilter2::setData(fix x0, fix v0, float p0)
+{
+  _x = x0;
+  _v = v0;
+  _p00 = toVariance(p0);
+  _p01 = 0;
+  _p11 = toVariance(p0);
+}
+
+/* 観測値 z で位置と速度を更新する */
+fix KalmanFilter2::filtering(fix z)
+{
+  /* 予測: x += v dt, P = F P F^T + Q */
+  const int64_t dt = _dt;
+  int64_t x = (int64_t)_x + mulFix(_v, dt);
+  int64_t p00 = (int64_t)_p00 + mulFix(dt, 2 * (int64_t)_p01 + mulFix(dt, _p11)) + _qPos;
+  int64_t p01 = (int64_t)_p01 + mulFix(dt, _p11);
+  int64_t p11 = (int64_t)_p11 + _qVel;
+
+  /* 更新 */
+  const int64_t s = p00 + _r;
+  const int64_t k0 = kalmanGain(p00, s);
+  const int64_t k1 = kalmanGain(p01, s);
+  const int64_t y = (int64_t)z - x;
+  x += mulGain(k0, y);
+  const int64_t v = (int64_t)_v + mulGain(k1, y);
+  p11 -= mulGain(k1, p01);
+  p00 = mulGain(kKalmanOne - k0, p00);
+  p01 = mulGain(kKalmanOne - k0, p01);
+
+  _x = FixedUtil::saturate<int32_t>(x);
+  _v = FixedUtil::saturate<int32_t>(v);
+  _p00 = FixedUtil::saturate<int32_t>(p00);
+  _p01 = FixedUtil::saturate<int32_t>(p01);
+  _p11 = FixedUtil::saturate<int32_t>(p11);
+  return _x;
+}
+
+/* バッファ全体にフィルタをかける関数 (in と out は同じでもよい) */
+void KalmanFilter2::process(const fix* in, fix* out, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
   {
-    _data[_now] = xn;
-    _out = -1.0 * FLT_MAX;
-    for (uint8_t i = 0; i < _size; i++)
-    {
-      if (_data[i] > _out)
-      {
-        _out = _data[i];
-      }
-    }
+    out[i] = filtering(in[i]);
   }
-  _now = NEXT(_now, _size);
+}
 
-  return _out;
+/* バッファ全体にフィルタをかけ、結果で上書きする関数 */
+void KalmanFilter2::process(fix* data, size_t n)
+{
+  process(data, data, n);
 }
 
-// フィルタ出力値を返す
-float MovMaxFilter::getOut(void)
+// 速度の推定値を返す [単位/s]
+fix KalmanFilter2::getVelocity(void) const
+{
+  return _v;
+}
+
+// 位置の推定誤差の分散を返す
+fix KalmanFilter2::getVariance(void) const
+{
+  return _p00;
+}
+
+// フィルタ出力値(位置の推定値)を返す
+fix KalmanFilter2::getOut(void) const
+{
+  return _x;
+}
+
+/***********************************************************************/
+/*                       双二次(バイカッド)フィルタ                     */
+/***********************************************************************/
+
+/* 係数を Q2.30 に変換する */
+static int32_t toBiquadQ30(double value)
+{
+  double scaled = value * 1073741824.0;
+  scaled += (scaled >= 0.0) ? 0.5 : -0.5;
+  if (scaled > (double)INT32_MAX)
+    return INT32_MAX;
+  if (scaled < (double)INT32_MIN)
+    return INT32_MIN;
+  return (int32_t)scaled;
+}
+
+/* a0 で正規化して係数を作る */
+static BiquadCoef makeBiquadCoef(double b0, double b1, double b2, double a0, double a1, double a2)
+{
+  BiquadCoef coef;
+  coef.b0 = toBiquadQ30(b0 / a0);
+  coef.b1 = toBiquadQ30(b1 / a0);
+  coef.b2 = toBiquadQ30(b2 / a0);
+  coef.a1 = toBiquadQ30(a1 / a0);
+  coef.a2 = toBiquadQ30(a2 / a0);
+  return coef;
+}
+
+/* 正規化角周波数と alpha を計算する (Audio EQ Cookbook) */
+static void calcBiquadOmega(float freq, float q, float sampleRate, double& cosw, double& alpha)
+{
+  double w0 = 2.0 * M_PI * freq / sampleRate;
+  cosw = cos(w0);
+  alpha = sin(w0) / (2.0 * q);
+}
+
+/* ローパスフィルタの係数を設計する */
+BiquadCoef designLowPass(float freq, float q, float sampleRate)
+{
+  double cosw, alpha;
+  calcBiquadOmega(freq, q, sampleRate, cosw, alpha);
+  return makeBiquadCoef((1.0 - cosw) / 2.0, 1.0 - cosw, (1.0 - cosw) / 2.0, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+}
+
+/* ハイパスフィルタの係数を設計する */
+BiquadCoef designHighPass(float freq, float q, float sampleRate)
+{
+  double cosw, alpha;
+  calcBiquadOmega(freq, q, sampleRate, cosw, alpha);
+  return makeBiquadCoef((1.0 + cosw) / 2.0, -(1.0 + cosw), (1.0 + cosw) / 2.0, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+}
+
+/* バンドパスフィルタの係数を設計する (中心周波数でゲイン 1) */
+BiquadCoef designBandPass(float freq, float q, float sampleRate)
+{
+  double cosw, alpha;
+  calcBiquadOmega(freq, q, sampleRate, cosw, alpha);
+  return makeBiquadCoef(alpha, 0.0, -alpha, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+}
+
+/* ノッチフィルタの係数を設計する */
+BiquadCoef designNotch(float freq, float q, float sampleRate)
+{
+  double cosw, alpha;
+  calcBiquadOmega(freq, q, sampleRate, cosw, alpha);
+  return makeBiquadCoef(1.0, -2.0 * cosw, 1.0, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+}
+
+/* 2N 次バターワースフィルタの section 段目の Q を計算する */
+float butterworthQ(uint8_t section, uint8_t sections)
 {
-  return _out;
+  return (float)(1.0 / (2.0 * cos(M_PI * (2.0 * section + 1.0) / (4.0 * sections))));
 }
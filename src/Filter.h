@@ -50,6 +50,9 @@
 /***********************************************************************/
 #pragma once
 
+#include <stddef.h>
+
+#include "FixedMath.hpp"
 #include "fix.hpp"
 
 /***********************************************************************/
@@ -68,13 +71,18 @@ class FirstFilter
 {
 public:
   FirstFilter(enum eFILT_MODE, float, uint16_t, fix x0 = 0);
+  void setFrequency(float);
+  void setFrequencyFix(fix);
   fix getLPF(void);
   void setLPF(fix);
   fix getOut(void);
   fix firstFiltering(fix);
+  void process(const fix*, fix*, size_t);
+  void process(fix*, size_t);
 
 private:
   fix calcTC(float, uint16_t);
+  fix calcTCFix(fix, uint16_t);
   float calcFREQ(fix, uint16_t);
   /** フィルタ後の出力値 */
   fix _out;
@@ -84,55 +92,1934 @@ private:
   fix _tc;
   /** ローパスフィルタ値 */
   fix _lpf;
+  /** フィルタリングを実行する周期[ms] */
+  uint16_t _cycleTime;
 };
 
+/***********************************************************************/
+/*                           リングバッファの窓                        */
+/***********************************************************************/
+/*                                                                     */
+/* 移動平均・移動最大・移動最小フィルタの窓のサイズを扱う。             */
+/* 実行時に決める RuntimeWindow と、コンパイル時に決める FixedWindow   */
+/* があり、FixedWindow は N が 2 のべき乗なら添字の折り返しをマスク、   */
+/* 平均の割り算をシフトで行う。                                        */
+/*                                                                     */
+/***********************************************************************/
+
+namespace FilterUtil
+{
+
+template <bool Byte, bool Word>
+struct IndexSelect
+{
+  typedef uint32_t Type;
+};
+
+template <bool Word>
+struct IndexSelect<true, Word>
+{
+  typedef uint8_t Type;
+};
+
+template <>
+struct IndexSelect<false, true>
+{
+  typedef uint16_t Type;
+};
+
+/**
+ * @brief 0 〜 N を表せる最小の添字の型
+ */
+template <size_t N>
+struct IndexFor
+{
+  typedef typename IndexSelect<(N <= 0xFF), (N <= 0xFFFF)>::Type Type;
+};
+
+/**
+ * @brief log2(N) の整数部
+ */
+template <size_t N>
+struct Log2
+{
+  static constexpr int value = 1 + Log2<N / 2>::value;
+};
+
+template <>
+struct Log2<1>
+{
+  static constexpr int value = 0;
+};
+
+/**
+ * @brief ceil(log2(n))
+ */
+constexpr int ceilLog2(size_t n)
+{
+  return n <= 1 ? 0 : 1 + ceilLog2((n + 1) / 2);
+}
+
+/**
+ * @brief 定数 d での割り算を逆数の掛け算で行う
+ *
+ * l = ceil(log2 d)、m = floor(2^(31+l) / d) + 1 とすると、0 <= n < 2^31 で
+ * (n * m) >> (31 + l) は n / d の切り捨てに一致する (Granlund & Montgomery)。
+ * 32x32→64 ビットの掛け算だけで済むので、64 ビットの割り算が遅い
+ * ESP32-C3 や Cortex-M0 で速い。|n| >= 2^31 のときは割り算を使う。
+ */
+class Reciprocal
+{
+public:
+  constexpr explicit Reciprocal(uint32_t divisor)
+    : _multiplier((uint32_t)(((uint64_t)1 << (31 + ceilLog2(divisor))) / divisor + 1)),
+      _shift((uint8_t)(31 + ceilLog2(divisor))),
+      _divisor(divisor)
+  {
+  }
+
+  /* sum / divisor (0 方向に切り捨て) */
+  template <typename Accumulator>
+  Accumulator divide(Accumulator sum) const
+  {
+    const int64_t wide = sum;
+    if (wide > -kLimit && wide < kLimit)
+    {
+      const uint32_t magnitude = (uint32_t)(wide < 0 ? -wide : wide);
+      const Accumulator quotient = (Accumulator)(((uint64_t)magnitude * _multiplier) >> _shift);
+      return wide < 0 ? -quotient : quotient;
+    }
+    return sum / (Accumulator)_divisor;
+  }
+
+private:
+  static constexpr int64_t kLimit = (int64_t)1 << 31;
+
+  /** 逆数 m */
+  uint32_t _multiplier;
+  /** 右シフト量 31 + l */
+  uint8_t _shift;
+  /** 割る数 */
+  uint32_t _divisor;
+};
+
+/**
+ * @brief 実行時にサイズを決める窓
+ *
+ * @tparam IndexT 添字の型
+ */
+template <typename IndexT>
+class RuntimeWindow
+{
+public:
+  typedef IndexT Index;
+
+  /* サイズ 0 は 1 として扱う */
+  explicit RuntimeWindow(Index size) : _size(size > 0 ? size : 1), _reciprocal(_size) {}
+
+  Index size(void) const
+  {
+    return _size;
+  }
+
+  /* リングバッファの次の添字 */
+  Index next(Index i) const
+  {
+    return ((size_t)i + 1 == _size) ? 0 : (Index)(i + 1);
+  }
+
+  /* 合計を窓のサイズで割る (0 方向に切り捨て) */
+  template <typename Accumulator>
+  Accumulator divide(Accumulator sum) const
+  {
+    return _reciprocal.divide(sum);
+  }
+
+private:
+  /** 窓のサイズ */
+  Index _size;
+  /** 窓のサイズの逆数 */
+  Reciprocal _reciprocal;
+};
+
+/**
+ * @brief コンパイル時にサイズを決める窓
+ *
+ * @tparam N 窓のサイズ (1 以上)
+ */
+template <size_t N>
+class FixedWindow
+{
+  static_assert(N > 0, "window size must be positive");
+
+public:
+  typedef typename IndexFor<N>::Type Index;
+  static constexpr bool kPowerOfTwo = (N & (N - 1)) == 0;
+
+  static constexpr Index size(void)
+  {
+    return (Index)N;
+  }
+
+  /* リングバッファの次の添字 (2 のべき乗ならマスク) */
+  static Index next(Index i)
+  {
+    return kPowerOfTwo ? (Index)((i + 1) & (N - 1)) : (((size_t)i + 1 == N) ? 0 : (Index)(i + 1));
+  }
+
+  /**
+   * @brief 合計を窓のサイズで割る (0 方向に切り捨て)
+   *
+   * 2 のべき乗ならシフトで割る。算術シフトは -∞ 方向に丸めるので、
+   * 負の合計には N - 1 を足して 0 方向の切り捨てにそろえる。
+   * それ以外は逆数の掛け算で割る。
+   */
+  template <typename Accumulator>
+  static Accumulator divide(Accumulator sum)
+  {
+    return kPowerOfTwo ? (Accumulator)((sum + (sum < 0 ? (Accumulator)(N - 1) : 0)) >> Log2<N>::value)
+                       : Reciprocal((uint32_t)N).divide(sum);
+  }
+};
+
+/**
+ * @brief 窓内の分散を求めない
+ */
+template <bool Enabled>
+class WindowVariance
+{
+public:
+  void reset(fix, size_t) {}
+  void update(fix, fix) {}
+};
+
+/**
+ * @brief 窓内の分散を 1 サンプルあたり O(1) で求める
+ *
+ * 二乗和 Σ round(x^2 / 2^16) を整数で持ち、出て行くサンプルの分を
+ * 同じ式で引くので、何サンプル処理しても誤差が蓄積しない。
+ * 平均の二乗は合計 S を S = qN + r に分けて S^2 / N^2 = q^2 + 2qr/N + (r/N)^2
+ * として求めるため、平均が大きく分散が小さい信号でも桁落ちしない。
+ * 結果の誤差は 2 LSB 程度。
+ */
+template <>
+class WindowVariance<true>
+{
+public:
+  WindowVariance() : _squares(0) {}
+
+  /* 窓を x0 で埋めた状態にする */
+  void reset(fix x0, size_t size)
+  {
+    _squares = square(x0) * (int64_t)size;
+  }
+
+  /* 窓から xOld が抜け、xNew が入る */
+  void update(fix xNew, fix xOld)
+  {
+    _squares += square(xNew) - square(xOld);
+  }
+
+  /**
+   * @brief 分散 (母分散)
+   *
+   * @param sum 窓内の合計
+   * @param size 窓のサイズ
+   */
+  fix variance(int64_t sum, size_t size) const
+  {
+    const int64_t n = (int64_t)size;
+    const int64_t q = sum / n;
+    const int64_t r = sum - q * n;
+    const int64_t meanSquare =
+      FixedUtil::roundShiftRight(q * q + (2 * q * r + r * r / n) / n, FIX_SHIFT_BIT);
+    const int64_t variance = _squares / n - meanSquare;
+    return (fix)(variance > 0 ? (variance < INT32_MAX ? variance : INT32_MAX) : 0);
+  }
+
+private:
+  static int64_t square(fix x)
+  {
+    return FixedUtil::roundShiftRight((int64_t)x * (int64_t)x, FIX_SHIFT_BIT);
+  }
+
+  /** 二乗和 [Q16.16] */
+  int64_t _squares;
+};
+
+}  // namespace FilterUtil
+
 /***********************************************************************/
 /*                          移動平均フィルタ                           */
 /***********************************************************************/
+/*                                                                     */
+/*   MovAveFilter x1(10);        // 窓 10、バッファはヒープに確保      */
+/*   MovAveFilterN<16> x2;       // 窓 16、バッファはオブジェクト内    */
+/*   MovAveFilterT<int32_t, uint16_t, true> x3(1000);                  */
+/*                               // 32 ビットの合計、窓 1000、分散あり */
+/*                                                                     */
+/* MovAveFilterN はヒープを使わず、N が 2 のべき乗なら割り算の代わりに */
+/* シフトを使う。それ以外は窓のサイズの逆数を掛けて割り算を避ける。    */
+/* 合計を int32_t にすると 64 ビットの加減算も避けられるが、           */
+/* |入力| × 窓のサイズ が 2^31 (fix で 32768.0) 未満である必要がある。 */
+/*                                                                     */
+/***********************************************************************/
 
-// クラス
-class MovAveFilter
+/**
+ * @brief 移動平均フィルタの共通部分
+ *
+ * バッファは派生クラスが用意し、attach() で渡す。
+ *
+ * @tparam Window 窓 (FilterUtil::RuntimeWindow / FixedWindow)
+ * @tparam Accumulator 合計の型 (int64_t / int32_t)
+ * @tparam WithVariance true なら窓内の分散も求める
+ */
+template <typename Window, typename Accumulator = int64_t, bool WithVariance = false>
+class MovAveFilterBase
 {
 public:
-  MovAveFilter(uint8_t, fix x0 = 0);
-  ~MovAveFilter();
-  void setData(fix);
-  fix movingAverage(fix);
-  fix getOut(void);
+  typedef typename Window::Index Index;
+
+  MovAveFilterBase(const MovAveFilterBase&) = delete;
+  MovAveFilterBase& operator=(const MovAveFilterBase&) = delete;
+
+  /**
+   * @brief 指定した値で移動平均バッファの値を初期化する
+   *
+   * @param x0
+   */
+  void setData(fix x0)
+  {
+    for (Index i = 0; i < _window.size(); i++)
+    {
+      _data[i] = x0;
+    }
+    _sum = (Accumulator)x0 * (Accumulator)_window.size();
+    _variance.reset(x0, _window.size());
+    _out = x0;
+  }
+
+  fix movingAverage(fix xn)
+  {
+    _variance.update(xn, _data[_now]);
+    _sum -= (Accumulator)_data[_now]; /* 一番古いのを消して */
+    _sum += (Accumulator)xn;          /* 一番新しいのを足す */
+    _data[_now] = xn;                 /* バッファに書きこむ */
+    _now = _window.next(_now);
+
+    _out = (fix)_window.divide(_sum);
+    return _out;
+  }
+
+  /**
+   * @brief バッファ全体に移動平均をかける (in と out は同じでもよい)
+   *
+   * 窓、合計、二乗和をローカル変数に移してから処理する。out への書き込みは
+   * メンバと別名になりうるので、メンバのままだと毎サンプル読み直しになる。
+   * リングバッファの折り返しまではまとめて進め、添字の判定を省く。
+   *
+   * @param in 入力バッファ
+   * @param out 出力バッファ
+   * @param n サンプル数
+   */
+  void process(const fix* in, fix* out, size_t n)
+  {
+    if (n == 0)
+    {
+      return;
+    }
+    const Window window = _window;
+    FilterUtil::WindowVariance<WithVariance> variance = _variance;
+    fix* const data = _data;
+    const size_t size = window.size();
+    Accumulator sum = _sum;
+    size_t now = _now;
+    for (size_t i = 0; i < n;)
+    {
+      const size_t run = (n - i < size - now) ? n - i : size - now;
+      const fix* src = in + i;
+      fix* dst = out + i;
+      fix* slot = data + now;
+      for (size_t k = 0; k < run; k++)
+      {
+        const fix x = src[k];
+        const fix old = slot[k];
+        sum += (Accumulator)x - (Accumulator)old;
+        variance.update(x, old);
+        slot[k] = x;
+        dst[k] = (fix)window.divide(sum);
+      }
+      i += run;
+      now += run;
+      if (now == size)
+      {
+        now = 0;
+      }
+    }
+    _sum = sum;
+    _variance = variance;
+    _now = (Index)now;
+    _out = out[n - 1];
+  }
+
+  /**
+   * @brief バッファ全体に移動平均をかけ、結果で上書きする
+   *
+   * @param data 入出力バッファ
+   * @param n サンプル数
+   */
+  void process(fix* data, size_t n)
+  {
+    process(data, data, n);
+  }
+
+  // フィルタ出力値を返す
+  fix getOut(void) const
+  {
+    return _out;
+  }
+
+  // 平均をとる個数を返す
+  Index size(void) const
+  {
+    return _window.size();
+  }
+
+  /**
+   * @brief 窓内の分散 (WithVariance が true のときだけ使える)
+   *
+   * バッファを走査せず、保持している合計と二乗和から求める。
+   */
+  fix getVariance(void) const
+  {
+    return _variance.variance(_sum, _window.size());
+  }
+
+  /**
+   * @brief 窓内の標準偏差 (WithVariance が true のときだけ使える)
+   */
+  fix getStdDev(void) const
+  {
+    return FixedMath::sqrt(FixQ16::fromFix(getVariance())).toFix();
+  }
+
+protected:
+  explicit MovAveFilterBase(Window window) : _out(0), _window(window), _now(0), _data(nullptr), _sum(0) {}
+
+  /* バッファ (size() 個) を設定して x0 で初期化する */
+  void attach(fix* data, fix x0)
+  {
+    _data = data;
+    _now = 0;
+    setData(x0);
+  }
+
+  fix* buffer(void) const
+  {
+    return _data;
+  }
 
 private:
   /** 移動平均出力値 */
   fix _out;
   /** 平均をとる個数 */
-  uint8_t _size;
+  Window _window;
   /** リングバッファ用現在値 */
-  uint8_t _now;
+  Index _now;
   /** 過去のデータを記憶しておくバッファ */
-  fix *_data;
+  fix* _data;
   /** 合計 */
-  int64_t _sum;
+  Accumulator _sum;
+  /** 二乗和 */
+  FilterUtil::WindowVariance<WithVariance> _variance;
+};
+
+/**
+ * @brief 移動平均フィルタ (窓のサイズを実行時に決める)
+ *
+ * @tparam Accumulator 合計の型 (int64_t / int32_t)
+ * @tparam Index 窓のサイズの型
+ * @tparam WithVariance true なら窓内の分散も求める
+ */
+template <typename Accumulator = int64_t, typename Index = uint8_t, bool WithVariance = false>
+class MovAveFilterT : public MovAveFilterBase<FilterUtil::RuntimeWindow<Index>, Accumulator, WithVariance>
+{
+public:
+  MovAveFilterT(Index size, fix x0 = 0)
+    : MovAveFilterBase<FilterUtil::RuntimeWindow<Index>, Accumulator, WithVariance>(
+        FilterUtil::RuntimeWindow<Index>(size))
+  {
+    this->attach(new fix[this->size()], x0);
+  }
+
+  ~MovAveFilterT()
+  {
+    delete[] this->buffer();
+  }
+};
+
+/**
+ * @brief 移動平均フィルタ (窓のサイズをコンパイル時に決める、ヒープ不使用)
+ *
+ * @tparam N 平均をとる個数
+ * @tparam Accumulator 合計の型 (int64_t / int32_t)
+ * @tparam WithVariance true なら窓内の分散も求める
+ */
+template <size_t N, typename Accumulator = int64_t, bool WithVariance = false>
+class MovAveFilterN : public MovAveFilterBase<FilterUtil::FixedWindow<N>, Accumulator, WithVariance>
+{
+public:
+  explicit MovAveFilterN(fix x0 = 0)
+    : MovAveFilterBase<FilterUtil::FixedWindow<N>, Accumulator, WithVariance>(FilterUtil::FixedWindow<N>())
+  {
+    this->attach(_storage, x0);
+  }
+
+private:
+  /** 過去のデータを記憶しておくバッファ */
+  fix _storage[N];
 };
 
+typedef MovAveFilterT<> MovAveFilter;
+
 /***********************************************************************/
-/*                          移動最大フィルタ                           */
+/*                     移動最大・移動最小フィルタ                      */
 /***********************************************************************/
+/*                                                                     */
+/* 窓内で最大値(最小値)になりうるサンプルの位置だけを単調デックに       */
+/* 保持するため、1 サンプルあたりの計算量は償却 O(1)。                  */
+/* 窓のサイズが 255 を超える場合は Index に uint16_t を指定する。      */
+/* 末尾が N のクラスは窓のサイズをコンパイル時に決め、ヒープを使わない。*/
+/*                                                                     */
+/*   MovMaxFilter x1(10);                       // float, 窓 10        */
+/*   MovMinFilterT<fix, uint16_t> x2(1000);     // fix, 窓 1000        */
+/*   MovMinMaxFilter x3(50);                    // 最大・最小・振幅    */
+/*   MovMaxFilterN<32, fix> x4;                 // fix, 窓 32          */
+/*                                                                     */
+/***********************************************************************/
+
+/**
+ * @brief 窓内の最大値(最小値)の候補の位置を保持する単調デック
+ *
+ * 位置は呼び出し側のリングバッファの添字で、値は呼び出し側が保持する。
+ *
+ * @tparam Index 添字の型
+ * @tparam IsMax true なら最大値、false なら最小値
+ */
+template <typename Index, bool IsMax>
+class MonotonicDeque
+{
+public:
+  MonotonicDeque() : _slots(nullptr), _size(0), _head(0), _len(0) {}
 
-class MovMaxFilter
+  /* 添字を格納する領域 (size 個) を設定する */
+  void attach(Index* slots, Index size)
+  {
+    _slots = slots;
+    _size = size;
+    _head = 0;
+    _len = 0;
+  }
+
+  /* 位置 pos のサンプルだけが候補の状態にする */
+  void reset(Index pos)
+  {
+    _head = 0;
+    _len = 1;
+    _slots[0] = pos;
+  }
+
+  /**
+   * @brief 位置 pos に書き込んだサンプルを追加する
+   *
+   * pos に前回あったサンプルは窓から外れたものとして扱う。
+   *
+   * @param data リングバッファ (data[pos] は書き込み済み)
+   * @param pos 書き込んだ位置
+   */
+  template <typename T>
+  void push(const T* data, Index pos)
+  {
+    if (_len > 0 && _slots[_head] == pos)
+    {
+      _head = wrap((size_t)_head + 1);
+      _len--;
+    }
+    while (_len > 0 && !isBetter(data[_slots[wrap((size_t)_head + _len - 1)]], data[pos]))
+    {
+      _len--;
+    }
+    _slots[wrap((size_t)_head + _len)] = pos;
+    _len++;
+  }
+
+  /* 窓内の最大値(最小値)の位置を返す */
+  Index front(void) const
+  {
+    return _slots[_head];
+  }
+
+private:
+  template <typename T>
+  static bool isBetter(const T& a, const T& b)
+  {
+    return IsMax ? (a > b) : (a < b);
+  }
+
+  Index wrap(size_t i) const
+  {
+    return (Index)(i >= _size ? i - _size : i);
+  }
+
+  /** 候補の位置 (リングバッファ) */
+  Index* _slots;
+  /** 窓のサイズ */
+  Index _size;
+  /** 先頭の候補 */
+  Index _head;
+  /** 候補の数 */
+  Index _len;
+};
+
+/**
+ * @brief 移動最大(最小)フィルタの共通部分
+ *
+ * バッファは派生クラスが用意し、attach() で渡す。
+ *
+ * @tparam T サンプルの型
+ * @tparam Window 窓 (FilterUtil::RuntimeWindow / FixedWindow)
+ * @tparam IsMax true なら最大値、false なら最小値
+ */
+template <typename T, typename Window, bool IsMax>
+class MovExtremeFilterBase
 {
 public:
-  MovMaxFilter(uint8_t, float x0 = 0);
-  ~MovMaxFilter();
-  void setData(float);
-  float movingMax(float);
-  float getOut(void);
+  typedef typename Window::Index Index;
+
+  MovExtremeFilterBase(const MovExtremeFilterBase&) = delete;
+  MovExtremeFilterBase& operator=(const MovExtremeFilterBase&) = delete;
+
+  /**
+   * @brief 指定した値でバッファの値を初期化する
+   *
+   * @param x0
+   */
+  void setData(T x0)
+  {
+    const Index size = _window.size();
+    for (Index i = 0; i < size; i++)
+    {
+      _data[i] = x0;
+    }
+    _deque.reset(_now == 0 ? (Index)(size - 1) : (Index)(_now - 1));
+    _out = x0;
+  }
+
+  // フィルタ出力値を返す
+  T getOut(void) const
+  {
+    return _out;
+  }
+
+  /**
+   * @brief バッファ全体にフィルタをかける (in と out は同じでもよい)
+   *
+   * @param in 入力バッファ
+   * @param out 出力バッファ
+   * @param n サンプル数
+   */
+  void process(const T* in, T* out, size_t n)
+  {
+    if (n == 0)
+    {
+      return;
+    }
+    T* data = _data;
+    Index now = _now;
+    for (size_t i = 0; i < n; i++)
+    {
+      data[now] = in[i];
+      _deque.push(data, now);
+      now = _window.next(now);
+      out[i] = data[_deque.front()];
+    }
+    _now = now;
+    _out = out[n - 1];
+  }
+
+  /**
+   * @brief バッファ全体にフィルタをかけ、結果で上書きする
+   *
+   * @param data 入出力バッファ
+   * @param n サンプル数
+   */
+  void process(T* data, size_t n)
+  {
+    process(data, data, n);
+  }
+
+protected:
+  explicit MovExtremeFilterBase(Window window) : _window(window), _now(0), _data(nullptr), _slots(nullptr), _out(0) {}
+
+  /* バッファと単調デック用の領域 (どちらも size() 個) を設定して x0 で初期化する */
+  void attach(T* data, Index* slots, T x0)
+  {
+    _data = data;
+    _slots = slots;
+    _now = 0;
+    _deque.attach(_slots, _window.size());
+    setData(x0);
+  }
+
+  Index size(void) const
+  {
+    return _window.size();
+  }
+
+  T* buffer(void) const
+  {
+    return _data;
+  }
+
+  Index* slots(void) const
+  {
+    return _slots;
+  }
+
+  T update(T xn)
+  {
+    _data[_now] = xn;
+    _deque.push(_data, _now);
+    _now = _window.next(_now);
+    _out = _data[_deque.front()];
+    return _out;
+  }
 
 private:
-  /** 平均をとる個数 */
-  uint8_t _size;
+  /** 窓のサイズ */
+  Window _window;
   /** リングバッファ用現在値 */
-  uint8_t _now;
+  Index _now;
   /** 過去のデータを記憶しておくバッファ */
-  float *_data;
+  T* _data;
+  /** 単調デック用の領域 */
+  Index* _slots;
+  /** 最大値(最小値)の候補 */
+  MonotonicDeque<Index, IsMax> _deque;
+  /** 最大値(最小値) */
+  T _out;
+};
+
+/**
+ * @brief 移動最大(最小)フィルタ (窓のサイズを実行時に決める)
+ *
+ * @tparam T サンプルの型
+ * @tparam Index 窓のサイズの型
+ * @tparam IsMax true なら最大値、false なら最小値
+ */
+template <typename T, typename Index, bool IsMax>
+class MovExtremeFilter : public MovExtremeFilterBase<T, FilterUtil::RuntimeWindow<Index>, IsMax>
+{
+public:
+  MovExtremeFilter(Index size, T x0 = 0)
+    : MovExtremeFilterBase<T, FilterUtil::RuntimeWindow<Index>, IsMax>(FilterUtil::RuntimeWindow<Index>(size))
+  {
+    this->attach(new T[this->size()], new Index[this->size()], x0);
+  }
+
+  ~MovExtremeFilter()
+  {
+    delete[] this->buffer();
+    delete[] this->slots();
+  }
+};
+
+/**
+ * @brief 移動最大(最小)フィルタ (窓のサイズをコンパイル時に決める、ヒープ不使用)
+ *
+ * @tparam T サンプルの型
+ * @tparam N 窓のサイズ
+ * @tparam IsMax true なら最大値、false なら最小値
+ */
+template <typename T, size_t N, bool IsMax>
+class MovExtremeFilterN : public MovExtremeFilterBase<T, FilterUtil::FixedWindow<N>, IsMax>
+{
+public:
+  typedef typename FilterUtil::FixedWindow<N>::Index Index;
+
+  explicit MovExtremeFilterN(T x0 = 0)
+    : MovExtremeFilterBase<T, FilterUtil::FixedWindow<N>, IsMax>(FilterUtil::FixedWindow<N>())
+  {
+    this->attach(_storage, _slotStorage, x0);
+  }
+
+private:
+  /** 過去のデータを記憶しておくバッファ */
+  T _storage[N];
+  /** 単調デック用の領域 */
+  Index _slotStorage[N];
+};
+
+/**
+ * @brief 移動最大フィルタ
+ */
+template <typename T = float, typename Index = uint8_t>
+class MovMaxFilterT : public MovExtremeFilter<T, Index, true>
+{
+public:
+  using MovExtremeFilter<T, Index, true>::MovExtremeFilter;
+
+  T movingMax(T xn)
+  {
+    return this->update(xn);
+  }
+};
+
+/**
+ * @brief 移動最小フィルタ
+ */
+template <typename T = float, typename Index = uint8_t>
+class MovMinFilterT : public MovExtremeFilter<T, Index, false>
+{
+public:
+  using MovExtremeFilter<T, Index, false>::MovExtremeFilter;
+
+  T movingMin(T xn)
+  {
+    return this->update(xn);
+  }
+};
+
+/**
+ * @brief 移動最大フィルタ (ヒープ不使用)
+ */
+template <size_t N, typename T = float>
+class MovMaxFilterN : public MovExtremeFilterN<T, N, true>
+{
+public:
+  using MovExtremeFilterN<T, N, true>::MovExtremeFilterN;
+
+  T movingMax(T xn)
+  {
+    return this->update(xn);
+  }
+};
+
+/**
+ * @brief 移動最小フィルタ (ヒープ不使用)
+ */
+template <size_t N, typename T = float>
+class MovMinFilterN : public MovExtremeFilterN<T, N, false>
+{
+public:
+  using MovExtremeFilterN<T, N, false>::MovExtremeFilterN;
+
+  T movingMin(T xn)
+  {
+    return this->update(xn);
+  }
+};
+
+typedef MovMaxFilterT<> MovMaxFilter;
+typedef MovMinFilterT<> MovMinFilter;
+
+/**
+ * @brief 窓内の最大値・最小値・振幅(最大値 - 最小値)を同時に求めるフィルタの共通部分
+ *
+ * リングバッファを 1 つだけ持ち、最大用と最小用の 2 つの単調デックで共有する。
+ * バッファは派生クラスが用意し、attach() で渡す。
+ *
+ * @tparam T サンプルの型
+ * @tparam Window 窓 (FilterUtil::RuntimeWindow / FixedWindow)
+ */
+template <typename T, typename Window>
+class MovMinMaxFilterBase
+{
+public:
+  typedef typename Window::Index Index;
+
+  MovMinMaxFilterBase(const MovMinMaxFilterBase&) = delete;
+  MovMinMaxFilterBase& operator=(const MovMinMaxFilterBase&) = delete;
+
+  /**
+   * @brief 指定した値でバッファの値を初期化する
+   *
+   * @param x0
+   */
+  void setData(T x0)
+  {
+    const Index size = _window.size();
+    for (Index i = 0; i < size; i++)
+    {
+      _data[i] = x0;
+    }
+    Index latest = _now == 0 ? (Index)(size - 1) : (Index)(_now - 1);
+    _maxDeque.reset(latest);
+    _minDeque.reset(latest);
+    _max = x0;
+    _min = x0;
+  }
+
+  /**
+   * @brief サンプルを追加して最大値・最小値を更新する
+   *
+   * @param xn 入力値
+   * @return T 振幅(最大値 - 最小値)
+   */
+  T movingMinMax(T xn)
+  {
+    _data[_now] = xn;
+    _maxDeque.push(_data, _now);
+    _minDeque.push(_data, _now);
+    _now = _window.next(_now);
+    _max = _data[_maxDeque.front()];
+    _min = _data[_minDeque.front()];
+    return getPeakToPeak();
+  }
+
+  /**
+   * @brief バッファ全体の振幅を求める (in と out は同じでもよい)
+   *
+   * @param in 入力バッファ
+   * @param out 振幅の出力バッファ
+   * @param n サンプル数
+   */
+  void process(const T* in, T* out, size_t n)
+  {
+    if (n == 0)
+    {
+      return;
+    }
+    T* data = _data;
+    Index now = _now;
+    for (size_t i = 0; i < n; i++)
+    {
+      data[now] = in[i];
+      _maxDeque.push(data, now);
+      _minDeque.push(data, now);
+      now = _window.next(now);
+      out[i] = data[_maxDeque.front()] - data[_minDeque.front()];
+    }
+    _now = now;
+    _max = data[_maxDeque.front()];
+    _min = data[_minDeque.front()];
+  }
+
+  /**
+   * @brief バッファ全体の振幅を求め、結果で上書きする
+   *
+   * @param data 入出力バッファ
+   * @param n サンプル数
+   */
+  void process(T* data, size_t n)
+  {
+    process(data, data, n);
+  }
+
+  // 最大値を返す
+  T getMax(void) const
+  {
+    return _max;
+  }
+
+  // 最小値を返す
+  T getMin(void) const
+  {
+    return _min;
+  }
+
+  // 振幅(最大値 - 最小値)を返す
+  T getPeakToPeak(void) const
+  {
+    return _max - _min;
+  }
+
+  // フィルタ出力値(振幅)を返す
+  T getOut(void) const
+  {
+    return getPeakToPeak();
+  }
+
+protected:
+  explicit MovMinMaxFilterBase(Window window) : _window(window), _now(0), _data(nullptr), _slots(nullptr), _max(0), _min(0)
+  {
+  }
+
+  /* バッファ (size() 個) と単調デック用の領域 (2 * size() 個) を設定して x0 で初期化する */
+  void attach(T* data, Index* slots, T x0)
+  {
+    _data = data;
+    _slots = slots;
+    _now = 0;
+    _maxDeque.attach(_slots, _window.size());
+    _minDeque.attach(_slots + _window.size(), _window.size());
+    setData(x0);
+  }
+
+  Index size(void) const
+  {
+    return _window.size();
+  }
+
+  T* buffer(void) const
+  {
+    return _data;
+  }
+
+  Index* slots(void) const
+  {
+    return _slots;
+  }
+
+private:
+  /** 窓のサイズ */
+  Window _window;
+  /** リングバッファ用現在値 */
+  Index _now;
+  /** 過去のデータを記憶しておくバッファ */
+  T* _data;
+  /** 単調デック用の領域 (最大用と最小用) */
+  Index* _slots;
+  /** 最大値の候補 */
+  MonotonicDeque<Index, true> _maxDeque;
+  /** 最小値の候補 */
+  MonotonicDeque<Index, false> _minDeque;
   /** 最大値 */
-  float _out;
+  T _max;
+  /** 最小値 */
+  T _min;
+};
+
+/**
+ * @brief 最大値・最小値・振幅を同時に求めるフィルタ (窓のサイズを実行時に決める)
+ */
+template <typename T = float, typename Index = uint8_t>
+class MovMinMaxFilterT : public MovMinMaxFilterBase<T, FilterUtil::RuntimeWindow<Index> >
+{
+public:
+  MovMinMaxFilterT(Index size, T x0 = 0)
+    : MovMinMaxFilterBase<T, FilterUtil::RuntimeWindow<Index> >(FilterUtil::RuntimeWindow<Index>(size))
+  {
+    this->attach(new T[this->size()], new Index[(size_t)this->size() * 2], x0);
+  }
+
+  ~MovMinMaxFilterT()
+  {
+    delete[] this->buffer();
+    delete[] this->slots();
+  }
+};
+
+/**
+ * @brief 最大値・最小値・振幅を同時に求めるフィルタ (ヒープ不使用)
+ */
+template <size_t N, typename T = float>
+class MovMinMaxFilterN : public MovMinMaxFilterBase<T, FilterUtil::FixedWindow<N> >
+{
+public:
+  typedef typename FilterUtil::FixedWindow<N>::Index Index;
+
+  explicit MovMinMaxFilterN(T x0 = 0) : MovMinMaxFilterBase<T, FilterUtil::FixedWindow<N> >(FilterUtil::FixedWindow<N>())
+  {
+    this->attach(_storage, _slotStorage, x0);
+  }
+
+private:
+  /** 過去のデータを記憶しておくバッファ */
+  T _storage[N];
+  /** 単調デック用の領域 (最大用と最小用) */
+  Index _slotStorage[N * 2];
 };
+
+typedef MovMinMaxFilterT<> MovMinMaxFilter;
+
+/***********************************************************************/
+/*                          移動中央値フィルタ                         */
+/***********************************************************************/
+/*                                                                     */
+/* 窓内のサンプルを常に昇順に並べた配列を持ち、1 サンプルごとに一番古い */
+/* 値を新しい値に置き換えて並びを保つ (毎回ソートはしない)。            */
+/* 置き換えで動かす要素は古い値と新しい値の間にあるものだけなので、     */
+/* インパルス状の雑音が少ない信号ほど速い。                            */
+/*                                                                     */
+/*   MedianFilter x1(9);           // fix, 窓 9                        */
+/*   MedianFilterN<15> x2;         // fix, 窓 15、ヒープ不使用         */
+/*   HampelFilter x3(15, 3.0f);    // 3σ を超える外れ値を中央値に置換  */
+/*                                                                     */
+/***********************************************************************/
+
+/**
+ * @brief 移動中央値フィルタの共通部分
+ *
+ * バッファは派生クラスが用意し、attach() で渡す。
+ *
+ * @tparam T サンプルの型
+ * @tparam Window 窓 (FilterUtil::RuntimeWindow / FixedWindow)
+ */
+template <typename T, typename Window>
+class MedianFilterBase
+{
+public:
+  typedef typename Window::Index Index;
+
+  MedianFilterBase(const MedianFilterBase&) = delete;
+  MedianFilterBase& operator=(const MedianFilterBase&) = delete;
+
+  /**
+   * @brief 指定した値でバッファの値を初期化する
+   *
+   * @param x0
+   */
+  void setData(T x0)
+  {
+    for (Index i = 0; i < _state.window.size(); i++)
+    {
+      _state.data[i] = x0;
+      _state.sorted[i] = x0;
+    }
+    _out = x0;
+  }
+
+  /**
+   * @brief サンプルを追加して中央値を更新する
+   *
+   * 窓のサイズが偶数のときは中央の 2 つの平均を返す。
+   *
+   * @param xn 入力値
+   * @return T 中央値
+   */
+  T movingMedian(T xn)
+  {
+    push(_state, xn);
+    _out = median(_state);
+    return _out;
+  }
+
+  /**
+   * @brief バッファ全体に移動中央値をかける (in と out は同じでもよい)
+   *
+   * 窓と添字をローカル変数に移してから処理し、出力値は最後に 1 回だけ保存する。
+   *
+   * @param in 入力バッファ
+   * @param out 出力バッファ
+   * @param n サンプル数
+   */
+  void process(const T* in, T* out, size_t n)
+  {
+    if (n == 0)
+    {
+      return;
+    }
+    State state = _state;
+    for (size_t i = 0; i < n; i++)
+    {
+      push(state, in[i]);
+      out[i] = median(state);
+    }
+    _state.now = state.now;
+    _out = out[n - 1];
+  }
+
+  /**
+   * @brief バッファ全体に移動中央値をかけ、結果で上書きする
+   *
+   * @param data 入出力バッファ
+   * @param n サンプル数
+   */
+  void process(T* data, size_t n)
+  {
+    process(data, data, n);
+  }
+
+  /**
+   * @brief 窓内で小さい方から rank 番目 (0 始まり) の値を返す
+   *
+   * rank が窓のサイズ以上なら最大値を返す。
+   */
+  T getRank(Index rank) const
+  {
+    return _state.sorted[rank < _state.window.size() ? rank : _state.window.size() - 1];
+  }
+
+  // フィルタ出力値(中央値)を返す
+  T getOut(void) const
+  {
+    return _out;
+  }
+
+protected:
+  /**
+   * @brief 窓とバッファ
+   *
+   * まとめて処理するときはローカル変数にコピーして使う。
+   */
+  struct State
+  {
+    explicit State(Window w) : window(w), now(0), data(nullptr), sorted(nullptr) {}
+
+    /** 窓のサイズ */
+    Window window;
+    /** リングバッファ用現在値 */
+    Index now;
+    /** 過去のデータを記憶しておくバッファ (到着順) */
+    T* data;
+    /** 窓内のデータ (昇順) */
+    T* sorted;
+  };
+
+  explicit MedianFilterBase(Window window) : _state(window), _out(0) {}
+
+  /* リングバッファと昇順の配列 (どちらも size() 個) を設定して x0 で初期化する */
+  void attach(T* data, T* sorted, T x0)
+  {
+    _state.data = data;
+    _state.sorted = sorted;
+    _state.now = 0;
+    setData(x0);
+  }
+
+  Index size(void) const
+  {
+    return _state.window.size();
+  }
+
+  T* buffer(void) const
+  {
+    return _state.data;
+  }
+
+  T* sortedBuffer(void) const
+  {
+    return _state.sorted;
+  }
+
+  State& state(void)
+  {
+    return _state;
+  }
+
+  const State& state(void) const
+  {
+    return _state;
+  }
+
+  /* 一番古いサンプルを xn に置き換え、昇順を保つ */
+  static void push(State& state, T xn)
+  {
+    T* const sorted = state.sorted;
+    const size_t size = state.window.size();
+    const T old = state.data[state.now];
+    state.data[state.now] = xn;
+    state.now = state.window.next(state.now);
+
+    // 古い値の位置を二分探索で探し、新しい値の位置まで間の要素をずらす
+    size_t pos = lowerBound(state, old);
+    if (old < xn)
+    {
+      while (pos + 1 < size && sorted[pos + 1] < xn)
+      {
+        sorted[pos] = sorted[pos + 1];
+        pos++;
+      }
+    }
+    else
+    {
+      while (pos > 0 && xn < sorted[pos - 1])
+      {
+        sorted[pos] = sorted[pos - 1];
+        pos--;
+      }
+    }
+    sorted[pos] = xn;
+  }
+
+  /* 窓の中央値 */
+  static T median(const State& state)
+  {
+    const size_t size = state.window.size();
+    const T upper = state.sorted[size / 2];
+    if (size % 2 != 0)
+    {
+      return upper;
+    }
+    const T lower = state.sorted[size / 2 - 1];
+    return lower + (upper - lower) / 2;
+  }
+
+  /**
+   * @brief 窓の中央値からの絶対偏差の中央値 (MAD)
+   *
+   * 昇順の配列を中央値から両側へたどると偏差は昇順に並ぶので、
+   * 2 つの列を併合しながら中央の順位まで数える。
+   */
+  static T medianAbsoluteDeviation(const State& state, T center)
+  {
+    const T* const sorted = state.sorted;
+    const size_t size = state.window.size();
+    size_t right = lowerBound(state, center);
+    size_t left = right;
+    const size_t target = size / 2;
+    T lower = 0;
+    T upper = 0;
+    for (size_t count = 0; count <= target; count++)
+    {
+      T deviation;
+      if (right < size && (left == 0 || sorted[right] - center <= center - sorted[left - 1]))
+      {
+        deviation = sorted[right++] - center;
+      }
+      else
+      {
+        deviation = center - sorted[--left];
+      }
+      lower = upper;
+      upper = deviation;
+    }
+    if (size % 2 != 0)
+    {
+      return upper;
+    }
+    return lower + (upper - lower) / 2;
+  }
+
+  /* 現在の窓の中央値 */
+  T median(void) const
+  {
+    return median(_state);
+  }
+
+private:
+  /* value 以上の最初の要素の位置 */
+  static size_t lowerBound(const State& state, T value)
+  {
+    size_t low = 0;
+    size_t high = state.window.size();
+    while (low < high)
+    {
+      const size_t mid = (low + high) / 2;
+      if (state.sorted[mid] < value)
+      {
+        low = mid + 1;
+      }
+      else
+      {
+        high = mid;
+      }
+    }
+    return low;
+  }
+
+  /** 窓とバッファ */
+  State _state;
+  /** 中央値 */
+  T _out;
+};
+
+/**
+ * @brief 移動中央値フィルタ (窓のサイズを実行時に決める)
+ */
+template <typename T = fix, typename Index = uint8_t>
+class MedianFilterT : public MedianFilterBase<T, FilterUtil::RuntimeWindow<Index> >
+{
+public:
+  MedianFilterT(Index size, T x0 = 0)
+    : MedianFilterBase<T, FilterUtil::RuntimeWindow<Index> >(FilterUtil::RuntimeWindow<Index>(size))
+  {
+    this->attach(new T[this->size()], new T[this->size()], x0);
+  }
+
+  ~MedianFilterT()
+  {
+    delete[] this->buffer();
+    delete[] this->sortedBuffer();
+  }
+};
+
+/**
+ * @brief 移動中央値フィルタ (ヒープ不使用)
+ */
+template <size_t N, typename T = fix>
+class MedianFilterN : public MedianFilterBase<T, FilterUtil::FixedWindow<N> >
+{
+public:
+  explicit MedianFilterN(T x0 = 0) : MedianFilterBase<T, FilterUtil::FixedWindow<N> >(FilterUtil::FixedWindow<N>())
+  {
+    this->attach(_storage, _sortedStorage, x0);
+  }
+
+private:
+  /** 過去のデータを記憶しておくバッファ (到着順) */
+  T _storage[N];
+  /** 窓内のデータ (昇順) */
+  T _sortedStorage[N];
+};
+
+typedef MedianFilterT<> MedianFilter;
+
+/**
+ * @brief Hampel フィルタ (外れ値除去) の共通部分
+ *
+ * 直近の窓の中央値 m と MAD (中央値からの絶対偏差の中央値) を求め、
+ * |x - m| > nSigma * 1.4826 * MAD なら x を外れ値とみなして m を出力する。
+ * それ以外は x をそのまま出力するので、外れ値以外では遅れが生じない。
+ * 1.4826 は正規分布で MAD を標準偏差に換算する係数。
+ *
+ * @tparam Window 窓 (FilterUtil::RuntimeWindow / FixedWindow)
+ */
+template <typename Window>
+class HampelFilterBase : protected MedianFilterBase<fix, Window>
+{
+  typedef typename MedianFilterBase<fix, Window>::State State;
+
+public:
+  typedef typename Window::Index Index;
+
+  /**
+   * @brief 指定した値でバッファの値を初期化する
+   *
+   * @param x0
+   */
+  void setData(fix x0)
+  {
+    MedianFilterBase<fix, Window>::setData(x0);
+    _out = x0;
+    _outlier = false;
+  }
+
+  /**
+   * @brief 外れ値の判定の閾値を変更する
+   *
+   * @param nSigma 標準偏差の何倍を外れ値とするか
+   */
+  void setThreshold(float nSigma)
+  {
+    _scale = FLOAT_TO_FIX(nSigma * 1.4826f);
+  }
+
+  /**
+   * @brief サンプルを追加して外れ値を除去する
+   *
+   * @param xn 入力値
+   * @return fix 外れ値なら窓の中央値、それ以外は xn
+   */
+  fix filtering(fix xn)
+  {
+    _out = filter(this->state(), _scale, xn, _outlier);
+    return _out;
+  }
+
+  /**
+   * @brief バッファ全体の外れ値を除去する (in と out は同じでもよい)
+   *
+   * 窓、添字、閾値をローカル変数に移してから処理し、出力値と外れ値の
+   * 判定は最後に 1 回だけ保存する。
+   *
+   * @param in 入力バッファ
+   * @param out 出力バッファ
+   * @param n サンプル数
+   */
+  void process(const fix* in, fix* out, size_t n)
+  {
+    if (n == 0)
+    {
+      return;
+    }
+    State state = this->state();
+    const fix scale = _scale;
+    bool outlier = false;
+    for (size_t i = 0; i < n; i++)
+    {
+      out[i] = filter(state, scale, in[i], outlier);
+    }
+    this->state().now = state.now;
+    _out = out[n - 1];
+    _outlier = outlier;
+  }
+
+  /**
+   * @brief バッファ全体の外れ値を除去し、結果で上書きする
+   *
+   * @param data 入出力バッファ
+   * @param n サンプル数
+   */
+  void process(fix* data, size_t n)
+  {
+    process(data, data, n);
+  }
+
+  // 直前のサンプルが外れ値だったかを返す
+  bool isOutlier(void) const
+  {
+    return _outlier;
+  }
+
+  // 窓の中央値を返す
+  fix getMedian(void) const
+  {
+    return this->median();
+  }
+
+  // フィルタ出力値を返す
+  fix getOut(void) const
+  {
+    return _out;
+  }
+
+protected:
+  HampelFilterBase(Window window, float nSigma)
+    : MedianFilterBase<fix, Window>(window), _out(0), _scale(0), _outlier(false)
+  {
+    setThreshold(nSigma);
+  }
+
+  /* リングバッファと昇順の配列 (どちらも size() 個) を設定して x0 で初期化する */
+  void attach(fix* data, fix* sorted, fix x0)
+  {
+    MedianFilterBase<fix, Window>::attach(data, sorted, x0);
+    _out = x0;
+  }
+
+private:
+  /* xn を窓に追加し、外れ値なら窓の中央値、それ以外は xn を返す */
+  static fix filter(State& state, fix scale, fix xn, bool& outlier)
+  {
+    MedianFilterBase<fix, Window>::push(state, xn);
+    const fix median = MedianFilterBase<fix, Window>::median(state);
+    const fix mad = MedianFilterBase<fix, Window>::medianAbsoluteDeviation(state, median);
+    const fix deviation = xn >= median ? xn - median : median - xn;
+    outlier = deviation > FIX_MUL(mad, scale);
+    return outlier ? median : xn;
+  }
+
+  /** フィルタ出力値 */
+  fix _out;
+  /** 閾値 (nSigma * 1.4826) */
+  fix _scale;
+  /** 直前のサンプルが外れ値か */
+  bool _outlier;
+};
+
+/**
+ * @brief Hampel フィルタ (窓のサイズを実行時に決める)
+ */
+class HampelFilter : public HampelFilterBase<FilterUtil::RuntimeWindow<uint8_t> >
+{
+public:
+  HampelFilter(uint8_t, float nSigma = 3.0f, fix x0 = 0);
+  ~HampelFilter();
+};
+
+/**
+ * @brief Hampel フィルタ (ヒープ不使用)
+ */
+template <size_t N>
+class HampelFilterN : public HampelFilterBase<FilterUtil::FixedWindow<N> >
+{
+public:
+  explicit HampelFilterN(float nSigma = 3.0f, fix x0 = 0)
+    : HampelFilterBase<FilterUtil::FixedWindow<N> >(FilterUtil::FixedWindow<N>(), nSigma)
+  {
+    this->attach(_storage, _sortedStorage, x0);
+  }
+
+private:
+  /** 過去のデータを記憶しておくバッファ (到着順) */
+  fix _storage[N];
+  /** 窓内のデータ (昇順) */
+  fix _sortedStorage[N];
+};
+
+/***********************************************************************/
+/*                          カルマンフィルタ                           */
+/***********************************************************************/
+/*                                                                     */
+/* 分散は観測値と同じ単位の 2 乗を fix (Q16.16) で表す。                */
+/* ゲインの計算は Q2.30 で行い、浮動小数点演算は使わない。              */
+/*                                                                     */
+/*   // 過程雑音の分散 0.01、観測雑音の分散 4.0                        */
+/*   KalmanFilter x1(0.01f, 4.0f);                                     */
+/*   // 10ms 周期で位置と速度を推定する                                */
+/*   KalmanFilter2 x2(10, 0.001f, 0.01f, 4.0f);                        */
+/*                                                                     */
+/***********************************************************************/
+
+/**
+ * @brief 1 状態のカルマンフィルタ (ランダムウォークモデル)
+ *
+ * x[k] = x[k-1] + w (分散 q)、z[k] = x[k] + v (分散 r)
+ */
+class KalmanFilter
+{
+public:
+  KalmanFilter(float q, float r, fix x0 = 0, float p0 = 1.0f);
+  void setNoise(float q, float r);
+  void setData(fix x0, float p0 = 1.0f);
+  fix filtering(fix);
+  void process(const fix*, fix*, size_t);
+  void process(fix*, size_t);
+  fix getGain(void) const;
+  fix getVariance(void) const;
+  fix getOut(void) const;
+
+private:
+  /** 推定値 */
+  fix _x;
+  /** 推定誤差の分散 */
+  fix _p;
+  /** 過程雑音の分散 */
+  fix _q;
+  /** 観測雑音の分散 */
+  fix _r;
+  /** 直前のカルマンゲイン [Q2.30] */
+  int32_t _gain;
+};
+
+/**
+ * @brief 2 状態のカルマンフィルタ (等速度モデル)
+ *
+ * 位置と速度を状態とし、位置だけを観測する。
+ * 過程雑音は位置と速度に独立に加わるものとする。
+ */
+class KalmanFilter2
+{
+public:
+  KalmanFilter2(uint16_t cycleTime, float qPos, float qVel, float r, fix x0 = 0, float p0 = 1.0f);
+  void setNoise(float qPos, float qVel, float r);
+  void setData(fix x0, fix v0 = 0, float p0 = 1.0f);
+  fix filtering(fix);
+  void process(const fix*, fix*, size_t);
+  void process(fix*, size_t);
+  fix getVelocity(void) const;
+  fix getVariance(void) const;
+  fix getOut(void) const;
+
+private:
+  /** 位置の推定値 */
+  fix _x;
+  /** 速度の推定値 [単位/s] */
+  fix _v;
+  /** 推定誤差の共分散 (対称行列の上三角) */
+  fix _p00, _p01, _p11;
+  /** 過程雑音の分散 (位置, 速度) */
+  fix _qPos, _qVel;
+  /** 観測雑音の分散 */
+  fix _r;
+  /** 周期 [s] */
+  fix _dt;
+};
+
+/***********************************************************************/
+/*                       双二次(バイカッド)フィルタ                     */
+/***********************************************************************/
+/*                                                                     */
+/* 2次の IIR フィルタ 1 段分を固定小数点で計算する。                    */
+/* 係数は Q2.30、入出力は fix (Q16.16)。                               */
+/* FilterCascade<N> は N 段を直列につなぎ、2N 次のフィルタになる。     */
+/*                                                                     */
+/*---------------------------------------------------------------------*/
+/*      例 (サンプリング周波数 1kHz、カットオフ 50Hz の 4 次 LPF)      */
+/*---------------------------------------------------------------------*/
+/*                                                                     */
+/*   FilterCascade<2> lpf;                                             */
+/*   designButterworthLowPass(lpf, 50.0f, 1000.0f);                    */
+/*                                                                     */
+/*   fix y = lpf.filtering(x);          // 1 サンプルずつ              */
+/*   lpf.process(buf, buf, 256);        // バッファをまとめて          */
+/*                                                                     */
+/***********************************************************************/
+
+// 計算方式
+enum eBIQUAD_FORM
+{
+  BIQUAD_DF1,  // 直接形 I : 状態を入出力の fix で持つ。係数を切り替えても乱れにくい
+  BIQUAD_DF2T  // 転置直接形 II : 状態を 64bit で持ち、状態数が少ない
+};
+
+/**
+ * @brief 双二次フィルタの係数 (a0 = 1 に正規化、Q2.30)
+ *
+ * y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ */
+struct BiquadCoef
+{
+  int32_t b0;
+  int32_t b1;
+  int32_t b2;
+  int32_t a1;
+  int32_t a2;
+};
+
+/* 係数を設計する関数 (freq, sampleRate は Hz) */
+BiquadCoef designLowPass(float freq, float q, float sampleRate);
+BiquadCoef designHighPass(float freq, float q, float sampleRate);
+BiquadCoef designBandPass(float freq, float q, float sampleRate);
+BiquadCoef designNotch(float freq, float q, float sampleRate);
+float butterworthQ(uint8_t section, uint8_t sections);
+
+/**
+ * @brief 双二次フィルタ 1 段分の状態
+ *
+ * @tparam Form 計算方式
+ */
+template <eBIQUAD_FORM Form>
+struct BiquadState;
+
+template <>
+struct BiquadState<BIQUAD_DF1>
+{
+  fix x1;
+  fix x2;
+  fix y1;
+  fix y2;
+
+  /* x0 を入力し続けた定常状態にする */
+  void reset(const BiquadCoef& coef, fix x0, fix y0)
+  {
+    (void)coef;
+    x1 = x0;
+    x2 = x0;
+    y1 = y0;
+    y2 = y0;
+  }
+
+  fix filtering(const BiquadCoef& c, fix x)
+  {
+    int64_t acc = (int64_t)c.b0 * x + (int64_t)c.b1 * x1 + (int64_t)c.b2 * x2 - (int64_t)c.a1 * y1 -
+                  (int64_t)c.a2 * y2;
+    fix y = (fix)((acc + (1 << 29)) >> 30);
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    return y;
+  }
+};
+
+template <>
+struct BiquadState<BIQUAD_DF2T>
+{
+  /* 状態は Q16.16 × Q2.30 = Q46 のまま保持する */
+  int64_t s1;
+  int64_t s2;
+
+  /* x0 を入力し続けた定常状態にする */
+  void reset(const BiquadCoef& c, fix x0, fix y0)
+  {
+    s1 = ((int64_t)y0 << 30) - (int64_t)c.b0 * x0;
+    s2 = (int64_t)c.b2 * x0 - (int64_t)c.a2 * y0;
+  }
+
+  fix filtering(const BiquadCoef& c, fix x)
+  {
+    int64_t acc = (int64_t)c.b0 * x + s1;
+    fix y = (fix)((acc + (1 << 29)) >> 30);
+    s1 = (int64_t)c.b1 * x - (int64_t)c.a1 * y + s2;
+    s2 = (int64_t)c.b2 * x - (int64_t)c.a2 * y;
+    return y;
+  }
+};
+
+/**
+ * @brief 双二次フィルタを N 段直列につないだフィルタ
+ *
+ * 係数と状態を段数分の配列で持ち、1 回の呼び出しで全段を計算する。
+ *
+ * @tparam N 段数 (フィルタの次数は 2N)
+ * @tparam Form 計算方式
+ */
+template <uint8_t N, eBIQUAD_FORM Form = BIQUAD_DF2T>
+class FilterCascade
+{
+  static_assert(N > 0, "FilterCascade needs at least one section");
+
+public:
+  FilterCascade() : _out(0)
+  {
+    for (uint8_t i = 0; i < N; i++)
+    {
+      _coef[i] = {1 << 30, 0, 0, 0, 0};
+    }
+    setData(0);
+  }
+
+  /**
+   * @brief 指定した段の係数を設定する（状態はそのまま）
+   *
+   * @param section 段の番号 (0 から N-1)
+   * @param coef 係数
+   */
+  void setCoef(uint8_t section, const BiquadCoef& coef)
+  {
+    if (section < N)
+    {
+      _coef[section] = coef;
+    }
+  }
+
+  /**
+   * @brief 指定した段の係数を取得する
+   *
+   * @param section 段の番号 (0 から N-1)
+   * @return const BiquadCoef& 係数
+   */
+  const BiquadCoef& getCoef(uint8_t section) const
+  {
+    return _coef[section < N ? section : N - 1];
+  }
+
+  /**
+   * @brief x0 を入力し続けた定常状態で初期化する
+   *
+   * @param x0 初期値
+   */
+  void setData(fix x0)
+  {
+    fix x = x0;
+    for (uint8_t i = 0; i < N; i++)
+    {
+      fix y = steadyOutput(_coef[i], x);
+      _state[i].reset(_coef[i], x, y);
+      x = y;
+    }
+    _out = x;
+  }
+
+  /**
+   * @brief 1 サンプル分フィルタをかける
+   *
+   * @param in 入力値
+   * @return fix 出力値
+   */
+  fix filtering(fix in)
+  {
+    for (uint8_t i = 0; i < N; i++)
+    {
+      in = _state[i].filtering(_coef[i], in);
+    }
+    _out = in;
+    return _out;
+  }
+
+  /**
+   * @brief バッファ全体にフィルタをかける
+   *
+   * 段ごとにバッファを走査するため、係数をレジスタに置いたまま計算できる。
+   * in と out は同じバッファでもよい。
+   *
+   * @param in 入力バッファ
+   * @param out 出力バッファ
+   * @param n サンプル数
+   */
+  void process(const fix* in, fix* out, size_t n)
+  {
+    if (n == 0)
+    {
+      return;
+    }
+    const fix* src = in;
+    for (uint8_t i = 0; i < N; i++)
+    {
+      const BiquadCoef coef = _coef[i];
+      BiquadState<Form> state = _state[i];
+      for (size_t k = 0; k < n; k++)
+      {
+        out[k] = state.filtering(coef, src[k]);
+      }
+      _state[i] = state;
+      src = out;
+    }
+    _out = out[n - 1];
+  }
+
+  /**
+   * @brief バッファ全体にフィルタをかけ、結果で上書きする
+   *
+   * @param data 入出力バッファ
+   * @param n サンプル数
+   */
+  void process(fix* data, size_t n)
+  {
+    process(data, data, n);
+  }
+
+  // フィルタ出力値を返す
+  fix getOut(void) const
+  {
+    return _out;
+  }
+
+  // 段数を返す
+  static constexpr uint8_t sections(void)
+  {
+    return N;
+  }
+
+private:
+  /* 直流ゲインから定常出力を求める */
+  static fix steadyOutput(const BiquadCoef& c, fix x)
+  {
+    int64_t num = (int64_t)c.b0 + c.b1 + c.b2;
+    int64_t den = ((int64_t)1 << 30) + c.a1 + c.a2;
+    if (den == 0)
+    {
+      return x;
+    }
+    double y = (double)num * x / (double)den;
+    if (y > (double)INT32_MAX)
+    {
+      return INT32_MAX;
+    }
+    if (y < (double)INT32_MIN)
+    {
+      return INT32_MIN;
+    }
+    return (fix)y;
+  }
+
+  /** 各段の係数 */
+  BiquadCoef _coef[N];
+  /** 各段の状態 */
+  BiquadState<Form> _state[N];
+  /** フィルタ後の出力値 */
+  fix _out;
+};
+
+/**
+ * @brief 1 段の双二次フィルタ
+ */
+template <eBIQUAD_FORM Form = BIQUAD_DF2T>
+using Biquad = FilterCascade<1, Form>;
+
+/**
+ * @brief バターワース LPF を設計する (次数 2N)
+ *
+ * @param filter 設定するフィルタ
+ * @param freq カットオフ周波数 [Hz]
+ * @param sampleRate サンプリング周波数 [Hz]
+ */
+template <uint8_t N, eBIQUAD_FORM Form>
+void designButterworthLowPass(FilterCascade<N, Form>& filter, float freq, float sampleRate)
+{
+  for (uint8_t i = 0; i < N; i++)
+  {
+    filter.setCoef(i, designLowPass(freq, butterworthQ(i, N), sampleRate));
+  }
+  filter.setData(filter.getOut());
+}
+
+/**
+ * @brief バターワース HPF を設計する (次数 2N)
+ *
+ * @param filter 設定するフィルタ
+ * @param freq カットオフ周波数 [Hz]
+ * @param sampleRate サンプリング周波数 [Hz]
+ */
+template <uint8_t N, eBIQUAD_FORM Form>
+void designButterworthHighPass(FilterCascade<N, Form>& filter, float freq, float sampleRate)
+{
+  for (uint8_t i = 0; i < N; i++)
+  {
+    filter.setCoef(i, designHighPass(freq, butterworthQ(i, N), sampleRate));
+  }
+  filter.setData(0);
+}
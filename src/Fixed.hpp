@@ -0,0 +1,335 @@
+/**
+ * @file Fixed.hpp
+ * @brief 型付きの固定小数点数
+ * @author Tatsuya Miyazaki
+ *
+ * @details 整数部と小数部のビット数を型で指定する固定小数点数クラス。
+ * fix.hpp のマクロと異なり、次の特徴を持つ。
+ *   - 変換と四則演算を constexpr で行える
+ *   - 乗除算は丸めを行い、結果が範囲外になる場合は最大値・最小値で飽和させる
+ *   - FIXED_POINT_CHECK_OVERFLOW を 1 に定義すると、飽和が起きた時点で assert() する
+ *   - fromFix() / toFix() で既存の fix (Q16.16) と相互に変換できる
+ *
+ * 使い方:
+ *   typedef Fixed<16, 16> Q16;           // fix と同じ Q16.16
+ *   typedef Fixed<8, 8, int16_t> Q8;     // 16bit で済ませたい場合
+ *
+ *   constexpr Q16 gain = Q16::fromFloat(0.25f);
+ *   Q16 x = Q16::fromFix(filter.getOut());
+ *   x = x * gain + Q16::fromInt(1);
+ *   fix y = x.toFix();
+ *
+ * @note Arduino.h に依存しないため、ホスト環境でもそのままコンパイルできる
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef FIXED_POINT_CHECK_OVERFLOW
+#define FIXED_POINT_CHECK_OVERFLOW 0
+#endif
+
+#if FIXED_POINT_CHECK_OVERFLOW
+#include <assert.h>
+#endif
+
+namespace FixedUtil
+{
+
+/**
+ * @brief 格納型と、乗算の途中結果を保持する 2 倍幅の型の組
+ */
+template <typename Storage>
+struct Traits;
+
+template <>
+struct Traits<int8_t>
+{
+  typedef int16_t Wide;
+  static constexpr int8_t kMax = INT8_MAX;
+  static constexpr int8_t kMin = INT8_MIN;
+};
+
+template <>
+struct Traits<int16_t>
+{
+  typedef int32_t Wide;
+  static constexpr int16_t kMax = INT16_MAX;
+  static constexpr int16_t kMin = INT16_MIN;
+};
+
+template <>
+struct Traits<int32_t>
+{
+  typedef int64_t Wide;
+  static constexpr int32_t kMax = INT32_MAX;
+  static constexpr int32_t kMin = INT32_MIN;
+};
+
+/**
+ * @brief 飽和が起きたことを通知する
+ *
+ * FIXED_POINT_CHECK_OVERFLOW が 1 の場合だけ assert() する。
+ */
+inline void reportOverflow()
+{
+#if FIXED_POINT_CHECK_OVERFLOW
+  assert(!"fixed-point overflow");
+#endif
+}
+
+/**
+ * @brief 飽和した値を返す（チェック有効時は通知してから返す）
+ */
+template <typename T>
+constexpr T overflowed(T value)
+{
+  return FIXED_POINT_CHECK_OVERFLOW ? (reportOverflow(), value) : value;
+}
+
+/**
+ * @brief 値を格納型の範囲に収める
+ *
+ * @tparam Storage 格納型
+ * @tparam T 入力値の型
+ * @param value 入力値
+ * @return Storage 範囲内に収めた値
+ */
+template <typename Storage, typename T>
+constexpr Storage saturate(T value)
+{
+  return value > static_cast<T>(Traits<Storage>::kMax)
+           ? overflowed(Traits<Storage>::kMax)
+           : value < static_cast<T>(Traits<Storage>::kMin) ? overflowed(Traits<Storage>::kMin)
+                                                           : static_cast<Storage>(value);
+}
+
+/**
+ * @brief 四捨五入付きの算術右シフト
+ *
+ * @param value 入力値
+ * @param shift シフト量（1 以上）
+ * @return int64_t シフト結果
+ */
+constexpr int64_t roundShiftRight(int64_t value, int shift)
+{
+  return (value + (static_cast<int64_t>(1) << (shift - 1))) >> shift;
+}
+
+/**
+ * @brief 小数部のビット数を From から To へ変更する
+ */
+template <int From, int To, bool Left = (To >= From)>
+struct Rescale;
+
+template <int From, int To>
+struct Rescale<From, To, true>
+{
+  static constexpr int64_t apply(int64_t value) { return value * (static_cast<int64_t>(1) << (To - From)); }
+};
+
+template <int From, int To>
+struct Rescale<From, To, false>
+{
+  static constexpr int64_t apply(int64_t value) { return roundShiftRight(value, From - To); }
+};
+
+}  // namespace FixedUtil
+
+/**
+ * @brief 固定小数点数
+ *
+ * @tparam IntBits 符号ビットを含む整数部のビット数
+ * @tparam FracBits 小数部のビット数
+ * @tparam Storage 格納型（int8_t / int16_t / int32_t）
+ */
+template <int IntBits, int FracBits, typename Storage = int32_t>
+class Fixed
+{
+  static_assert(IntBits + FracBits == static_cast<int>(sizeof(Storage) * 8),
+                "IntBits + FracBits must match the storage width");
+  static_assert(IntBits >= 2 && FracBits >= 1, "at least 2 integer bits and 1 fraction bit are required");
+
+public:
+  /** 格納型 */
+  typedef Storage StorageType;
+  /** 乗除算の途中結果に使う型 */
+  typedef typename FixedUtil::Traits<Storage>::Wide WideType;
+
+  /** 整数部のビット数 */
+  static constexpr int kIntBits = IntBits;
+  /** 小数部のビット数 */
+  static constexpr int kFracBits = FracBits;
+  /** 1.0 を表す生の値 */
+  static constexpr WideType kOne = static_cast<WideType>(1) << FracBits;
+
+  constexpr Fixed() : _raw(0) {}
+
+  /**
+   * @brief 生の値から作る
+   *
+   * @param raw 生の値
+   * @return Fixed 固定小数点数
+   */
+  static constexpr Fixed fromRaw(Storage raw) { return Fixed(raw, RawTag()); }
+
+  /**
+   * @brief 整数から作る（範囲外は飽和）
+   *
+   * @param value 整数
+   * @return Fixed 固定小数点数
+   */
+  static constexpr Fixed fromInt(int32_t value)
+  {
+    return fromRaw(FixedUtil::saturate<Storage>(static_cast<int64_t>(value) * kOne));
+  }
+
+  /**
+   * @brief 浮動小数点数から作る（四捨五入、範囲外は飽和）
+   *
+   * @param value 浮動小数点数
+   * @return Fixed 固定小数点数
+   */
+  static constexpr Fixed fromFloat(float value)
+  {
+    return fromRaw(FixedUtil::saturate<Storage>(value * static_cast<float>(kOne) + (value >= 0.0f ? 0.5f : -0.5f)));
+  }
+
+  /**
+   * @brief fix (Q16.16) から作る
+   *
+   * @param value fix.hpp の固定小数点数
+   * @return Fixed 固定小数点数
+   */
+  static constexpr Fixed fromFix(int32_t value)
+  {
+    return fromRaw(FixedUtil::saturate<Storage>(FixedUtil::Rescale<16, FracBits>::apply(value)));
+  }
+
+  /**
+   * @brief 表現できる最大値
+   */
+  static constexpr Fixed max() { return fromRaw(FixedUtil::Traits<Storage>::kMax); }
+
+  /**
+   * @brief 表現できる最小値
+   */
+  static constexpr Fixed min() { return fromRaw(FixedUtil::Traits<Storage>::kMin); }
+
+  /**
+   * @brief 表現できる最小の正の値
+   */
+  static constexpr Fixed epsilon() { return fromRaw(1); }
+
+  /**
+   * @brief 生の値を返す
+   *
+   * @return Storage 生の値
+   */
+  constexpr Storage raw() const { return _raw; }
+
+  /**
+   * @brief 浮動小数点数へ変換する
+   *
+   * @return float 変換結果
+   */
+  constexpr float toFloat() const { return static_cast<float>(_raw) / static_cast<float>(kOne); }
+
+  /**
+   * @brief 整数へ変換する（FIX_TO_INT と同じく 0.5 を切り上げ）
+   *
+   * @return int32_t 変換結果
+   */
+  constexpr int32_t toInt() const
+  {
+    return static_cast<int32_t>(FixedUtil::roundShiftRight(_raw, FracBits));
+  }
+
+  /**
+   * @brief fix (Q16.16) へ変換する（範囲外は飽和）
+   *
+   * @return int32_t fix.hpp の固定小数点数
+   */
+  constexpr int32_t toFix() const
+  {
+    return FixedUtil::saturate<int32_t>(FixedUtil::Rescale<FracBits, 16>::apply(_raw));
+  }
+
+  /**
+   * @brief 別の Q フォーマットへ変換する（範囲外は飽和）
+   *
+   * @tparam I 変換先の整数部ビット数
+   * @tparam F 変換先の小数部ビット数
+   * @tparam S 変換先の格納型
+   * @return Fixed<I, F, S> 変換結果
+   */
+  template <int I, int F, typename S>
+  constexpr Fixed<I, F, S> convert() const
+  {
+    return Fixed<I, F, S>::fromRaw(FixedUtil::saturate<S>(FixedUtil::Rescale<FracBits, F>::apply(_raw)));
+  }
+
+  constexpr Fixed operator-() const { return fromRaw(FixedUtil::saturate<Storage>(-static_cast<WideType>(_raw))); }
+
+  friend constexpr Fixed operator+(Fixed a, Fixed b)
+  {
+    return fromRaw(FixedUtil::saturate<Storage>(static_cast<WideType>(a._raw) + b._raw));
+  }
+
+  friend constexpr Fixed operator-(Fixed a, Fixed b)
+  {
+    return fromRaw(FixedUtil::saturate<Storage>(static_cast<WideType>(a._raw) - b._raw));
+  }
+
+  /**
+   * @brief 乗算（四捨五入、範囲外は飽和）
+   */
+  friend constexpr Fixed operator*(Fixed a, Fixed b)
+  {
+    return fromRaw(
+      FixedUtil::saturate<Storage>(FixedUtil::roundShiftRight(static_cast<WideType>(a._raw) * b._raw, FracBits)));
+  }
+
+  /**
+   * @brief 除算（0 から遠い方へ四捨五入、範囲外と 0 除算は飽和）
+   */
+  friend constexpr Fixed operator/(Fixed a, Fixed b)
+  {
+    return b._raw == 0
+             ? (a._raw >= 0 ? fromRaw(FixedUtil::overflowed(FixedUtil::Traits<Storage>::kMax))
+                            : fromRaw(FixedUtil::overflowed(FixedUtil::Traits<Storage>::kMin)))
+             : fromRaw(FixedUtil::saturate<Storage>(divideRounded(static_cast<int64_t>(a._raw) * kOne, b._raw)));
+  }
+
+  Fixed& operator+=(Fixed other) { return *this = *this + other; }
+  Fixed& operator-=(Fixed other) { return *this = *this - other; }
+  Fixed& operator*=(Fixed other) { return *this = *this * other; }
+  Fixed& operator/=(Fixed other) { return *this = *this / other; }
+
+  friend constexpr bool operator==(Fixed a, Fixed b) { return a._raw == b._raw; }
+  friend constexpr bool operator!=(Fixed a, Fixed b) { return a._raw != b._raw; }
+  friend constexpr bool operator<(Fixed a, Fixed b) { return a._raw < b._raw; }
+  friend constexpr bool operator<=(Fixed a, Fixed b) { return a._raw <= b._raw; }
+  friend constexpr bool operator>(Fixed a, Fixed b) { return a._raw > b._raw; }
+  friend constexpr bool operator>=(Fixed a, Fixed b) { return a._raw >= b._raw; }
+
+private:
+  struct RawTag
+  {
+  };
+
+  constexpr Fixed(Storage raw, RawTag) : _raw(raw) {}
+
+  static constexpr int64_t divideRounded(int64_t numerator, int64_t denominator)
+  {
+    return ((numerator < 0) == (denominator < 0) ? numerator + denominator / 2 : numerator - denominator / 2) /
+           denominator;
+  }
+
+  /** 生の値 */
+  Storage _raw;
+};
+
+/** fix.hpp の fix と同じ Q16.16 */
+typedef Fixed<16, 16, int32_t> FixQ16;
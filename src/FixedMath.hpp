@@ -0,0 +1,347 @@
+/**
+ * @file FixedMath.hpp
+ * @brief Q16.16 固定小数点数の初等関数
+ * @author Tatsuya Miyazaki
+ *
+ * @details FixQ16 (fix.hpp の fix と同じ Q16.16) に対する exp / log / sqrt /
+ * sin / cos / atan2 を整数演算だけで計算する。FPU のないマイコンでもフィルタの
+ * 時定数の再計算や角度計算を浮動小数点演算なしで行える。
+ *
+ *   - exp / log : ln(1 + 2^-i) の表を使ったシフト加算法
+ *   - sin / cos / atan2 : atan(2^-i) の表を使った CORDIC
+ *   - sqrt : 1 ビットずつ求める開平法
+ *
+ * 内部は Q2.30 で計算し、最後に Q16.16 へ丸める。各関数の最大誤差は
+ * extras/FixedMathBenchmark で double の結果と比較して確認している。
+ * 表は 2 つ合わせて 176 バイト。
+ *
+ * 使い方:
+ *   FixQ16 angle = FixedMath::atan2(FixQ16::fromInt(1), FixQ16::fromInt(1));  // π/4
+ *   FixQ16 s, c;
+ *   FixedMath::sincos(angle, s, c);
+ *   fix gain = FixedMath::exp(FixQ16::fromFix(x)).toFix();
+ */
+
+#pragma once
+
+#include "Fixed.hpp"
+
+namespace FixedMath
+{
+
+namespace Detail
+{
+
+/** Q2.30 の 1.0 */
+constexpr int64_t kOne30 = static_cast<int64_t>(1) << 30;
+/** ln(2) [Q2.30] */
+constexpr int64_t kLn2 = 744261118;
+/** π [Q2.30] */
+constexpr int64_t kPi = 3373259426LL;
+/** CORDIC の利得の逆数 [Q2.30] */
+constexpr int64_t kCordicGain = 652032874;
+/** 1 ラジアンあたりの回転数 × 2^32 [Q16.16] */
+constexpr int64_t kTurnsPerRadian = 683565276;
+/** 結果が FixQ16 の最大値を超えない exp の最大入力 [Q16.16] */
+constexpr int32_t kExpMaxRaw = 681391;
+/** 結果が 0 に丸められない exp の最小入力 [Q16.16] */
+constexpr int32_t kExpMinRaw = -772243;
+/** 表の要素数 */
+constexpr int kIterations = 22;
+
+/**
+ * @brief 計算に使う定数表
+ *
+ * ヘッダだけで定義するため、テンプレートの静的メンバとして置く。
+ */
+template <typename Dummy = void>
+struct Tables
+{
+  /** ln(1 + 2^-i) [Q2.30], i = 1..22 */
+  static constexpr int32_t log[kIterations] = {
+    435364845, 239598564, 126468572, 65095192, 33040817, 16647494, 8356010, 4186133, 2095107, 1048064, 524160,
+    262112,    131064,    65534,    32768,    16384,    8192,    4096,    2048,    1024,    512,     256};
+  /** atan(2^-i) [Q2.30], i = 0..21 */
+  static constexpr int32_t atan[kIterations] = {
+    843314857, 497837829, 263043837, 133525159, 67021687, 33543516, 16775851, 8388437, 4194283, 2097149, 1048576,
+    524288,    262144,    131072,    65536,    32768,    16384,    8192,    4096,    2048,    1024,    512};
+};
+
+template <typename Dummy>
+constexpr int32_t Tables<Dummy>::log[kIterations];
+template <typename Dummy>
+constexpr int32_t Tables<Dummy>::atan[kIterations];
+
+/**
+ * @brief Q2.30 の値を四捨五入して FixQ16 にする（範囲外は飽和）
+ */
+inline FixQ16 fromQ30(int64_t value)
+{
+  return FixQ16::fromRaw(FixedUtil::saturate<int32_t>(FixedUtil::roundShiftRight(value, 14)));
+}
+
+/**
+ * @brief CORDIC の回転モード。角度 z [-π/2, π/2] の cos / sin を Q2.30 で求める
+ */
+inline void cordicRotate(int64_t z, int64_t& x, int64_t& y)
+{
+  x = kCordicGain;
+  y = 0;
+  for (int i = 0; i < kIterations; i++)
+  {
+    const int64_t dx = y >> i;
+    const int64_t dy = x >> i;
+    if (z >= 0)
+    {
+      x -= dx;
+      y += dy;
+      z -= Tables<>::atan[i];
+    }
+    else
+    {
+      x += dx;
+      y -= dy;
+      z += Tables<>::atan[i];
+    }
+  }
+}
+
+}  // namespace Detail
+
+/**
+ * @brief 平方根
+ *
+ * 最大誤差 0.5 LSB (7.6e-6)。負の値は 0 を返す。
+ *
+ * @param x 入力値
+ * @return FixQ16 √x
+ */
+inline FixQ16 sqrt(FixQ16 x)
+{
+  if (x.raw() <= 0)
+  {
+    return FixQ16();
+  }
+
+  // Q16.16 の平方根は (raw << 16) の整数平方根になる
+  uint64_t value = static_cast<uint64_t>(x.raw()) << 16;
+  uint64_t result = 0;
+  uint64_t bit = static_cast<uint64_t>(1) << 46;
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (value >= result + bit)
+    {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    }
+    else
+    {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  if (value > result)
+  {
+    result++;
+  }
+  return FixQ16::fromRaw(static_cast<int32_t>(result));
+}
+
+/**
+ * @brief 指数関数
+ *
+ * 最大誤差は 1 LSB または相対誤差 2^-26 の大きい方。
+ * 結果が最大値を超える場合は飽和する。
+ *
+ * @param x 入力値
+ * @return FixQ16 e^x
+ */
+inline FixQ16 exp(FixQ16 x)
+{
+  if (x.raw() > Detail::kExpMaxRaw)
+  {
+    return FixQ16::fromRaw(FixedUtil::overflowed(FixedUtil::Traits<int32_t>::kMax));
+  }
+  if (x.raw() < Detail::kExpMinRaw)
+  {
+    return FixQ16();
+  }
+
+  // e^x = 2^k * e^r (0 <= r < ln2)
+  int64_t r = static_cast<int64_t>(x.raw()) << 14;
+  int32_t k = static_cast<int32_t>(r >= 0 ? r / Detail::kLn2 : -((-r + Detail::kLn2 - 1) / Detail::kLn2));
+  r -= k * Detail::kLn2;
+
+  int64_t y = Detail::kOne30;
+  for (int i = 0; i < Detail::kIterations; i++)
+  {
+    if (r >= Detail::Tables<>::log[i])
+    {
+      r -= Detail::Tables<>::log[i];
+      y += y >> (i + 1);
+    }
+  }
+  y += (y * r) >> 30;
+
+  const int shift = 14 - k;
+  const int64_t raw = shift > 0 ? FixedUtil::roundShiftRight(y, shift) : y << -shift;
+  return FixQ16::fromRaw(FixedUtil::saturate<int32_t>(raw));
+}
+
+/**
+ * @brief 自然対数
+ *
+ * 最大誤差 1 LSB (1.5e-5)。0 以下の値は最小値を返す。
+ *
+ * @param x 入力値
+ * @return FixQ16 ln(x)
+ */
+inline FixQ16 log(FixQ16 x)
+{
+  if (x.raw() <= 0)
+  {
+    return FixQ16::fromRaw(FixedUtil::overflowed(FixedUtil::Traits<int32_t>::kMin));
+  }
+
+  // x = m * 2^e (1 <= m < 2)
+  int64_t m = x.raw();
+  int32_t e = 14;
+  while (m < Detail::kOne30)
+  {
+    m <<= 1;
+    e--;
+  }
+
+  // m に (1 + 2^-i) を掛けて 2 に近づけ、掛けた分の対数を引く
+  const int64_t two = Detail::kOne30 * 2;
+  int64_t y = Detail::kLn2;
+  for (int i = 0; i < Detail::kIterations; i++)
+  {
+    const int64_t next = m + (m >> (i + 1));
+    if (next <= two)
+    {
+      m = next;
+      y -= Detail::Tables<>::log[i];
+    }
+  }
+  y -= (two - m) >> 1;
+
+  return Detail::fromQ30(y + e * Detail::kLn2);
+}
+
+/**
+ * @brief 正弦と余弦を同時に求める
+ *
+ * |angle| <= 2π での最大誤差 1 LSB (1.5e-5)。角度が大きいほど、
+ * ラジアンから回転数への変換誤差が加わる。
+ *
+ * @param angle 角度 [rad]
+ * @param sinOut sin(angle) の格納先
+ * @param cosOut cos(angle) の格納先
+ */
+inline void sincos(FixQ16 angle, FixQ16& sinOut, FixQ16& cosOut)
+{
+  // 1 回転を 2^32 とした位相に変換し、[-π, π) に畳み込む
+  const uint32_t phase = static_cast<uint32_t>((static_cast<int64_t>(angle.raw()) * Detail::kTurnsPerRadian) >> 16);
+  int64_t turn = static_cast<int32_t>(phase);
+  const int64_t quarter = static_cast<int64_t>(1) << 30;
+  const int64_t half = static_cast<int64_t>(1) << 31;
+  bool negateCos = false;
+  if (turn > quarter)
+  {
+    turn = half - turn;
+    negateCos = true;
+  }
+  else if (turn < -quarter)
+  {
+    turn = -half - turn;
+    negateCos = true;
+  }
+
+  int64_t x = 0;
+  int64_t y = 0;
+  Detail::cordicRotate((turn * Detail::kPi) >> 31, x, y);
+  sinOut = Detail::fromQ30(y);
+  cosOut = Detail::fromQ30(negateCos ? -x : x);
+}
+
+/**
+ * @brief 正弦
+ *
+ * @param angle 角度 [rad]
+ * @return FixQ16 sin(angle)
+ */
+inline FixQ16 sin(FixQ16 angle)
+{
+  FixQ16 s;
+  FixQ16 c;
+  sincos(angle, s, c);
+  return s;
+}
+
+/**
+ * @brief 余弦
+ *
+ * @param angle 角度 [rad]
+ * @return FixQ16 cos(angle)
+ */
+inline FixQ16 cos(FixQ16 angle)
+{
+  FixQ16 s;
+  FixQ16 c;
+  sincos(angle, s, c);
+  return c;
+}
+
+/**
+ * @brief 逆正接 (y / x の偏角)
+ *
+ * 最大誤差 1 LSB (1.5e-5)。結果は [-π, π]、atan2(0, 0) は 0 を返す。
+ *
+ * @param y y 座標
+ * @param x x 座標
+ * @return FixQ16 偏角 [rad]
+ */
+inline FixQ16 atan2(FixQ16 y, FixQ16 x)
+{
+  if (x.raw() == 0 && y.raw() == 0)
+  {
+    return FixQ16();
+  }
+
+  // 精度を保つため Q32 に広げ、左半平面は π 回転して右半平面に移す
+  int64_t vx = static_cast<int64_t>(x.raw()) << 16;
+  int64_t vy = static_cast<int64_t>(y.raw()) << 16;
+  int64_t z = 0;
+  if (vx < 0)
+  {
+    z = vy >= 0 ? Detail::kPi : -Detail::kPi;
+    vx = -vx;
+    vy = -vy;
+  }
+
+  for (int i = 0; i < Detail::kIterations; i++)
+  {
+    const int64_t dx = vy >> i;
+    const int64_t dy = vx >> i;
+    if (vy > 0)
+    {
+      vx += dx;
+      vy -= dy;
+      z += Detail::Tables<>::atan[i];
+    }
+    else
+    {
+      vx -= dx;
+      vy += dy;
+      z -= Detail::Tables<>::atan[i];
+    }
+  }
+  return Detail::fromQ30(z);
+}
+
+}  // namespace FixedMath
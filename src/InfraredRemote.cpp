@@ -2,6 +2,7 @@
 
 #ifndef UNIT_TEST
 
+#include <Clock.h>
 #include <Log.h>
 
 #define DECODE_RC6
@@ -101,7 +102,7 @@ bool InfraredRemote::recieveIR(void) {
 }
 
 void InfraredRemote::printDebug(void) {
-  Serial.println(String(millis()) + ", " + String(receivedData_.protocol) +
+  Serial.println(String(Clock::nowMillis()) + ", " + String(receivedData_.protocol) +
                  ", 0b " + String(receivedData_.rawData, BIN));
 }
 
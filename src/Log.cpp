@@ -9,17 +9,906 @@
 /***********************************************************************/
 
 #include <Arduino.h>
+#include <stdarg.h>
+#include <string.h>
+#if defined(__AVR__)
+#include <util/atomic.h>
+#endif
 
 #include "Log.h"
 
+/***********************************************************************/
+/*                       ログ用リングバッファ                          */
+/***********************************************************************/
+
+namespace
+{
+
+// 1 行の長さを記録するバイト数
+const uint32_t kLengthBytes = 2;
+// 長さの最上位ビット: 改行を付けずにそのまま送る記録 (バイナリログ)
+const uint16_t kRawFlag = 0x8000;
+// 長さのビット 12〜14: ログレベル
+const uint8_t kLevelShift = 12;
+const uint16_t kLevelMask = 0x7000;
+// 1 行の長さの最大値
+const size_t kMaxRecordLength = 0x0FFF;
+
+#if defined(__AVR__)
+uint32_t loadAcquire(const uint32_t& value)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    return value;
+  }
+  return 0;
+}
+
+void storeRelease(uint32_t& target, uint32_t value)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    target = value;
+  }
+}
+
+bool compareExchange(uint32_t& target, uint32_t expected, uint32_t desired)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (target != expected)
+    {
+      return false;
+    }
+    target = desired;
+  }
+  return true;
+}
+
+uint8_t loadByte(const uint8_t& value)
+{
+  return value;
+}
+
+void storeByte(uint8_t& target, uint8_t value)
+{
+  target = value;
+}
+
+bool loadFlag(const bool& value)
+{
+  return value;
+}
+
+void storeFlag(bool& target, bool value)
+{
+  target = value;
+}
+#else
+uint32_t loadAcquire(const uint32_t& value)
+{
+  return __atomic_load_n(&value, __ATOMIC_ACQUIRE);
+}
+
+void storeRelease(uint32_t& target, uint32_t value)
+{
+  __atomic_store_n(&target, value, __ATOMIC_RELEASE);
+}
+
+bool compareExchange(uint32_t& target, uint32_t expected, uint32_t desired)
+{
+  return __atomic_compare_exchange_n(&target, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// DROP_OLDEST では書き込み側が読み出し中の行を上書きすることがある (読み出し側は
+// compare-and-swap の失敗で気づいて捨てる) ので、バイト単位の読み書きも atomic にする
+uint8_t loadByte(const uint8_t& value)
+{
+  return __atomic_load_n(&value, __ATOMIC_RELAXED);
+}
+
+void storeByte(uint8_t& target, uint8_t value)
+{
+  __atomic_store_n(&target, value, __ATOMIC_RELAXED);
+}
+
+// 取り出し中の行があるか (Log::flush() が drain() のタスクとは別のタスクから読む)
+bool loadFlag(const bool& value)
+{
+  return __atomic_load_n(&value, __ATOMIC_ACQUIRE);
+}
+
+void storeFlag(bool& target, bool value)
+{
+  __atomic_store_n(&target, value, __ATOMIC_RELEASE);
+}
+#endif
+
+}  // namespace
+
+#if defined(ESP32)
+#define LOG_RING_LOCK() portENTER_CRITICAL(&m_lock)
+#define LOG_RING_UNLOCK() portEXIT_CRITICAL(&m_lock)
+#define LOG_BATCH_LOCK() xSemaphoreTakeRecursive(m_mutex, portMAX_DELAY)
+#define LOG_BATCH_UNLOCK() xSemaphoreGiveRecursive(m_mutex)
+#else
+#define LOG_RING_LOCK()
+#define LOG_RING_UNLOCK()
+#define LOG_BATCH_LOCK()
+#define LOG_BATCH_UNLOCK()
+#endif
+
+LogRingBuffer::LogRingBuffer(uint8_t* storage, size_t capacity, char* line, size_t lineSize,
+                             overflowPolicyEnum policy)
+  : m_storage(storage),
+    m_mask((uint32_t)capacity - 1),
+    m_head(0),
+    m_tail(0),
+    m_policy(policy),
+    m_dropped(0),
+    m_highWatermark(0),
+    m_line(line),
+    m_lineSize(lineSize),
+    m_lineLength(0),
+    m_lineLevel(0),
+    m_lineRaw(false),
+    m_hasLine(false)
+{
+#if defined(ESP32)
+  portMUX_INITIALIZE(&m_lock);
+#endif
+}
+
+/**
+ * @brief 1 行を記録する
+ *
+ * head と body をつなげて 1 行とする (改行は含めない。4095 byte まで)。
+ * 空きが足りないときは、DROP_NEWEST ならこの行を捨て、DROP_OLDEST なら
+ * 入るまで古い行から捨てる。捨てた行は getDroppedCount() に数える。
+ *
+ * @param level ログレベル (Log::logLevelEnum の値)
+ * @param head 行の前半
+ * @param headLength 前半の長さ
+ * @param body 行の後半 (なければ nullptr)
+ * @param bodyLength 後半の長さ
+ * @return true 記録した
+ * @return false 空きが足りず捨てた
+ */
+bool LogRingBuffer::push(uint8_t level, const char* head, size_t headLength, const char* body, size_t bodyLength)
+{
+  return pushRecord((const uint8_t*)head, headLength, (const uint8_t*)body, bodyLength,
+                    (uint16_t)((level << kLevelShift) & kLevelMask));
+}
+
+/**
+ * @brief バイト列を 1 つの記録として書き込む
+ *
+ * 出力するときに改行を付けず、そのまま送る (バイナリログ用)。
+ * 空きが足りないときの動作は push() と同じ。
+ *
+ * @param level ログレベル (Log::logLevelEnum の値)
+ * @param data 記録するバイト列
+ * @param length 長さ
+ * @return true 記録した
+ * @return false 空きが足りず捨てた
+ */
+bool LogRingBuffer::pushRaw(uint8_t level, const uint8_t* data, size_t length)
+{
+  return pushRecord(data, length, nullptr, 0, (uint16_t)(kRawFlag | ((level << kLevelShift) & kLevelMask)));
+}
+
+/* head と body をつなげて flags 付きで記録する */
+bool LogRingBuffer::pushRecord(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength,
+                               uint16_t flags)
+{
+  const size_t length = headLength + bodyLength;
+  const uint32_t need = kLengthBytes + (uint32_t)length;
+  bool stored = false;
+
+  LOG_RING_LOCK();
+  if (length <= kMaxRecordLength && need <= getCapacity())
+  {
+    for (;;)
+    {
+      const uint32_t tail = loadAcquire(m_tail);
+      if (getCapacity() - (m_head - tail) >= need)
+      {
+        stored = true;
+        break;
+      }
+      if (m_policy == DROP_NEWEST)
+      {
+        break;
+      }
+      // 取り出し側と同時に進めようとしても、どちらか一方だけが成功する
+      if (compareExchange(m_tail, tail, tail + kLengthBytes + (uint32_t)(readHeader(tail) & kMaxRecordLength)))
+      {
+        storeRelease(m_dropped, m_dropped + 1);
+      }
+    }
+  }
+
+  if (stored)
+  {
+    const uint16_t value = (uint16_t)(length | flags);
+    const uint8_t header[kLengthBytes] = {(uint8_t)(value >> 8), (uint8_t)value};
+    copyIn(m_head, header, kLengthBytes);
+    copyIn(m_head + kLengthBytes, head, headLength);
+    copyIn(m_head + kLengthBytes + headLength, body, bodyLength);
+    storeRelease(m_head, m_head + need);
+    const size_t used = m_head - loadAcquire(m_tail);
+    if (used > m_highWatermark)
+    {
+      m_highWatermark = used;
+    }
+  }
+  else
+  {
+    storeRelease(m_dropped, m_dropped + 1);
+  }
+  LOG_RING_UNLOCK();
+  return stored;
+}
+
+/**
+ * @brief 最も古い行を取り出す
+ *
+ * 取り出した行は getLine() などで参照でき、finishLine() を呼ぶまで変わらない。
+ * 取り出し側 (Log::drain()) だけが呼ぶ。
+ *
+ * @return true 取り出した (取り出し中の行があるときはその行のまま)
+ * @return false 行がない
+ */
+bool LogRingBuffer::nextLine(void)
+{
+  if (m_hasLine)
+  {
+    return true;
+  }
+  for (;;)
+  {
+    const uint32_t tail = loadAcquire(m_tail);
+    if (tail == loadAcquire(m_head))
+    {
+      return false;
+    }
+    const uint16_t header = readHeader(tail);
+    const size_t length = header & kMaxRecordLength;
+    const size_t copied = length < m_lineSize ? length : m_lineSize;
+    copyOut(tail + kLengthBytes, m_line, copied);
+    // 読んでいる間に DROP_OLDEST で捨てられていたら失敗するので、読み直す
+    if (compareExchange(m_tail, tail, tail + kLengthBytes + (uint32_t)length))
+    {
+      m_lineLength = copied;
+      m_lineLevel = (uint8_t)((header & kLevelMask) >> kLevelShift);
+      m_lineRaw = (header & kRawFlag) != 0;
+      storeFlag(m_hasLine, true);
+      return true;
+    }
+  }
+}
+
+/**
+ * @brief 取り出し中の行の出力が終わったことを知らせる
+ *
+ */
+void LogRingBuffer::finishLine(void)
+{
+  storeFlag(m_hasLine, false);
+}
+
+/**
+ * @brief 出力待ちの行がないかを返す
+ *
+ * @return true 書き込みが終わっている
+ * @return false 出力待ちの行がある
+ */
+bool LogRingBuffer::isEmpty(void) const
+{
+  return getUsed() == 0 && !loadFlag(m_hasLine);
+}
+
+/**
+ * @brief 使用中のバイト数を返す
+ *
+ * @return size_t 使用中のバイト数 (長さの分を含む)
+ */
+size_t LogRingBuffer::getUsed(void) const
+{
+  return loadAcquire(m_head) - loadAcquire(m_tail);
+}
+
+/**
+ * @brief 捨てた行の数を返す
+ *
+ * @return uint32_t 空きが足りずに捨てた行の数
+ */
+uint32_t LogRingBuffer::getDroppedCount(void) const
+{
+  return loadAcquire(m_dropped);
+}
+
+/**
+ * @brief 捨てた行の数と最大使用量をクリアする
+ *
+ */
+void LogRingBuffer::clearStatistics(void)
+{
+  LOG_RING_LOCK();
+  storeRelease(m_dropped, 0);
+  m_highWatermark = m_head - loadAcquire(m_tail);
+  LOG_RING_UNLOCK();
+}
+
+/* position に記録された長さとフラグを読む */
+uint16_t LogRingBuffer::readHeader(uint32_t position) const
+{
+  return (uint16_t)((loadByte(m_storage[position & m_mask]) << 8) | loadByte(m_storage[(position + 1) & m_mask]));
+}
+
+/* position から length バイトを buffer に読む */
+void LogRingBuffer::copyOut(uint32_t position, char* buffer, size_t length) const
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    buffer[i] = (char)loadByte(m_storage[(position + i) & m_mask]);
+  }
+}
+
+/* position から length バイトを書き込む */
+void LogRingBuffer::copyIn(uint32_t position, const uint8_t* data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    storeByte(m_storage[(position + i) & m_mask], data[i]);
+  }
+}
+
+/***********************************************************************/
+/*                        バイナリログの符号化                         */
+/***********************************************************************/
+
+/**
+ * @brief 整数を zigzag 符号化した varint で書き込む
+ *
+ * @param value 値
+ */
+void LogArgWriter::putInteger(int64_t value)
+{
+  putVarint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/**
+ * @brief 浮動小数点数を float (little endian) で書き込む
+ *
+ * @param value 値
+ */
+void LogArgWriter::putFloat(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint8_t bytes[] = {(uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24)};
+  putBytes(bytes, sizeof(bytes));
+}
+
+/**
+ * @brief 文字列を varint の長さと本体で書き込む
+ *
+ * 残りの領域に収まらない分は切り詰める。
+ *
+ * @param value 文字列 (nullptr は "(null)")
+ */
+void LogArgWriter::putString(const char* value)
+{
+  if (value == nullptr)
+  {
+    value = "(null)";
+  }
+  const size_t room = m_size - m_length;
+  size_t length = strlen(value);
+  if (length > room)
+  {
+    length = room;
+  }
+  // 長さの varint の分を空ける
+  for (;;)
+  {
+    size_t lengthBytes = 1;
+    for (size_t rest = length >> 7; rest > 0; rest >>= 7)
+    {
+      lengthBytes++;
+    }
+    if (length + lengthBytes <= room || length == 0)
+    {
+      break;
+    }
+    length--;
+  }
+  putVarint(length);
+  putBytes((const uint8_t*)value, length);
+}
+
+/**
+ * @brief 符号なし整数を varint (7 ビットずつ、下位から) で書き込む
+ *
+ * @param value 値
+ */
+void LogArgWriter::putVarint(uint64_t value)
+{
+  do
+  {
+    uint8_t byte = (uint8_t)(value & 0x7F);
+    value >>= 7;
+    if (value != 0)
+    {
+      byte |= 0x80;
+    }
+    putBytes(&byte, 1);
+  } while (value != 0);
+}
+
+/**
+ * @brief バイト列をそのまま書き込む
+ *
+ * 残りの領域に収まらなければ何も書かず、isOverflow() を true にする。
+ *
+ * @param data バイト列
+ * @param length 長さ
+ */
+void LogArgWriter::putBytes(const uint8_t* data, size_t length)
+{
+  if (m_overflow || length > m_size - m_length)
+  {
+    m_overflow = true;
+    return;
+  }
+  memcpy(m_data + m_length, data, length);
+  m_length += length;
+}
+
+/***********************************************************************/
+/*                            ログの出力先                             */
+/***********************************************************************/
+
+/**
+ * @brief 行の offset バイト目から length バイトを buffer にコピーする
+ *
+ * @param buffer コピー先
+ * @param offset 行の先頭からの位置
+ * @param length 長さ (offset + length は length() 以下)
+ */
+void LogRecord::copyTo(uint8_t* buffer, size_t offset, size_t length) const
+{
+  if (offset < headLength)
+  {
+    const size_t chunk = (length < headLength - offset) ? length : headLength - offset;
+    memcpy(buffer, head + offset, chunk);
+    buffer += chunk;
+    length -= chunk;
+    offset = headLength;
+  }
+  if (length > 0)
+  {
+    memcpy(buffer, body + (offset - headLength), length);
+  }
+}
+
+/**
+ * @brief 1 行を書き、テキストなら CRLF を付ける
+ *
+ * 非同期モードでは availableForWrite() の分だけ書き、書ききれなければ
+ * 書いた位置を覚えて false を返す。
+ *
+ * @param record 出力する行
+ * @return true 書き終えた
+ * @return false 送信バッファがいっぱいで書ききれなかった
+ */
+bool SerialLogSink::write(const LogRecord& record)
+{
+  static const uint8_t kNewLine[] = {'\r', '\n'};
+  if (record.blocking)
+  {
+    m_output->write(record.head, record.headLength);
+    if (record.bodyLength > 0)
+    {
+      m_output->write(record.body, record.bodyLength);
+    }
+    if (!record.binary)
+    {
+      m_output->write(kNewLine, sizeof(kNewLine));
+    }
+    return true;
+  }
+
+  const size_t length = record.length();
+  const size_t total = length + (record.binary ? 0 : sizeof(kNewLine));
+  while (m_offset < total)
+  {
+    const int space = m_output->availableForWrite();
+    if (space <= 0)
+    {
+      return false;
+    }
+    const uint8_t* data;
+    size_t chunk;
+    if (m_offset < record.headLength)
+    {
+      data = record.head + m_offset;
+      chunk = record.headLength - m_offset;
+    }
+    else if (m_offset < length)
+    {
+      data = record.body + (m_offset - record.headLength);
+      chunk = length - m_offset;
+    }
+    else
+    {
+      data = kNewLine + (m_offset - length);
+      chunk = total - m_offset;
+    }
+    if (chunk > (size_t)space)
+    {
+      chunk = (size_t)space;
+    }
+    chunk = m_output->write(data, chunk);
+    if (chunk == 0)
+    {
+      return false;
+    }
+    m_offset += chunk;
+  }
+  m_offset = 0;
+  return true;
+}
+
+namespace
+{
+
+// RetainedLogSink の領域が初期化済みであることを示す値
+const uint32_t kRetainedMagic = 0x4C4F4731;  // "LOG1"
+
+uint32_t retainedCheck(uint32_t magic, uint32_t capacity)
+{
+  return magic ^ capacity ^ 0x5A5A5A5AUL;
+}
+
+} // namespace
+
+/**
+ * @brief 領域を出力先にする
+ *
+ * 領域の先頭に前回のログが残っていればそのまま続きに書き、なければ初期化する。
+ *
+ * @param area 領域 (4 byte 境界に置くこと)
+ * @param size 領域の大きさ [byte] (管理用に 16 byte を使う)
+ * @param level 出力するログレベル
+ */
+RetainedLogSink::RetainedLogSink(void* area, size_t size, uint8_t level)
+  : LogSink(level),
+    m_header(static_cast<Header*>(area)),
+    m_data(static_cast<uint8_t*>(area) + sizeof(Header)),
+    m_capacity(size > sizeof(Header) ? (uint32_t)(size - sizeof(Header)) : 0),
+    m_retained(false)
+{
+#if defined(ESP32)
+  portMUX_INITIALIZE(&m_lock);
+#endif
+  if (m_capacity == 0)
+  {
+    m_header = nullptr;
+    return;
+  }
+  const bool valid = m_header->magic == kRetainedMagic && m_header->capacity == m_capacity &&
+                     m_header->check == retainedCheck(m_header->magic, m_header->capacity);
+  if (valid)
+  {
+    m_retained = m_header->head > 0;
+  }
+  else
+  {
+    clear();
+  }
+}
+
+/**
+ * @brief 1 行を領域に書く (テキストは '\n' で区切る)
+ *
+ * 領域がいっぱいのときは古いログに上書きする。非同期モードでもログを出した
+ * タスクから呼ばれるので、ESP32 では短いクリティカルセクションで排他する。
+ *
+ * @param record 出力する行
+ * @return true 常に true
+ */
+bool RetainedLogSink::write(const LogRecord& record)
+{
+  if (m_header == nullptr)
+  {
+    return true;
+  }
+  LOG_RING_LOCK();
+  append(record.head, record.headLength);
+  append(record.body, record.bodyLength);
+  if (!record.binary)
+  {
+    const uint8_t newLine = '\n';
+    append(&newLine, 1);
+  }
+  LOG_RING_UNLOCK();
+  return true;
+}
+
+/**
+ * @brief 残っているログの長さを返す
+ *
+ * @return size_t 長さ [byte]
+ */
+size_t RetainedLogSink::getLength(void) const
+{
+  if (m_header == nullptr)
+  {
+    return 0;
+  }
+  return m_header->head < m_capacity ? m_header->head : m_capacity;
+}
+
+/**
+ * @brief 残っているログを古い順にコピーする
+ *
+ * 領域を一周した後は、先頭の行が途中から始まることがある。
+ *
+ * @param buffer コピー先
+ * @param size コピー先の大きさ
+ * @return size_t コピーしたバイト数
+ */
+size_t RetainedLogSink::read(uint8_t* buffer, size_t size) const
+{
+  const size_t length = getLength();
+  const size_t copied = size < length ? size : length;
+  const uint32_t start = (m_header != nullptr) ? (m_header->head - (uint32_t)length) % m_capacity : 0;
+  for (size_t i = 0; i < copied;)
+  {
+    const uint32_t position = (start + (uint32_t)i) % m_capacity;
+    size_t chunk = m_capacity - position;
+    if (chunk > copied - i)
+    {
+      chunk = copied - i;
+    }
+    memcpy(buffer + i, m_data + position, chunk);
+    i += chunk;
+  }
+  return copied;
+}
+
+/**
+ * @brief 残っているログを古い順に書き出す
+ *
+ * @param output 出力先 (Serial など)
+ */
+void RetainedLogSink::dump(Print& output) const
+{
+  const size_t length = getLength();
+  if (length == 0)
+  {
+    return;
+  }
+  const uint32_t start = (m_header->head - (uint32_t)length) % m_capacity;
+  const size_t first = (m_capacity - start < length) ? m_capacity - start : length;
+  output.write(m_data + start, first);
+  if (first < length)
+  {
+    output.write(m_data, length - first);
+  }
+}
+
+/**
+ * @brief 残っているログを消す
+ *
+ */
+void RetainedLogSink::clear(void)
+{
+  if (m_header == nullptr)
+  {
+    return;
+  }
+  m_header->magic = kRetainedMagic;
+  m_header->head = 0;
+  m_header->capacity = m_capacity;
+  seal();
+  m_retained = false;
+}
+
+/* 領域の続きに書く (一周したら先頭に戻る) */
+void RetainedLogSink::append(const uint8_t* data, size_t length)
+{
+  if (length > m_capacity)
+  {
+    data += length - m_capacity;
+    m_header->head += (uint32_t)(length - m_capacity);
+    length = m_capacity;
+  }
+  while (length > 0)
+  {
+    const uint32_t position = m_header->head % m_capacity;
+    size_t chunk = m_capacity - position;
+    if (chunk > length)
+    {
+      chunk = length;
+    }
+    memcpy(m_data + position, data, chunk);
+    m_header->head += (uint32_t)chunk;
+    data += chunk;
+    length -= chunk;
+  }
+}
+
+/* 管理情報の検査値を更新する */
+void RetainedLogSink::seal(void)
+{
+  m_header->check = retainedCheck(m_header->magic, m_header->capacity);
+}
+
+/**
+ * @brief 送る間隔を指定する
+ *
+ * @param intervalMs 最初の行を溜めてから送るまでの時間 [ms]
+ * @param level 出力するログレベル
+ */
+BatchLogSink::BatchLogSink(uint32_t intervalMs, uint8_t level)
+  : LogSink(level),
+    m_length(0),
+    m_lines(0),
+    m_interval(intervalMs),
+    m_firstTime(0),
+    m_sent(0),
+    m_dropped(0),
+    m_sending(false)
+{
+#if defined(ESP32)
+  m_mutex = xSemaphoreCreateRecursiveMutex();
+#endif
+}
+
+BatchLogSink::~BatchLogSink()
+{
+#if defined(ESP32)
+  vSemaphoreDelete(m_mutex);
+#endif
+}
+
+/**
+ * @brief 1 行を溜める
+ *
+ * 溜めた行と合わせて LOG_BATCH_SIZE を超えるときは、先に溜めた行を送る。
+ * 1 行で LOG_BATCH_SIZE を超える分は切り詰める。
+ *
+ * @param record 出力する行
+ * @return true 常に true (送れなかった行は getDroppedCount() に数える)
+ */
+bool BatchLogSink::write(const LogRecord& record)
+{
+  LOG_BATCH_LOCK();
+  if (m_sending)
+  {
+    m_dropped++;
+    LOG_BATCH_UNLOCK();
+    return true;
+  }
+  uint8_t prefix[48];
+  const size_t prefixLength = formatPrefix(record, prefix, sizeof(prefix));
+  const size_t newLine = record.binary ? 0 : 1;
+  if (m_length + prefixLength + record.length() + newLine > sizeof(m_batch))
+  {
+    flush();
+  }
+
+  size_t length = record.length();
+  if (prefixLength + length + newLine > sizeof(m_batch))
+  {
+    length = sizeof(m_batch) - prefixLength - newLine;
+  }
+  memcpy(m_batch + m_length, prefix, prefixLength);
+  record.copyTo(m_batch + m_length + prefixLength, 0, length);
+  m_length += prefixLength + length;
+  if (newLine > 0)
+  {
+    m_batch[m_length++] = '\n';
+  }
+  if (m_lines++ == 0)
+  {
+    m_firstTime = Timer::getGlobalTime();
+  }
+  LOG_BATCH_UNLOCK();
+  return true;
+}
+
+/**
+ * @brief 最初の行から intervalMs が過ぎていれば送る
+ *
+ */
+void BatchLogSink::poll(void)
+{
+  LOG_BATCH_LOCK();
+  if (m_lines > 0 && Timer::getGlobalTime() - m_firstTime >= m_interval)
+  {
+    flush();
+  }
+  LOG_BATCH_UNLOCK();
+}
+
+/**
+ * @brief 溜めている行を送る
+ *
+ */
+void BatchLogSink::flush(void)
+{
+  LOG_BATCH_LOCK();
+  if (m_lines == 0 || m_sending)
+  {
+    LOG_BATCH_UNLOCK();
+    return;
+  }
+  m_sending = true;
+  if (send(m_batch, m_length))
+  {
+    m_sent += m_lines;
+  }
+  else
+  {
+    m_dropped += m_lines;
+  }
+  m_sending = false;
+  m_length = 0;
+  m_lines = 0;
+  LOG_BATCH_UNLOCK();
+}
+
+/* 行の前に付ける文字列 (既定は何も付けない) */
+size_t BatchLogSink::formatPrefix(const LogRecord& record, uint8_t* buffer, size_t size)
+{
+  (void)record;
+  (void)buffer;
+  (void)size;
+  return 0;
+}
+
 /***********************************************************************/
 /*                           ログ出力クラス                            */
 /***********************************************************************/
 
+namespace
+{
+
+// 出力先の番号 index のビットを取り除き、上のビットを詰める (removeSink() で使う)
+uint8_t removeBit(uint8_t mask, uint8_t index)
+{
+  const uint8_t lower = (uint8_t)(mask & ((1U << index) - 1));
+  return (uint8_t)(lower | ((mask >> (index + 1)) << index));
+}
+
+}  // namespace
+
 Log::Log()
+  : m_serialSink(output()),
+    m_sinkCount(0),
+    m_lineStarted(false),
+    m_pendingSinks(0),
+    m_stalledSinks(0),
+    m_lineTime(0),
+    m_buffer(nullptr),
+    m_reportedDrops(0),
+    m_binary(false),
+    m_binaryRecords(0),
+    m_binaryTime(0)
+#if defined(ESP32)
+    ,
+    m_drainTask(nullptr),
+    m_drainInterval(0),
+    m_drainRunning(false)
+#endif
 {
   serialBegin(LOG_SERIAL_BAUDRATE);
   m_level = LOG_LEVEL_INIT;
+  m_sinks[m_sinkCount++] = &m_serialSink;
 }
 
 Log::~Log()
@@ -65,56 +954,89 @@ void Log::setLevel(logLevelEnum level)
   m_level = level;
 }
 
-void Log::log(logLevelEnum type, String msg)
+/**
+ * @brief ログを出力する
+ *
+ * 「時刻[ms],レベル,メッセージ」の形式で 1 行出力する。
+ *
+ * @param type ログレベル
+ * @param msg メッセージ
+ */
+void Log::log(logLevelEnum type, const String& msg)
 {
   // ログ出力レベルのチェック
-  if (type < m_level)
+  if (!isEnabled(type))
   {
     return; // 出力レベルが不足している場合は何もしない
   }
 
-  String str = String(Timer::getGlobalTime());
-  str.concat(",");
-  if (type == DEBUG)
+  if (m_binary)
   {
-    str.concat("DEBUG,");
+    writeBinaryText(type, msg.c_str());
+    return;
   }
-  else if (type == INFO)
+
+  char prefix[24];
+  const size_t prefixLength = formatPrefix(type, prefix, sizeof(prefix));
+  emit(type, (const uint8_t*)prefix, prefixLength, (const uint8_t*)msg.c_str(), msg.length(), false);
+}
+
+/**
+ * @brief printf 形式でログを出力する
+ *
+ * レベルを先に判定し、出力するときだけスタック上のバッファ (LOG_BUFFER_SIZE) に
+ * 1 行を組み立てて出力先に 1 回で渡す (非同期モードではリングバッファに記録する)。
+ * String を使わないのでヒープを確保しない。バッファに収まらない分は切り詰める。
+ * バイナリモードでは整形した文字列を書式 "%s" の記録として出力する。
+ *
+ * @param type ログレベル
+ * @param format printf 形式の書式
+ */
+void Log::logf(logLevelEnum type, const char* format, ...)
+{
+  if (!isEnabled(type))
   {
-    str.concat("INFO,");
+    return;
   }
-  else if (type == WARN)
+
+  char buffer[LOG_BUFFER_SIZE];
+  const size_t capacity = sizeof(buffer);
+  size_t length = m_binary ? 0 : formatPrefix(type, buffer, capacity);
+
+  va_list args;
+  va_start(args, format);
+  const int written = vsnprintf(buffer + length, capacity - length, format, args);
+  va_end(args);
+  if (written > 0)
   {
-    str.concat("WARN,");
+    length += ((size_t)written < capacity - length) ? (size_t)written : capacity - length - 1;
   }
-  else if (type == ERROR)
+
+  if (m_binary)
   {
-    str.concat("ERROR,");
+    buffer[length] = '\0';
+    writeBinaryText(type, buffer);
+    return;
   }
-  str.concat(msg);
-#ifdef USE_M5ATOM_S3
-  USBSerial.println(str);
-#else
-  Serial.println(str);
-#endif
+  emit(type, (const uint8_t*)buffer, length, nullptr, 0, false);
 }
 
-void Log::info(String msg)
+void Log::info(const String& msg)
 {
   log(INFO, msg);
 }
 
-void Log::debug(String msg)
+void Log::debug(const String& msg)
 {
   log(DEBUG, msg);
 }
 
-void Log::warn(String msg)
+void Log::warn(const String& msg)
 {
   log(WARN, msg);
 }
 
-void Log::error(String msg)
+void Log::error(const String& msg)
 {
   log(ERROR, msg);
 }
@@ -130,4 +1052,505 @@ void Log::changeBaudrate(uint32_t baudrate)
   serialBegin(baudrate);
 }
 
+/**
+ * @brief バイナリモードを切り替える
+ *
+ * バイナリモードでは、ログを文字列に整形せずに次の形式で出力する。
+ * tools/decode_binary_log.py でテキストに戻せる。
+ *
+ * - 絶対時刻: 0xAF, 時刻[ms] (uint32 little endian)。最初と LOG_BINARY_SYNC_INTERVAL 記録ごとに
+ *   すべての出力先に送る
+ * - 記録: 0xA0 | レベル, 前の絶対時刻からの時間[ms] (zigzag varint), 書式文字列の ID (uint32 little endian),
+ *   引数の長さ (varint), 引数 (LogArgWriter の形式)
+ *
+ * 時間を前の絶対時刻から数えるので、出力先のレベルで記録が間引かれても時刻はずれない。
+ *
+ * LOG_xxxF() の書式文字列はコンパイル時に ID にするので、文字列を整形する処理が
+ * なくなる。log() / info() などの String と logf() は書式 "%s" (ID 0) の記録になる。
+ *
+ * @param binary true ならバイナリモード、false ならテキストモード
+ */
+void Log::setBinary(bool binary)
+{
+  m_binary = binary;
+  m_binaryRecords = 0;
+}
+
+/**
+ * @brief 非同期モードにする
+ *
+ * 以降のログはシリアルに書かずに buffer に記録する。シリアルへは drain() で送る。
+ *
+ * @param buffer 出力待ちのログを溜めるリングバッファ (非同期モードの間は破棄しないこと)
+ */
+void Log::enableAsync(LogRingBuffer& buffer)
+{
+  if (m_buffer == &buffer)
+  {
+    return;
+  }
+  if (m_buffer != nullptr)
+  {
+    flush();
+  }
+  discardLine();
+  m_reportedDrops = buffer.getDroppedCount();
+  m_buffer = &buffer;
+}
+
+/**
+ * @brief 出力待ちのログをすべて送ってから同期モードに戻す
+ *
+ * LOG_FLUSH_TIMEOUT_MS を過ぎても送りきれなかった行は捨てる。startDrainTask() のタスクは
+ * 実行中の drain() を終えてから止まるので、それまで待つ。
+ *
+ */
+void Log::disableAsync(void)
+{
+  if (m_buffer == nullptr)
+  {
+    return;
+  }
+  flush();
+#if defined(ESP32)
+  if (m_drainTask != nullptr)
+  {
+    stopDrainTask();
+    flushSinks();
+  }
+#endif
+  discardLine();
+  LogRingBuffer* buffer = m_buffer;
+  m_buffer = nullptr;
+  // flush() の後に捨てた分は同期モードで出力する
+  reportDrops(buffer->getDroppedCount());
+}
+
+/**
+ * @brief 出力待ちのログを出力先が受け取れる分だけ渡す
+ *
+ * 待たずに戻るので、メインループの空き時間に呼ぶ。出力先が受け取れなかった行は
+ * 次の呼び出しでその出力先にだけ渡し直す。LOG_SINK_TIMEOUT_MS を過ぎても受け取れない
+ * 出力先はその行を捨て、次に 1 行を受け取るまでは待たない (ほかの出力先を止めない)。
+ * isSynchronous() の出力先はログを出したときに書いているので渡さない。
+ * 最後にすべての出力先の poll() を呼ぶ。
+ * 前回から捨てたログが増えていれば、その数を WARN で出力する (次の drain() で渡す)。
+ * startDrainTask() でタスクを起動したときは呼ばないこと。
+ *
+ * @return size_t 取り出し終えた行数
+ */
+size_t Log::drain(void)
+{
+  if (m_buffer == nullptr)
+  {
+    return 0;
+  }
+  size_t lines = 0;
+  while (m_buffer->nextLine())
+  {
+    const LogRecord record = {m_buffer->getLineLevel(), m_buffer->getLine(), m_buffer->getLineLength(), nullptr, 0,
+                              m_buffer->isLineRaw(), false};
+    const uint32_t now = Timer::getGlobalTime();
+    if (!m_lineStarted)
+    {
+      m_pendingSinks = asyncSinks();
+      m_lineTime = now;
+      m_lineStarted = true;
+    }
+    if (!dispatch(record, m_pendingSinks))
+    {
+      // 止まったままの出力先だけが残っているときは待たない
+      const bool waiting = (m_pendingSinks & ~m_stalledSinks) != 0;
+      if (waiting && now - m_lineTime < LOG_SINK_TIMEOUT_MS)
+      {
+        break;
+      }
+      m_stalledSinks |= m_pendingSinks;
+      discardLine();
+    }
+    m_buffer->finishLine();
+    m_lineStarted = false;
+    lines++;
+  }
+  reportDrops();
+  for (uint8_t i = 0; i < m_sinkCount; i++)
+  {
+    m_sinks[i]->poll();
+  }
+  return lines;
+}
+
+/**
+ * @brief 出力待ちのログをすべて送り終わるまで待つ
+ *
+ * 非同期モードではリングバッファが空になるまで (LOG_FLUSH_TIMEOUT_MS まで) 待ち、
+ * その後すべての出力先の flush() を呼ぶ。startDrainTask() のタスクが動いている間は
+ * 出力先をタスクに任せ、flush() は呼ばない。
+ *
+ * @return true 送り終えた
+ * @return false 時間内に送りきれなかった
+ */
+bool Log::flush(void)
+{
+  const uint32_t start = Timer::getGlobalTime();
+  bool done = true;
+  // バッファが空でも 1 回は drain() を呼び、捨てた数の報告を出力する
+  bool first = true;
+  while (m_buffer != nullptr && (first || !m_buffer->isEmpty()))
+  {
+    if (!first && Timer::getGlobalTime() - start >= LOG_FLUSH_TIMEOUT_MS)
+    {
+      done = false;
+      break;
+    }
+    first = false;
+#if defined(ESP32)
+    if (m_drainTask != nullptr)
+    {
+      delay(1);
+      continue;
+    }
+#endif
+    drain();
+    yield();
+  }
+#if defined(ESP32)
+  if (m_drainTask != nullptr)
+  {
+    return done;
+  }
+#endif
+  flushSinks();
+  return done;
+}
+
+/* すべての出力先の flush() を呼ぶ */
+void Log::flushSinks(void)
+{
+  for (uint8_t i = 0; i < m_sinkCount; i++)
+  {
+    m_sinks[i]->flush();
+  }
+}
+
+#if defined(ESP32)
+/**
+ * @brief 出力待ちのログを送るタスクを起動する
+ *
+ * 非同期モードの間、intervalMs ごとに drain() を呼ぶ。起動した後は drain() を呼ばないこと。
+ * 出力先の write() / poll() はこのタスクから呼ばれるので、メインループとクライアントを
+ * 共有するネットワークの出力先 (isTaskSafe() が false の UDPLogSink / MQTTLogSink) とは
+ * 一緒に使えない。
+ *
+ * @param intervalMs drain() を呼ぶ間隔[ms]
+ * @param priority タスクの優先度
+ * @return true 起動した (起動済みを含む)
+ * @return false タスクを作れなかった、または isTaskSafe() が false の出力先が登録されている
+ */
+bool Log::startDrainTask(uint32_t intervalMs, UBaseType_t priority)
+{
+  if (m_drainTask != nullptr)
+  {
+    return true;
+  }
+  for (uint8_t i = 0; i < m_sinkCount; i++)
+  {
+    if (!m_sinks[i]->isTaskSafe())
+    {
+      return false;
+    }
+  }
+  m_drainInterval = intervalMs > 0 ? intervalMs : 1;
+  storeFlag(m_drainRunning, true);
+  if (xTaskCreate(drainTask, "logDrain", 3072, this, priority, &m_drainTask) != pdPASS)
+  {
+    storeFlag(m_drainRunning, false);
+    m_drainTask = nullptr;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * タスクに終了を通知し、終わるまで待つ
+ *
+ * タスクは drain() を終えてから自分で終了するので、出力先の書き込みやリングバッファの
+ * 操作の途中で止まることはない。
+ */
+void Log::stopDrainTask(void)
+{
+  if (m_drainTask == nullptr)
+  {
+    return;
+  }
+  xTaskNotifyGive(m_drainTask);
+  while (loadFlag(m_drainRunning))
+  {
+    delay(1);
+  }
+  m_drainTask = nullptr;
+}
+
+/* drain() を周期的に呼ぶタスク (stopDrainTask() から通知されたら終了する) */
+void Log::drainTask(void* context)
+{
+  Log* log = static_cast<Log*>(context);
+  for (;;)
+  {
+    log->drain();
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(log->m_drainInterval)) > 0)
+    {
+      break;
+    }
+  }
+  storeFlag(log->m_drainRunning, false);
+  vTaskDelete(nullptr);
+}
+#endif
+
+/* 行頭の「時刻[ms],レベル,」を書き込み、文字数を返す */
+size_t Log::formatPrefix(logLevelEnum type, char* buffer, size_t size)
+{
+  static const char* const kLevelTags[] = {"", "DEBUG,", "INFO,", "WARN,", "ERROR,", ""};
+  const int written = snprintf(buffer, size, "%lu,%s", (unsigned long)Timer::getGlobalTime(), kLevelTags[type]);
+  if (written < 0)
+  {
+    return 0;
+  }
+  return ((size_t)written < size) ? (size_t)written : size - 1;
+}
+
+/* バイナリログの記録を出力する (buffer の kBinaryHeaderSize 以降に writer で引数を詰めてある) */
+void Log::writeBinary(logLevelEnum type, uint32_t formatId, uint8_t* buffer, const LogArgWriter& writer)
+{
+  uint8_t* const args = buffer + kBinaryHeaderSize;
+  size_t argsLength = writer.getLength();
+  if (writer.isOverflow())
+  {
+    LogArgWriter original(args, LOG_BUFFER_SIZE - kBinaryHeaderSize);
+    original.putInteger(formatId);
+    formatId = kTooLongFormatId;
+    argsLength = original.getLength();
+  }
+
+  const uint32_t now = Timer::getGlobalTime();
+  if (m_binaryRecords == 0 || now - m_binaryTime > 0xFFFF)
+  {
+    // 絶対時刻はレベルによらずすべての出力先に送る
+    const uint8_t sync[] = {kBinarySyncTag, (uint8_t)now, (uint8_t)(now >> 8), (uint8_t)(now >> 16),
+                            (uint8_t)(now >> 24)};
+    emit(NONE, sync, sizeof(sync), nullptr, 0, true);
+    m_binaryTime = now;
+    m_binaryRecords = 0;
+  }
+  m_binaryRecords = (uint16_t)((m_binaryRecords + 1) % LOG_BINARY_SYNC_INTERVAL);
+
+  // 先頭バイト、前の絶対時刻からの時間[ms]、書式文字列の ID、引数の長さ
+  uint8_t header[kBinaryHeaderSize];
+  LogArgWriter headerWriter(header, sizeof(header));
+  const uint8_t tag = (uint8_t)(kBinaryRecordTag | type);
+  headerWriter.putBytes(&tag, 1);
+  headerWriter.putInteger((int32_t)(now - m_binaryTime));
+  const uint8_t id[] = {(uint8_t)formatId, (uint8_t)(formatId >> 8), (uint8_t)(formatId >> 16),
+                        (uint8_t)(formatId >> 24)};
+  headerWriter.putBytes(id, sizeof(id));
+  headerWriter.putVarint(argsLength);
+
+  uint8_t* const record = args - headerWriter.getLength();
+  memcpy(record, header, headerWriter.getLength());
+  emit(type, record, headerWriter.getLength() + argsLength, nullptr, 0, true);
+}
+
+/* 整形済みの文字列をバイナリログの記録として出力する */
+void Log::writeBinaryText(logLevelEnum type, const char* text)
+{
+  uint8_t buffer[LOG_BUFFER_SIZE];
+  LogArgWriter writer(buffer + kBinaryHeaderSize, sizeof(buffer) - kBinaryHeaderSize);
+  writer.putString(text);
+  writeBinary(type, kTextFormatId, buffer, writer);
+}
+
+/**
+ * @brief 出力先を追加する
+ *
+ * シリアルの出力先 (getSerialSink()) は最初から登録してある。
+ *
+ * @param sink 出力先 (登録している間は破棄しないこと)
+ * @return true 追加した (追加済みを含む)
+ * @return false LOG_MAX_SINKS を超える、または startDrainTask() のタスクが動いていて
+ *               isTaskSafe() が false の出力先
+ */
+bool Log::addSink(LogSink& sink)
+{
+  for (uint8_t i = 0; i < m_sinkCount; i++)
+  {
+    if (m_sinks[i] == &sink)
+    {
+      return true;
+    }
+  }
+  if (m_sinkCount >= LOG_MAX_SINKS)
+  {
+    return false;
+  }
+#if defined(ESP32)
+  if (m_drainTask != nullptr && !sink.isTaskSafe())
+  {
+    return false;
+  }
+#endif
+  m_sinks[m_sinkCount++] = &sink;
+  return true;
+}
+
+/**
+ * @brief 出力先を外す
+ *
+ * startDrainTask() でタスクを起動しているときは、先に disableAsync() を呼ぶこと。
+ *
+ * @param sink 出力先
+ * @return true 外した
+ * @return false 登録されていない
+ */
+bool Log::removeSink(LogSink& sink)
+{
+  for (uint8_t i = 0; i < m_sinkCount; i++)
+  {
+    if (m_sinks[i] == &sink)
+    {
+      for (uint8_t j = i + 1; j < m_sinkCount; j++)
+      {
+        m_sinks[j - 1] = m_sinks[j];
+      }
+      m_sinkCount--;
+      m_pendingSinks = removeBit(m_pendingSinks, i);
+      m_stalledSinks = removeBit(m_stalledSinks, i);
+      return true;
+    }
+  }
+  return false;
+}
+
+/* 1 行を出力先に渡す (非同期モードでは isSynchronous() の出力先に書き、リングバッファに記録する) */
+void Log::emit(logLevelEnum type, const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength,
+               bool binary)
+{
+  const LogRecord record = {(uint8_t)type, head, headLength, body, bodyLength, binary, true};
+  if (m_buffer != nullptr)
+  {
+    for (uint8_t i = 0; i < m_sinkCount; i++)
+    {
+      LogSink* sink = m_sinks[i];
+      if (sink->isSynchronous() && sink->accepts(record.level))
+      {
+        sink->write(record);
+      }
+    }
+    if (binary)
+    {
+      m_buffer->pushRaw(type, head, headLength);
+    }
+    else
+    {
+      m_buffer->push(type, (const char*)head, headLength, (const char*)body, bodyLength);
+    }
+    return;
+  }
+  uint8_t pending = (uint8_t)((1U << m_sinkCount) - 1);
+  dispatch(record, pending);
+}
+
+/* pending のビットの出力先に渡して受け取った出力先のビットを消す。受け取れない出力先があれば false を返す */
+bool Log::dispatch(const LogRecord& record, uint8_t& pending)
+{
+  for (uint8_t i = 0; i < m_sinkCount; i++)
+  {
+    const uint8_t bit = (uint8_t)(1U << i);
+    if ((pending & bit) == 0)
+    {
+      continue;
+    }
+    LogSink* sink = m_sinks[i];
+    if (!sink->accepts(record.level))
+    {
+      pending &= (uint8_t)~bit;
+    }
+    else if (sink->write(record))
+    {
+      pending &= (uint8_t)~bit;
+      if (!record.blocking)
+      {
+        m_stalledSinks &= (uint8_t)~bit;  // drain() からだけ変える (同期モードは複数のタスクから呼ばれる)
+      }
+    }
+  }
+  return pending == 0;
+}
+
+/* drain() で行を渡す出力先 (isSynchronous() の出力先を除く) */
+uint8_t Log::asyncSinks(void) const
+{
+  uint8_t sinks = 0;
+  for (uint8_t i = 0; i < m_sinkCount; i++)
+  {
+    if (!m_sinks[i]->isSynchronous())
+    {
+      sinks |= (uint8_t)(1U << i);
+    }
+  }
+  return sinks;
+}
+
+/* 取り出し中の行を受け取っていない出力先の書きかけの状態を戻す */
+void Log::discardLine(void)
+{
+  for (uint8_t i = 0; i < m_sinkCount; i++)
+  {
+    if ((m_pendingSinks & (1U << i)) != 0)
+    {
+      m_sinks[i]->discard();
+    }
+  }
+  m_pendingSinks = 0;
+  m_lineStarted = false;
+}
+
+/* 前回から捨てたログが増えていれば、その数を WARN で出力する */
+void Log::reportDrops(void)
+{
+  if (m_buffer != nullptr)
+  {
+    reportDrops(m_buffer->getDroppedCount());
+  }
+}
+
+void Log::reportDrops(uint32_t dropped)
+{
+  if (dropped < m_reportedDrops)
+  {
+    m_reportedDrops = dropped;  // 統計がクリアされた
+  }
+  if (dropped > m_reportedDrops)
+  {
+    const uint32_t reported = m_reportedDrops;
+    m_reportedDrops = dropped;
+    logf(WARN, "Log: %lu lines dropped", (unsigned long)(dropped - reported));
+    if (m_buffer != nullptr && m_buffer->getDroppedCount() != dropped)
+    {
+      // 報告の行も捨てられたので、次の呼び出しで合わせて報告する (報告の行は数えない)
+      m_reportedDrops = reported + 1;
+    }
+  }
+}
+
+/* ログの出力先 */
+Print& Log::output(void)
+{
+#ifdef USE_M5ATOM_S3
+  return USBSerial;
+#else
+  return Serial;
+#endif
+}
+
 Log logger = Log();
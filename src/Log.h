@@ -23,7 +23,380 @@
 #define LOG_SERIAL_BAUDRATE (115200)
 #endif
 
+// プリプロセッサで比べるためのログレベル (Log::logLevelEnum と同じ値)
+#define LOG_LEVEL_ALL (0)
+#define LOG_LEVEL_DEBUG (1)
+#define LOG_LEVEL_INFO (2)
+#define LOG_LEVEL_WARN (3)
+#define LOG_LEVEL_ERROR (4)
+#define LOG_LEVEL_NONE (5)
+
+#ifndef LOG_MIN_LEVEL
+// コンパイル時の最低ログレベル (これより低いレベルの LOG_xxxF() は何も生成しない)
+#define LOG_MIN_LEVEL LOG_LEVEL_ALL
+#endif
+
+#ifndef LOG_BUFFER_SIZE
+// logf() で 1 行を組み立てるバッファの大きさ (超えた分は切り詰める)
+#define LOG_BUFFER_SIZE (128)
+#endif
+
+/***********************************************************************/
+/*                       ログ用リングバッファ                          */
+/***********************************************************************/
+/**
+ * @brief 出力待ちのログを溜めるリングバッファ
+ *
+ * Log::enableAsync() で設定すると、ログはシリアルに書かずにここへ 1 行ずつ
+ * 記録され、Log::drain() (または ESP32 では Log::startDrainTask() のタスク) が
+ * 取り出して各 LogSink に渡す。SerialLogSink はシリアルの送信バッファに空きが
+ * ある分だけ送るので、呼び出し側は待たされない。
+ *
+ * 取り出し側は 1 つだけで、ロックを使わない (読み出し位置を compare-and-swap で
+ * 進める)。書き込み側は ESP32 では短いクリティカルセクションで排他するので、
+ * 複数のタスクからログを出してよい。それ以外のボードではメインループからだけ
+ * ログを出すこと。
+ *
+ * 容量は 2 のべき乗 [byte]。1 行あたり 2 byte の長さとレベルを加えて記録する (1 行は 4095 byte まで)。
+ */
+class LogRingBuffer {
+ public:
+  // 空きが足りないときの動作
+  typedef enum { DROP_NEWEST, DROP_OLDEST } overflowPolicyEnum;
+
+  bool push(uint8_t level, const char* head, size_t headLength, const char* body = nullptr, size_t bodyLength = 0);
+  bool pushRaw(uint8_t level, const uint8_t* data, size_t length);
+  bool nextLine(void);
+  const uint8_t* getLine(void) const { return (const uint8_t*)m_line; }
+  size_t getLineLength(void) const { return m_lineLength; }
+  uint8_t getLineLevel(void) const { return m_lineLevel; }
+  bool isLineRaw(void) const { return m_lineRaw; }
+  void finishLine(void);
+  bool isEmpty(void) const;
+  size_t getUsed(void) const;
+  size_t getCapacity(void) const { return m_mask + 1; }
+  size_t getHighWatermark(void) const { return m_highWatermark; }
+  uint32_t getDroppedCount(void) const;
+  void clearStatistics(void);
+  overflowPolicyEnum getPolicy(void) const { return m_policy; }
+  void setPolicy(overflowPolicyEnum policy) { m_policy = policy; }
+
+ protected:
+  LogRingBuffer(uint8_t* storage, size_t capacity, char* line, size_t lineSize, overflowPolicyEnum policy);
+
+ private:
+  LogRingBuffer(const LogRingBuffer&) = delete;
+  LogRingBuffer& operator=(const LogRingBuffer&) = delete;
+
+  bool pushRecord(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength, uint16_t flags);
+  uint16_t readHeader(uint32_t position) const;
+  void copyOut(uint32_t position, char* buffer, size_t length) const;
+  void copyIn(uint32_t position, const uint8_t* data, size_t length);
+
+  uint8_t* m_storage;
+  uint32_t m_mask;
+  uint32_t m_head;  // 書き込み位置 (書き込み側だけが進める)
+  uint32_t m_tail;  // 読み出し位置 (取り出し側と DROP_OLDEST の書き込み側が進める)
+  overflowPolicyEnum m_policy;
+  uint32_t m_dropped;
+  size_t m_highWatermark;
+  char* m_line;  // 取り出し中の 1 行 (改行なし)
+  size_t m_lineSize;
+  size_t m_lineLength;
+  uint8_t m_lineLevel;
+  bool m_lineRaw;
+  bool m_hasLine;
+#if defined(ESP32)
+  portMUX_TYPE m_lock;
+#endif
+};
+
+/**
+ * @brief 領域を持つリングバッファ
+ *
+ * @tparam Capacity 容量 [byte] (2 のべき乗)
+ * @tparam LineSize 取り出すときの 1 行の最大長 [byte] (超えた分は切り詰める)
+ */
+template <size_t Capacity, size_t LineSize = LOG_BUFFER_SIZE>
+class LogRingBufferN : public LogRingBuffer {
+  static_assert(Capacity >= 16 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+  static_assert(LineSize >= 8, "LineSize is too small");
+
+ public:
+  explicit LogRingBufferN(overflowPolicyEnum policy = DROP_NEWEST)
+      : LogRingBuffer(m_buffer, Capacity, m_lineBuffer, LineSize, policy) {}
+
+ private:
+  uint8_t m_buffer[Capacity];
+  char m_lineBuffer[LineSize];
+};
+
+/***********************************************************************/
+/*                        バイナリログの符号化                         */
+/***********************************************************************/
+#ifndef LOG_BINARY_SYNC_INTERVAL
+// バイナリログで絶対時刻を送る間隔 [記録数]
+#define LOG_BINARY_SYNC_INTERVAL (64)
+#endif
+
+// 書式文字列の ID (FNV-1a 32bit。tools/decode_binary_log.py と同じ計算)
+constexpr uint32_t logFormatHash(const char* format, uint32_t hash = 2166136261UL) {
+  return *format == '\0' ? hash : logFormatHash(format + 1, (uint32_t)((hash ^ (uint8_t)*format) * 16777619UL));
+}
+
+// 書式文字列の ID をコンパイル時に確定させるための型
+template <uint32_t Id>
+struct LogFormatId {
+  static const uint32_t value = Id;
+};
+
+// LOG_xxxF() の書式と引数をコンパイル時に検査するためだけの関数 (呼ばれない)
+inline void logFormatCheck(const char*, ...) __attribute__((format(printf, 1, 2)));
+inline void logFormatCheck(const char*, ...) {}
+
+/**
+ * @brief バイナリログの引数を詰める
+ *
+ * 整数は zigzag 符号化した varint、浮動小数点数は float (4 byte, little endian)、
+ * 文字列は varint の長さと本体で書き込む。書式文字列を見なくても引数の型だけで
+ * 符号化が決まり、デコーダは書式文字列の変換指定から読み方を決める。
+ */
+class LogArgWriter {
+ public:
+  LogArgWriter(uint8_t* data, size_t size) : m_data(data), m_size(size), m_length(0), m_overflow(false) {}
+
+  void put(bool value) { putInteger(value ? 1 : 0); }
+  void put(char value) { putInteger(value); }
+  void put(signed char value) { putInteger(value); }
+  void put(unsigned char value) { putInteger(value); }
+  void put(short value) { putInteger(value); }
+  void put(unsigned short value) { putInteger(value); }
+  void put(int value) { putInteger(value); }
+  void put(unsigned int value) { putInteger(value); }
+  void put(long value) { putInteger(value); }
+  void put(unsigned long value) { putInteger((int64_t)value); }
+  void put(long long value) { putInteger(value); }
+  void put(unsigned long long value) { putInteger((int64_t)value); }
+  void put(float value) { putFloat(value); }
+  void put(double value) { putFloat((float)value); }
+  void put(const char* value) { putString(value); }
+  void put(const void* value) { putInteger((int64_t)(uintptr_t)value); }
+
+  void putInteger(int64_t value);
+  void putFloat(float value);
+  void putString(const char* value);
+  void putVarint(uint64_t value);
+  void putBytes(const uint8_t* data, size_t length);
+
+  size_t getLength(void) const { return m_length; }
+  bool isOverflow(void) const { return m_overflow; }
+
+ private:
+  uint8_t* m_data;
+  size_t m_size;
+  size_t m_length;
+  bool m_overflow;
+};
+
+/***********************************************************************/
+/*                            ログの出力先                             */
+/***********************************************************************/
+#ifndef LOG_MAX_SINKS
+// Log に登録できる出力先の数 (8 まで)
+#define LOG_MAX_SINKS (4)
+#endif
+
+#ifndef LOG_SINK_TIMEOUT_MS
+// 非同期モードで 1 行を受け取れない出力先を待つ時間 [ms] (過ぎたらその出力先だけ行を捨てる)
+#define LOG_SINK_TIMEOUT_MS (100)
+#endif
+
+#ifndef LOG_FLUSH_TIMEOUT_MS
+// Log::flush() が送り終わるまで待つ最大の時間 [ms]
+#define LOG_FLUSH_TIMEOUT_MS (1000)
+#endif
+
+#ifndef LOG_BATCH_SIZE
+// BatchLogSink がまとめて送る大きさ [byte]
+#define LOG_BATCH_SIZE (512)
+#endif
+
+#if defined(ESP32)
+// ソフトウェアリセットで消えない変数にする属性 (RetainedLogSink の領域に付ける)
+#define LOG_RETAINED_ATTR RTC_NOINIT_ATTR
+#elif defined(__AVR__)
+#define LOG_RETAINED_ATTR __attribute__((section(".noinit")))
+#else
+#define LOG_RETAINED_ATTR
+#endif
+
+/**
+ * @brief 出力先に渡す 1 行
+ *
+ * 整形は Log で 1 回だけ行い、すべての出力先に同じバイト列を渡す。
+ * 行は head と body をつなげたもので、改行は含まない。
+ */
+struct LogRecord {
+  uint8_t level;  // ログレベル (Log::logLevelEnum の値)
+  const uint8_t* head;
+  size_t headLength;
+  const uint8_t* body;
+  size_t bodyLength;
+  bool binary;    // バイナリログの記録 (改行を付けずにそのまま送る)
+  bool blocking;  // 同期モード (出力し終わるまで待ってよい)
+
+  size_t length(void) const { return headLength + bodyLength; }
+  void copyTo(uint8_t* buffer, size_t offset, size_t length) const;
+};
+
+/**
+ * @brief ログの出力先
+ *
+ * Log::addSink() で登録すると、レベルが getLevel() 以上のログを受け取る。
+ */
+class LogSink {
+ public:
+  explicit LogSink(uint8_t level = 0) : m_level(level) {}
+  virtual ~LogSink() {}
+
+  /**
+   * @brief 1 行を出力する
+   *
+   * record.blocking が false のとき (非同期モードの Log::drain() から) は待たずに戻り、
+   * 出力しきれなければ false を返す。このとき同じ行でもう一度呼ばれるが、
+   * LOG_SINK_TIMEOUT_MS を過ぎても受け取れなければ discard() を呼んでその行は渡さない。
+   * record.blocking が true のときは出力し終えて true を返すこと。
+   */
+  virtual bool write(const LogRecord& record) = 0;
+  // 出力しきれなかった行を捨てる (書きかけの状態を戻す)
+  virtual void discard(void) {}
+  // 非同期モードでもリングバッファを通さずにログを出した場所で書く (待たずに書ける出力先だけ)
+  virtual bool isSynchronous(void) const { return false; }
+  // Log::startDrainTask() のタスクから呼ばれてもよい (ほかのタスクと共有するものを使わない)
+  virtual bool isTaskSafe(void) const { return true; }
+  // Log::drain() のたびに呼ばれる (溜めた行を送るなど)
+  virtual void poll(void) {}
+  // 溜めている行をすべて送る
+  virtual void flush(void) {}
+
+  uint8_t getLevel(void) const { return m_level; }
+  void setLevel(uint8_t level) { m_level = level; }
+  bool accepts(uint8_t level) const { return level >= m_level; }
+
+ private:
+  uint8_t m_level;
+};
+
+/**
+ * @brief シリアルなどの Print に書く出力先
+ *
+ * 非同期モードでは availableForWrite() の分だけ書き、残りは次の drain() で書く。
+ */
+class SerialLogSink : public LogSink {
+ public:
+  explicit SerialLogSink(Print& output, uint8_t level = 0) : LogSink(level), m_output(&output), m_offset(0) {}
+
+  bool write(const LogRecord& record) override;
+  void discard(void) override { m_offset = 0; }
+  void setOutput(Print& output) { m_output = &output; }
+
+ private:
+  Print* m_output;
+  size_t m_offset;  // 書きかけの行の書き込み済みのバイト数
+};
+
+/**
+ * @brief ソフトウェアリセットやクラッシュの後も残る RAM 上の出力先
+ *
+ * 領域をリングバッファとして最新のログを残す。LOG_RETAINED_ATTR を付けた領域を渡すと、
+ * 再起動後に前回のログを dump() で読み出せる (電源を切ると消える)。
+ * 非同期モードでもログを出した場所で書くので、クラッシュの直前のログも残る。
+ *
+ * @code
+ * LOG_RETAINED_ATTR uint32_t crashLogArea[512];
+ * RetainedLogSink crashLog(crashLogArea, sizeof(crashLogArea), Log::WARN);
+ * @endcode
+ */
+class RetainedLogSink : public LogSink {
+ public:
+  RetainedLogSink(void* area, size_t size, uint8_t level = 0);
+
+  bool write(const LogRecord& record) override;
+  bool isSynchronous(void) const override { return true; }
+  bool wasRetained(void) const { return m_retained; }
+  size_t getLength(void) const;
+  size_t read(uint8_t* buffer, size_t size) const;
+  void dump(Print& output) const;
+  void clear(void);
+
+ private:
+  struct Header {
+    uint32_t magic;
+    uint32_t head;  // 書き込んだ総バイト数
+    uint32_t capacity;
+    uint32_t check;
+  };
+
+  void append(const uint8_t* data, size_t length);
+  void seal(void);
+
+  Header* m_header;
+  uint8_t* m_data;
+  uint32_t m_capacity;
+  bool m_retained;  // 起動時に前回のログが残っていた
+#if defined(ESP32)
+  portMUX_TYPE m_lock;  // 複数のタスクからのログを排他する
+#endif
+};
+
+/**
+ * @brief 行をまとめて送る出力先の基底クラス
+ *
+ * 行を LOG_BATCH_SIZE までまとめ、いっぱいになったときか、最初の行から
+ * intervalMs が過ぎた後の Log::drain() で send() を呼ぶ。テキストの行は '\n' で区切る。
+ *
+ * 同期モードでは複数のタスクからのログで呼ばれるので、ESP32 ではまとめている行を
+ * ミューテックスで排他する (send() の間も持つ)。send() はメインループと共有する
+ * クライアントを使うので、Log::startDrainTask() のタスクからは呼ばない
+ * (isTaskSafe() が false なので、タスクとは一緒に登録できない)。
+ */
+class BatchLogSink : public LogSink {
+ public:
+  ~BatchLogSink() override;
+
+  bool write(const LogRecord& record) override;
+  void poll(void) override;
+  void flush(void) override;
+  bool isTaskSafe(void) const override { return false; }
+
+  uint32_t getSentCount(void) const { return m_sent; }
+  uint32_t getDroppedCount(void) const { return m_dropped; }
+
+ protected:
+  BatchLogSink(uint32_t intervalMs, uint8_t level);
+
+  // まとめた行を送る
+  virtual bool send(const uint8_t* data, size_t length) = 0;
+  // 行の前に付ける文字列を書き、長さを返す (既定は何も付けない)
+  virtual size_t formatPrefix(const LogRecord& record, uint8_t* buffer, size_t size);
+
+ private:
+  uint8_t m_batch[LOG_BATCH_SIZE];
+  size_t m_length;
+  uint16_t m_lines;
+  uint32_t m_interval;
+  uint32_t m_firstTime;  // まとめている最初の行の時刻 [ms]
+  uint32_t m_sent;
+  uint32_t m_dropped;
+  bool m_sending;  // send() の中 (send() の中で出したログは捨てる)
+#if defined(ESP32)
+  SemaphoreHandle_t m_mutex;  // まとめている行を排他する (send() の中で出したログのために再帰的)
+#endif
+};
+
 class Log {
+  static_assert(LOG_MAX_SINKS <= 8, "LOG_MAX_SINKS must be 8 or less");
+
  public:
   // ログレベルの列挙型
   typedef enum elog { ALL, DEBUG, INFO, WARN, ERROR, NONE } logLevelEnum;
@@ -33,15 +406,149 @@ class Log {
   void serialEnd(void);
   logLevelEnum getLevel(void);
   void setLevel(logLevelEnum level);
-  void log(logLevelEnum type, String msg);
-  void info(String msg);
-  void debug(String msg);
-  void warn(String msg);
-  void error(String msg);
+  // 出力するレベルかを返す (コンパイル時の最低レベルも含めて判定する)
+  bool isEnabled(logLevelEnum type) const { return type >= LOG_MIN_LEVEL && type >= m_level; }
+  void log(logLevelEnum type, const String& msg);
+  void logf(logLevelEnum type, const char* format, ...) __attribute__((format(printf, 3, 4)));
+  template <typename... Args>
+  void logRecord(logLevelEnum type, uint32_t formatId, const char* format, const Args&... args);
+  void info(const String& msg);
+  void debug(const String& msg);
+  void warn(const String& msg);
+  void error(const String& msg);
   void changeBaudrate(uint32_t baudrate);
+  void enableAsync(LogRingBuffer& buffer);
+  void disableAsync(void);
+  bool isAsync(void) const { return m_buffer != nullptr; }
+  void setBinary(bool binary);
+  bool isBinary(void) const { return m_binary; }
+  bool addSink(LogSink& sink);
+  bool removeSink(LogSink& sink);
+  SerialLogSink& getSerialSink(void) { return m_serialSink; }
+  size_t drain(void);
+  bool flush(void);
+#if defined(ESP32)
+  bool startDrainTask(uint32_t intervalMs = 2, UBaseType_t priority = 1);
+#endif
 
  private:
+  // バイナリログの記録の先頭バイト (下位 4 ビットはログレベル)
+  static const uint8_t kBinaryRecordTag = 0xA0;
+  // バイナリログの絶対時刻の記録の先頭バイト
+  static const uint8_t kBinarySyncTag = 0xAF;
+  // バイナリログの記録の先頭に確保する大きさ
+  static const size_t kBinaryHeaderSize = 16;
+  // 書式文字列 "%s" (log() と logf() の整形済みの文字列)
+  static const uint32_t kTextFormatId = 0;
+  // 引数がバッファに収まらなかった記録 (引数は元の書式文字列の ID)
+  static const uint32_t kTooLongFormatId = 1;
+
+  size_t formatPrefix(logLevelEnum type, char* buffer, size_t size);
+  void writeBinary(logLevelEnum type, uint32_t formatId, uint8_t* buffer, const LogArgWriter& writer);
+  void writeBinaryText(logLevelEnum type, const char* text);
+  void emit(logLevelEnum type, const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength,
+            bool binary);
+  bool dispatch(const LogRecord& record, uint8_t& pending);
+  uint8_t asyncSinks(void) const;
+  void discardLine(void);
+  void reportDrops(void);
+  void reportDrops(uint32_t dropped);
+  Print& output(void);
+  void flushSinks(void);
+#if defined(ESP32)
+  void stopDrainTask(void);
+  static void drainTask(void* context);
+#endif
+
   logLevelEnum m_level;
+  SerialLogSink m_serialSink;
+  LogSink* m_sinks[LOG_MAX_SINKS];
+  uint8_t m_sinkCount;
+  bool m_lineStarted;      // drain() で取り出し中の行を出力先に渡し始めた
+  uint8_t m_pendingSinks;  // 取り出し中の行をまだ受け取っていない出力先 (ビットは m_sinks の番号)
+  uint8_t m_stalledSinks;  // LOG_SINK_TIMEOUT_MS を過ぎても受け取れなかった出力先
+  uint32_t m_lineTime;     // 取り出し中の行を渡し始めた時刻 [ms]
+  LogRingBuffer* m_buffer;
+  uint32_t m_reportedDrops;
+  bool m_binary;
+  uint16_t m_binaryRecords;  // 前に絶対時刻を送ってからの記録数
+  uint32_t m_binaryTime;     // 前に送った絶対時刻 [ms]
+#if defined(ESP32)
+  TaskHandle_t m_drainTask;
+  uint32_t m_drainInterval;
+  bool m_drainRunning;  // タスクが drain() を呼んでいる (タスクが終了する直前に false にする)
+#endif
 };
 
-extern Log logger;
\ No newline at end of file
+extern Log logger;
+
+/**
+ * @brief 書式文字列の ID を付けてログを出力する
+ *
+ * テキストモードでは logf() と同じ。バイナリモードでは文字列に整形せず、
+ * 書式文字列の ID と引数をそのまま詰めて出力する。通常は LOG_xxxF() から呼ぶ。
+ *
+ * @param type ログレベル
+ * @param formatId 書式文字列の ID (logFormatHash(format))
+ * @param format printf 形式の書式 (文字列リテラル)
+ * @param args 引数
+ */
+template <typename... Args>
+void Log::logRecord(logLevelEnum type, uint32_t formatId, const char* format, const Args&... args) {
+  if (!isEnabled(type)) {
+    return;
+  }
+  if (!m_binary) {
+    logf(type, format, args...);
+    return;
+  }
+  uint8_t buffer[LOG_BUFFER_SIZE];
+  LogArgWriter writer(buffer + kBinaryHeaderSize, sizeof(buffer) - kBinaryHeaderSize);
+  const int expand[] = {0, (writer.put(args), 0)...};
+  (void)expand;
+  writeBinary(type, formatId, buffer, writer);
+}
+
+// printf 形式でログを出力する。レベルが足りなければ引数を評価しない
+// format は文字列リテラル (バイナリモードではコンパイル時に計算した ID だけを送る)
+#define LOG_PRINTF(type, format, ...)                                                              \
+  do {                                                                                             \
+    if (logger.isEnabled(type)) {                                                                  \
+      if (false) {                                                                                 \
+        logFormatCheck(format, ##__VA_ARGS__);                                                     \
+      }                                                                                            \
+      logger.logRecord(type, LogFormatId<logFormatHash(format)>::value, format, ##__VA_ARGS__); \
+    }                                                                                              \
+  } while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUGF(...) LOG_PRINTF(Log::DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUGF(...) \
+  do {                  \
+  } while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFOF(...) LOG_PRINTF(Log::INFO, __VA_ARGS__)
+#else
+#define LOG_INFOF(...) \
+  do {                 \
+  } while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARNF(...) LOG_PRINTF(Log::WARN, __VA_ARGS__)
+#else
+#define LOG_WARNF(...) \
+  do {                 \
+  } while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERRORF(...) LOG_PRINTF(Log::ERROR, __VA_ARGS__)
+#else
+#define LOG_ERRORF(...) \
+  do {                  \
+  } while (0)
+#endif
@@ -9,6 +9,7 @@
 
 #include "MQTTClientESP32.h"
 
+#include "Clock.h"
 #include "Log.h"
 
 #ifndef MQTT_FEATURE_DISABLED
@@ -26,6 +27,8 @@ MQTTClientESP32::MQTTClientESP32(String mqttHost, uint16_t mqttPort, uint16_t bu
   , _lastReconnectAttempt(0)
   , _wifiClient(WiFiClient())
   , _mqttClient(PubSubClient(_wifiClient))
+  , _queue(nullptr)
+  , _burst(MQTT_PUBLISH_BURST)
   , _messageCallbacks()
   , _subscribedTopics()
 {
@@ -70,6 +73,8 @@ bool MQTTClientESP32::reconnect()
 /**
  * @brief 接続確認（再接続処理含む）
  *
+ * 接続中は、送信キューのメッセージを enableQueue() で指定した数まで送る。
+ *
  * @return true
  * @return false
  */
@@ -77,7 +82,7 @@ bool MQTTClientESP32::healthCheck(void)
 {
   if (!_mqttClient.connected())
   {
-    long now = millis();
+    long now = Clock::nowMillis();
     if (now - _lastReconnectAttempt > MQTT_RECONNECT_INTERVAL)
     {
       _lastReconnectAttempt = now;
@@ -94,6 +99,7 @@ bool MQTTClientESP32::healthCheck(void)
   {
     // Client connected
     _mqttClient.loop();
+    flushQueue(_burst);
     return true;
   }
   return false;
@@ -102,31 +108,123 @@ bool MQTTClientESP32::healthCheck(void)
 /**
  * @brief メッセージをPublishする
  *
+ * enableQueue() で送信キューを登録しているときは、キューに溜めるだけで
+ * healthCheck() の中で送る。
+ *
  * @param topic トピック名
  * @param payload ペイロード
- * @return true
- * @return false
+ * @return true 送信した (キューを使うときは溜めた)
+ * @return false 送信できなかった (キューを使うときは空きが足りず捨てた)
  */
 bool MQTTClientESP32::publish(String topic, String payload, bool retained)
 {
-  return publish(topic, payload.c_str(), payload.length(), retained);
+  return publish(topic.c_str(), reinterpret_cast<const uint8_t*>(payload.c_str()), payload.length(), retained);
 }
 
 bool MQTTClientESP32::publish(String topic, const char* payload, int plength, bool retained)
+{
+  return publish(topic.c_str(), reinterpret_cast<const uint8_t*>(payload), static_cast<size_t>(plength), retained);
+}
+
+/**
+ * @brief '\0' で終わる文字列をPublishする (String を確保しない)
+ *
+ * publish() の多重定義にすると publish(topic, buffer, length) の length が
+ * retained に変換されて選ばれてしまうので、名前を分けている。
+ *
+ * @param topic トピック名
+ * @param payload ペイロード ('\0' で終わる文字列)
+ * @param retained retained メッセージにするか
+ * @return true 送信した (キューを使うときは溜めた)
+ * @return false 送信できなかった (キューを使うときは空きが足りず捨てた)
+ */
+bool MQTTClientESP32::publishString(const char* topic, const char* payload, bool retained)
+{
+  return publish(topic, reinterpret_cast<const uint8_t*>(payload), strlen(payload), retained);
+}
+
+bool MQTTClientESP32::publish(const char* topic, const uint8_t* payload, size_t length, bool retained)
+{
+  if (_queue != nullptr)
+  {
+    return _queue->push(topic, payload, length, retained);
+  }
+  return send(topic, payload, length, retained);
+}
+
+/**
+ * @brief 送信キューを使う
+ *
+ * 以降の publish() はキューに溜めるだけになり、切断中も捨てずに残す。
+ * 接続中の healthCheck() のたびに、古いものから burst 個まで送る。
+ *
+ * @param queue 送信キュー (使っている間は破棄しないこと)
+ * @param burst healthCheck() 1 回で送るメッセージ数
+ */
+void MQTTClientESP32::enableQueue(MQTTPublishQueue& queue, uint8_t burst)
+{
+  _queue = &queue;
+  _burst = burst > 0 ? burst : 1;
+}
+
+/**
+ * @brief 送信キューを使うのをやめる
+ *
+ * 以降の publish() はすぐに送る。キューに残っているメッセージはそのまま残す。
+ */
+void MQTTClientESP32::disableQueue(void)
+{
+  _queue = nullptr;
+}
+
+/**
+ * @brief 送信キューのメッセージを古いものから送る
+ *
+ * 切断したら送るのをやめ、残りは次に接続したときに送る。接続したまま送れなかった
+ * メッセージは捨てる (getDroppedCount() に数える)。
+ *
+ * @param maxMessages 送るメッセージ数の上限
+ * @return size_t 送ったメッセージ数
+ */
+size_t MQTTClientESP32::flushQueue(size_t maxMessages)
+{
+  if (_queue == nullptr)
+  {
+    return 0;
+  }
+  size_t sent = 0;
+  MQTTPublishQueue::Message message;
+  for (size_t i = 0; i < maxMessages && _mqttClient.connected() && _queue->front(message); i++)
+  {
+    if (send(message.topic, message.payload, message.length, message.retained))
+    {
+      _queue->pop();
+      sent++;
+    }
+    else if (_mqttClient.connected())
+    {
+      _queue->drop();
+    }
+  }
+  return sent;
+}
+
+/* PubSubClient でメッセージを送る */
+bool MQTTClientESP32::send(const char* topic, const uint8_t* payload, size_t length, bool retained)
 {
   uint16_t mqttBufSize = _mqttClient.getBufferSize();
-  uint16_t dataSize = MQTT_MAX_HEADER_SIZE + 2 + topic.length() + plength;
+  size_t dataSize = MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length;
   if (dataSize > mqttBufSize)
   {
     // メッセージサイズがオーバーしているとき
+    _mqttClient.beginPublish(topic, length, retained);
+    _mqttClient.write(payload, length);
+    bool result = _mqttClient.endPublish() != 0;
+    // 送り終えてからログを出す (ログの出力先がこのクライアントに publish しても payload が壊れないように)
     logger.warn("MQTT message too long. bufSize: " + String(mqttBufSize) + ", dataSize: " + String(dataSize));
-    _mqttClient.beginPublish(topic.c_str(), plength, retained);
-    _mqttClient.print(payload);
-    _mqttClient.endPublish();
-    return true;
+    return result;
   }
-  return _mqttClient.publish(topic.c_str(), reinterpret_cast<const uint8_t*>(payload),
-                             static_cast<unsigned int>(plength), retained);
+  return _mqttClient.publish(topic, payload, static_cast<unsigned int>(length), retained);
 }
 
 /**
@@ -14,6 +14,8 @@
 #include <vector>
 #include <functional>
 
+#include "MQTTPublishQueue.h"
+
 #if __has_include(<PubSubClient.h>)
 #include <PubSubClient.h>
 #else
@@ -27,6 +29,11 @@
 /** MQTTの接続リトライインターバル[ms] */
 #define MQTT_RECONNECT_INTERVAL (5000)
 
+#ifndef MQTT_PUBLISH_BURST
+/** healthCheck() 1 回で送信キューから送るメッセージ数の初期値 */
+#define MQTT_PUBLISH_BURST (8)
+#endif
+
 class MQTTClientESP32
 {
 public:
@@ -39,6 +46,14 @@ public:
   bool healthCheck(void);
   bool publish(String topic, String payload, bool retained = false);
   bool publish(String topic, const char *payload, int plength, bool retained = false);
+  bool publishString(const char *topic, const char *payload, bool retained = false);
+  bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained = false);
+  void enableQueue(MQTTPublishQueue &queue, uint8_t burst = MQTT_PUBLISH_BURST);
+  void disableQueue(void);
+  MQTTPublishQueue *getQueue(void) { return _queue; };
+  size_t getQueueDepth(void) const { return _queue != nullptr ? _queue->getDepth() : 0; };
+  uint32_t getDroppedCount(void) const { return _queue != nullptr ? _queue->getDroppedCount() : 0; };
+  size_t flushQueue(size_t maxMessages);
   bool subscribe(String topic);
   String getClientId(void) { return _clientId; };
   void onMessage(char *topic, byte *payload, unsigned int length);
@@ -48,6 +63,7 @@ public:
 
 private:
   bool reconnect(void);
+  bool send(const char *topic, const uint8_t *payload, size_t length, bool retained);
 
   uint16_t _lastReconnectAttempt;
   WiFiClient _wifiClient;
@@ -55,6 +71,11 @@ private:
   String _mqttHost;
   uint16_t _mqttPort;
   String _clientId;
+
+  // 送信キュー (なければ nullptr)
+  MQTTPublishQueue *_queue;
+  // healthCheck() 1 回で送信キューから送るメッセージ数
+  uint8_t _burst;
   
   // コールバック関数のリスト
   std::vector<MessageCallback> _messageCallbacks;
@@ -0,0 +1,45 @@
+/**
+ * @file MQTTLogSink.h
+ * @brief ログを MQTT のトピックに送る出力先
+ *
+ * @details 行を '\n' 区切りでまとめ、1 つのメッセージとして topic に publish する。
+ * 送るのは Log::drain() / flush() の中か、LOG_BATCH_SIZE がいっぱいになったときなので、
+ * ログを出すたびにネットワークを待たない。
+ * 送るクライアントはメインループと共有するので、Log::startDrainTask() とは一緒に使えない
+ * (addSink() / startDrainTask() が false を返す)。非同期モードでは logger.drain() を
+ * メインループから呼ぶ。
+ *
+ * @code
+ * MQTTLogSink mqttLog(mqttClient, "node1/log", 2000, Log::WARN);
+ *
+ * void setup() {
+ *   logger.addSink(mqttLog);
+ * }
+ * @endcode
+ */
+
+#pragma once
+
+#include "Log.h"
+#include "MQTTClientESP32.h"
+
+class MQTTLogSink : public BatchLogSink {
+ public:
+  /**
+   * @param client 送信に使う MQTT クライアント
+   * @param topic 送信先のトピック
+   * @param intervalMs 最初の行を溜めてから送るまでの時間 [ms]
+   * @param level 出力するログレベル
+   */
+  MQTTLogSink(MQTTClientESP32& client, const char* topic, uint32_t intervalMs = 1000, uint8_t level = 0)
+      : BatchLogSink(intervalMs, level), m_client(client), m_topic(topic) {}
+
+ protected:
+  bool send(const uint8_t* data, size_t length) override {
+    return m_client.publish(m_topic, data, length);
+  }
+
+ private:
+  MQTTClientESP32& m_client;
+  const char* m_topic;
+};
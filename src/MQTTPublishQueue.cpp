@@ -0,0 +1,280 @@
+/**
+ * @file MQTTPublishQueue.cpp
+ * @brief MQTT の送信待ちメッセージを溜めるキュー
+ * @author Tatsuya Miyazaki
+ *
+ * @details 領域には次の形式でメッセージを先頭から順に詰める。
+ * 先頭の古いメッセージから送り、空きが足りなくなったら送り終えた分と
+ * 置き換えたメッセージを詰めて空ける。
+ *
+ * - フラグ (1 byte): bit0 retained、bit1 新しい値で置き換えた
+ * - トピックの長さ (2 byte、'\0' を含む)
+ * - ペイロードの長さ (2 byte)
+ * - トピック ('\0' 終端)、ペイロード
+ */
+
+#include "MQTTPublishQueue.h"
+
+#include <string.h>
+
+namespace
+{
+
+// メッセージの先頭に付けるバイト数
+const size_t kHeaderSize = 5;
+const uint8_t kRetainedFlag = 0x01;
+const uint8_t kDeadFlag = 0x02;
+// トピックとペイロードの長さの最大値
+const size_t kMaxLength = 0xFFFF;
+
+size_t readLength(const uint8_t* data)
+{
+  return ((size_t)data[0] << 8) | data[1];
+}
+
+void writeLength(uint8_t* data, size_t length)
+{
+  data[0] = (uint8_t)(length >> 8);
+  data[1] = (uint8_t)length;
+}
+
+} // namespace
+
+/**
+ * @brief 領域を指定してキューを作る
+ *
+ * @param storage 領域
+ * @param capacity 領域の大きさ [byte]
+ * @param policy 空きが足りないときの動作
+ * @param coalesce 同じトピックのメッセージの扱い
+ */
+MQTTPublishQueue::MQTTPublishQueue(uint8_t* storage, size_t capacity, overflowPolicyEnum policy,
+                                   coalesceEnum coalesce)
+  : _storage(storage)
+  , _capacity(capacity)
+  , _head(0)
+  , _tail(0)
+  , _count(0)
+  , _deadBytes(0)
+  , _policy(policy)
+  , _coalesce(coalesce)
+  , _highWatermark(0)
+  , _dropped(0)
+  , _coalesced(0)
+{
+}
+
+/**
+ * @brief メッセージを溜める
+ *
+ * LATEST_VALUE のときは、送信待ちの同じトピックのメッセージを新しい値で置き換える
+ * (ペイロードの長さが同じなら同じ位置のまま書き換え、違えば古い方を消して末尾に追加する)。
+ * 空きが足りないときは、DROP_NEWEST ならこのメッセージを捨て、DROP_OLDEST なら
+ * 入るまで古いメッセージから捨てる。捨てたメッセージは getDroppedCount() に数える。
+ *
+ * @param topic トピック
+ * @param payload ペイロード
+ * @param length ペイロードの長さ
+ * @param retained retain フラグ
+ * @return true 溜めた
+ * @return false 空きが足りず捨てた
+ */
+bool MQTTPublishQueue::push(const char* topic, const uint8_t* payload, size_t length, bool retained)
+{
+  const size_t topicLength = strlen(topic) + 1;
+  const size_t need = kHeaderSize + topicLength + length;
+  if (topicLength > kMaxLength || length > kMaxLength || need > _capacity)
+  {
+    _dropped++;
+    return false;
+  }
+
+  size_t replaced = _tail;
+  if (_coalesce == LATEST_VALUE)
+  {
+    replaced = find(topic, topicLength);
+  }
+  if (replaced != _tail)
+  {
+    uint8_t* record = _storage + replaced;
+    if (readLength(record + 3) == length)
+    {
+      record[0] = retained ? kRetainedFlag : 0;
+      memcpy(record + kHeaderSize + topicLength, payload, length);
+      _coalesced++;
+      return true;
+    }
+  }
+
+  size_t available = _capacity - getUsed();
+  if (replaced != _tail)
+  {
+    available += recordSize(replaced);
+  }
+  if (available < need && _policy == DROP_NEWEST)
+  {
+    _dropped++;
+    return false;
+  }
+  if (replaced != _tail)
+  {
+    _storage[replaced] |= kDeadFlag;
+    _deadBytes += recordSize(replaced);
+    _count--;
+    _coalesced++;
+    skipDead();
+  }
+  while (_capacity - getUsed() < need)
+  {
+    drop();
+  }
+  if (_capacity - _tail < need)
+  {
+    compact();
+  }
+
+  uint8_t* record = _storage + _tail;
+  record[0] = retained ? kRetainedFlag : 0;
+  writeLength(record + 1, topicLength);
+  writeLength(record + 3, length);
+  memcpy(record + kHeaderSize, topic, topicLength);
+  memcpy(record + kHeaderSize + topicLength, payload, length);
+  _tail += need;
+  _count++;
+  if (getUsed() > _highWatermark)
+  {
+    _highWatermark = getUsed();
+  }
+  return true;
+}
+
+/**
+ * @brief 最も古いメッセージを参照する
+ *
+ * @param message 参照先 (次に push() / pop() するまで有効)
+ * @return true メッセージがある
+ * @return false 空
+ */
+bool MQTTPublishQueue::front(Message& message) const
+{
+  if (_count == 0)
+  {
+    return false;
+  }
+  const uint8_t* record = _storage + _head;
+  const size_t topicLength = readLength(record + 1);
+  message.topic = (const char*)(record + kHeaderSize);
+  message.payload = record + kHeaderSize + topicLength;
+  message.length = readLength(record + 3);
+  message.retained = (record[0] & kRetainedFlag) != 0;
+  return true;
+}
+
+/**
+ * @brief 送り終えた最も古いメッセージを取り除く
+ *
+ */
+void MQTTPublishQueue::pop(void)
+{
+  if (_count == 0)
+  {
+    return;
+  }
+  _head += recordSize(_head);
+  _count--;
+  skipDead();
+}
+
+/**
+ * @brief 最も古いメッセージを捨てる (getDroppedCount() に数える)
+ *
+ */
+void MQTTPublishQueue::drop(void)
+{
+  if (_count == 0)
+  {
+    return;
+  }
+  pop();
+  _dropped++;
+}
+
+/**
+ * @brief すべてのメッセージを捨てる (統計は変えない)
+ *
+ */
+void MQTTPublishQueue::clear(void)
+{
+  _head = 0;
+  _tail = 0;
+  _count = 0;
+  _deadBytes = 0;
+}
+
+/**
+ * @brief 最大使用量、捨てた数、置き換えた数をクリアする
+ *
+ */
+void MQTTPublishQueue::clearStatistics(void)
+{
+  _highWatermark = getUsed();
+  _dropped = 0;
+  _coalesced = 0;
+}
+
+/* position のメッセージの大きさ */
+size_t MQTTPublishQueue::recordSize(size_t position) const
+{
+  const uint8_t* record = _storage + position;
+  return kHeaderSize + readLength(record + 1) + readLength(record + 3);
+}
+
+/* 送信待ちの同じトピックのメッセージの位置 (なければ _tail) */
+size_t MQTTPublishQueue::find(const char* topic, size_t topicLength) const
+{
+  for (size_t position = _head; position < _tail; position += recordSize(position))
+  {
+    const uint8_t* record = _storage + position;
+    if ((record[0] & kDeadFlag) == 0 && readLength(record + 1) == topicLength &&
+        memcmp(record + kHeaderSize, topic, topicLength) == 0)
+    {
+      return position;
+    }
+  }
+  return _tail;
+}
+
+/* 先頭の置き換えたメッセージを飛ばす */
+void MQTTPublishQueue::skipDead(void)
+{
+  while (_head < _tail && (_storage[_head] & kDeadFlag) != 0)
+  {
+    const size_t size = recordSize(_head);
+    _deadBytes -= size;
+    _head += size;
+  }
+  if (_head == _tail)
+  {
+    _head = 0;
+    _tail = 0;
+  }
+}
+
+/* 送信待ちのメッセージを領域の先頭に詰める */
+void MQTTPublishQueue::compact(void)
+{
+  size_t write = 0;
+  for (size_t position = _head; position < _tail;)
+  {
+    const size_t size = recordSize(position);
+    if ((_storage[position] & kDeadFlag) == 0)
+    {
+      memmove(_storage + write, _storage + position, size);
+      write += size;
+    }
+    position += size;
+  }
+  _head = 0;
+  _tail = write;
+  _deadBytes = 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file MQTTPublishQueue.h
+ * @brief MQTT の送信待ちメッセージを溜めるキュー
+ * @author Tatsuya Miyazaki
+ *
+ * @details トピックとペイロードを固定長の領域に詰めて溜める。String を使わないので
+ * メッセージごとにヒープを確保しない。1 メッセージあたり 5 byte + トピック長 + 1 +
+ * ペイロード長を使う。MQTTClientESP32::enableQueue() で登録すると、publish() は
+ * ここに溜めるだけになり、healthCheck() で接続中にまとめて送る。
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class MQTTPublishQueue
+{
+public:
+  // 空きが足りないときの動作
+  typedef enum
+  {
+    DROP_NEWEST,  // 新しいメッセージを捨てる
+    DROP_OLDEST   // 入るまで古いメッセージから捨てる
+  } overflowPolicyEnum;
+
+  // 同じトピックのメッセージの扱い
+  typedef enum
+  {
+    KEEP_ALL,     // すべて送る
+    LATEST_VALUE  // 送る前に同じトピックのメッセージが来たら新しい方だけを送る
+  } coalesceEnum;
+
+  /**
+   * @brief 送信待ちのメッセージ (次に push() / pop() するまで有効)
+   */
+  struct Message
+  {
+    const char* topic;
+    const uint8_t* payload;
+    size_t length;
+    bool retained;
+  };
+
+  bool push(const char* topic, const uint8_t* payload, size_t length, bool retained = false);
+  bool front(Message& message) const;
+  void pop(void);
+  void drop(void);
+  void clear(void);
+  bool isEmpty(void) const { return _count == 0; }
+  size_t getDepth(void) const { return _count; }
+  size_t getUsed(void) const { return _tail - _head - _deadBytes; }
+  size_t getCapacity(void) const { return _capacity; }
+  size_t getHighWatermark(void) const { return _highWatermark; }
+  uint32_t getDroppedCount(void) const { return _dropped; }
+  uint32_t getCoalescedCount(void) const { return _coalesced; }
+  void clearStatistics(void);
+  overflowPolicyEnum getPolicy(void) const { return _policy; }
+  void setPolicy(overflowPolicyEnum policy) { _policy = policy; }
+  coalesceEnum getCoalesce(void) const { return _coalesce; }
+  void setCoalesce(coalesceEnum coalesce) { _coalesce = coalesce; }
+
+protected:
+  MQTTPublishQueue(uint8_t* storage, size_t capacity, overflowPolicyEnum policy, coalesceEnum coalesce);
+
+private:
+  MQTTPublishQueue(const MQTTPublishQueue&) = delete;
+  MQTTPublishQueue& operator=(const MQTTPublishQueue&) = delete;
+
+  size_t recordSize(size_t position) const;
+  size_t find(const char* topic, size_t topicLength) const;
+  void skipDead(void);
+  void compact(void);
+
+  uint8_t* _storage;
+  size_t _capacity;
+  size_t _head;       // 最も古いメッセージの位置
+  size_t _tail;       // 次に書き込む位置
+  size_t _count;      // 送信待ちのメッセージ数
+  size_t _deadBytes;  // 新しい値で置き換えたメッセージが残っているバイト数
+  overflowPolicyEnum _policy;
+  coalesceEnum _coalesce;
+  size_t _highWatermark;
+  uint32_t _dropped;
+  uint32_t _coalesced;
+};
+
+/**
+ * @brief 領域を持つ送信キュー
+ *
+ * @tparam Capacity 容量 [byte]
+ */
+template <size_t Capacity>
+class MQTTPublishQueueN : public MQTTPublishQueue
+{
+public:
+  explicit MQTTPublishQueueN(overflowPolicyEnum policy = DROP_OLDEST, coalesceEnum coalesce = KEEP_ALL)
+    : MQTTPublishQueue(_area, Capacity, policy, coalesce)
+  {
+  }
+
+private:
+  uint8_t _area[Capacity];
+};
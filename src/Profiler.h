@@ -0,0 +1,346 @@
+/**
+ * @file Profiler.h
+ * @brief メインループの処理時間を区間ごとに計測するプロファイラ
+ * @author Tatsuya Miyazaki
+ *
+ * @details 計測したい区間の先頭に PROFILE_ZONE("名前") を書くと、その区間の
+ * 実行回数・最小・最大・平均時間と、2 のべき乗ごとのヒストグラムを記録する。
+ * 区間の統計は静的変数として確保し、連結リストで登録するのでヒープを使わない
+ * (1 区間あたり約 160 バイト)。
+ *
+ * PROFILER_ENABLED を 1 にしたときだけ有効になる。0 (既定) のときは
+ * PROFILE_ZONE() は何も生成せず、Profiler::dump() / publish() も空になる。
+ *
+ * 時間の取得元は既定では Clock::nowMicros() [us]。ESP32 で
+ * PROFILER_USE_CYCLE_COUNTER を 1 にすると CPU のサイクルカウンタを使う。
+ *
+ * どちらもプロジェクト全体のビルドフラグとして指定する
+ * (例: PlatformIO の build_flags = -DPROFILER_ENABLED=1)。
+ * #include の前に #define すると、その翻訳単位だけが有効になる。
+ * Profiler と ProfileZone は設定ごとに別の inline namespace に置くので、
+ * 設定の違う翻訳単位が混ざっても同じ名前の異なる定義にはならないが、
+ * 無効な翻訳単位の PROFILE_ZONE() は計測されない。
+ *
+ * @code
+ * // build_flags = -DPROFILER_ENABLED=1
+ * #include <Profiler.h>
+ *
+ * void loop() {
+ *   PROFILE_ZONE("loop");
+ *   {
+ *     PROFILE_ZONE("sensor");
+ *     readSensor();
+ *   }
+ *   if (reportTimer.isCycleTime()) {
+ *     Profiler::dump(logger);                     // Log に出力
+ *     Profiler::publish(mqttClient, "profile/");  // profile/<区間名> に JSON を送信
+ *   }
+ * }
+ * @endcode
+ */
+
+#pragma once
+
+#if __has_include(<Arduino.h>)
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Clock.h"
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 0
+#endif
+
+#ifndef PROFILER_USE_CYCLE_COUNTER
+#define PROFILER_USE_CYCLE_COUNTER 0
+#endif
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+/* 設定ごとの名前空間 (例: profiler_config_10 は有効、サイクルカウンタ不使用) */
+#define PROFILER_CONFIG_NAMESPACE \
+  PROFILER_CONCAT(profiler_config_, PROFILER_CONCAT(PROFILER_ENABLED, PROFILER_USE_CYCLE_COUNTER))
+
+/**
+ * @brief 1 つの区間の統計
+ */
+class ProfileZoneStats
+{
+public:
+  /** ヒストグラムの区間数 (i 番目は [2^i, 2^(i+1)) tick、0 tick は 0 番目) */
+  static const uint8_t kBuckets = 32;
+
+  /**
+   * @brief ある時点の統計のコピー
+   */
+  struct Snapshot
+  {
+    /** 区間名 */
+    const char* name;
+    /** 実行回数 */
+    uint32_t count;
+    /** 最小時間 [tick] */
+    uint32_t min;
+    /** 最大時間 [tick] */
+    uint32_t max;
+    /** 合計時間 [tick] */
+    uint64_t total;
+    /** ヒストグラム */
+    uint32_t histogram[kBuckets];
+
+    /* 平均時間 [tick] */
+    uint32_t mean(void) const { return count > 0 ? (uint32_t)(total / count) : 0; }
+  };
+
+  explicit ProfileZoneStats(const char* name) : _name(name), _next(head())
+  {
+    reset();
+    head() = this;
+  }
+
+  ProfileZoneStats(const ProfileZoneStats&) = delete;
+  ProfileZoneStats& operator=(const ProfileZoneStats&) = delete;
+
+  /* 1 回分の時間を記録する */
+  void record(uint32_t ticks)
+  {
+    _stats.count++;
+    _stats.total += ticks;
+    if (ticks < _stats.min)
+      _stats.min = ticks;
+    if (ticks > _stats.max)
+      _stats.max = ticks;
+    _stats.histogram[bucketOf(ticks)]++;
+  }
+
+  /* 統計をクリアする */
+  void reset(void)
+  {
+    _stats.name = _name;
+    _stats.count = 0;
+    _stats.min = 0xFFFFFFFFUL;
+    _stats.max = 0;
+    _stats.total = 0;
+    for (uint8_t i = 0; i < kBuckets; i++)
+    {
+      _stats.histogram[i] = 0;
+    }
+  }
+
+  /* 統計のコピーを返す */
+  Snapshot snapshot(void) const { return _stats; }
+
+  const char* name(void) const { return _name; }
+
+  /* 次に登録された区間 (なければ nullptr) */
+  ProfileZoneStats* next(void) const { return _next; }
+
+  /* 最後に登録された区間 (なければ nullptr) */
+  static ProfileZoneStats* first(void) { return head(); }
+
+  /* 時間が入るヒストグラムの区間 */
+  static uint8_t bucketOf(uint32_t ticks) { return ticks == 0 ? 0 : (uint8_t)(31 - __builtin_clz(ticks)); }
+
+private:
+  static ProfileZoneStats*& head(void)
+  {
+    static ProfileZoneStats* zones = nullptr;
+    return zones;
+  }
+
+  /** 区間名 */
+  const char* _name;
+  /** 次に登録された区間 */
+  ProfileZoneStats* _next;
+  /** 統計 */
+  Snapshot _stats;
+};
+
+inline namespace PROFILER_CONFIG_NAMESPACE
+{
+
+/**
+ * @brief プロファイラの時間の取得元と出力
+ */
+class Profiler
+{
+public:
+  /** 1 行の出力に必要なバッファの大きさ */
+  static const size_t kLineBufferSize = 96 + ProfileZoneStats::kBuckets * 12;
+
+  /* 現在時刻 [tick] */
+  static uint32_t ticks(void)
+  {
+#if PROFILER_USE_CYCLE_COUNTER && defined(ESP32)
+    return ESP.getCycleCount();
+#else
+    return Clock::nowMicros();
+#endif
+  }
+
+  /* 1us あたりの tick 数 */
+  static uint32_t ticksPerMicrosecond(void)
+  {
+#if PROFILER_USE_CYCLE_COUNTER && defined(ESP32)
+    return ESP.getCpuFreqMHz();
+#else
+    return 1;
+#endif
+  }
+
+  /* すべての区間の統計をクリアする */
+  static void resetAll(void)
+  {
+    for (ProfileZoneStats* zone = ProfileZoneStats::first(); zone != nullptr; zone = zone->next())
+    {
+      zone->reset();
+    }
+  }
+
+  /**
+   * @brief 統計を 1 行のテキストにする
+   *
+   * 例: "loop count=1000 min=12us mean=15us max=40us hist=3:10,4:980,5:10"
+   * hist は「log2(tick):回数」の並び (回数 0 の区間は省く)。
+   *
+   * @return size_t 書き込んだ文字数 (バッファが足りなければ切り詰める)
+   */
+  static size_t formatText(const ProfileZoneStats::Snapshot& stats, char* buffer, size_t size)
+  {
+    const uint32_t perMicro = ticksPerMicrosecond();
+    size_t length = append(buffer, size, 0, "%s count=%lu min=%luus mean=%luus max=%luus hist=", stats.name,
+                           (unsigned long)stats.count, (unsigned long)(stats.count > 0 ? stats.min / perMicro : 0),
+                           (unsigned long)(stats.mean() / perMicro), (unsigned long)(stats.max / perMicro));
+    bool first = true;
+    for (uint8_t i = 0; i < ProfileZoneStats::kBuckets; i++)
+    {
+      if (stats.histogram[i] == 0)
+        continue;
+      length = append(buffer, size, length, first ? "%u:%lu" : ",%u:%lu", i, (unsigned long)stats.histogram[i]);
+      first = false;
+    }
+    return length;
+  }
+
+  /**
+   * @brief 統計を JSON にする
+   *
+   * 例: {"zone":"loop","count":1000,"min_us":12,"mean_us":15,"max_us":40,"tick_per_us":1,"hist_log2":[0,0,0,10,980,10]}
+   * hist_log2 は 0 番目から最後の回数 0 でない区間まで。
+   *
+   * @return size_t 書き込んだ文字数 (バッファが足りなければ切り詰める)
+   */
+  static size_t formatJson(const ProfileZoneStats::Snapshot& stats, char* buffer, size_t size)
+  {
+    const uint32_t perMicro = ticksPerMicrosecond();
+    size_t length =
+      append(buffer, size, 0, "{\"zone\":\"%s\",\"count\":%lu,\"min_us\":%lu,\"mean_us\":%lu,\"max_us\":%lu,"
+                              "\"tick_per_us\":%lu,\"hist_log2\":[",
+             stats.name, (unsigned long)stats.count, (unsigned long)(stats.count > 0 ? stats.min / perMicro : 0),
+             (unsigned long)(stats.mean() / perMicro), (unsigned long)(stats.max / perMicro), (unsigned long)perMicro);
+    uint8_t last = 0;
+    for (uint8_t i = 0; i < ProfileZoneStats::kBuckets; i++)
+    {
+      if (stats.histogram[i] != 0)
+        last = i;
+    }
+    for (uint8_t i = 0; i <= last; i++)
+    {
+      length = append(buffer, size, length, i == 0 ? "%lu" : ",%lu", (unsigned long)stats.histogram[i]);
+    }
+    return append(buffer, size, length, "]}");
+  }
+
+  /**
+   * @brief すべての区間の統計を Log に出力する
+   *
+   * @param log 出力先 (info(String) を持つクラス。通常は logger)
+   */
+  template <typename Logger>
+  static void dump(Logger& log)
+  {
+#if PROFILER_ENABLED
+    char line[kLineBufferSize];
+    for (ProfileZoneStats* zone = ProfileZoneStats::first(); zone != nullptr; zone = zone->next())
+    {
+      formatText(zone->snapshot(), line, sizeof(line));
+      log.info(line);
+    }
+#else
+    (void)log;
+#endif
+  }
+
+  /**
+   * @brief すべての区間の統計を JSON で送信する
+   *
+   * @param client 送信先 (publishString(topic, payload) を持つクラス。通常は MQTTClientESP32)
+   * @param topicPrefix トピックの前半。区間名を付けたトピック (63 文字まで) に送る
+   */
+  template <typename Client>
+  static void publish(Client& client, const char* topicPrefix)
+  {
+#if PROFILER_ENABLED
+    char topic[64];
+    char payload[kLineBufferSize];
+    for (ProfileZoneStats* zone = ProfileZoneStats::first(); zone != nullptr; zone = zone->next())
+    {
+      append(topic, sizeof(topic), 0, "%s%s", topicPrefix, zone->name());
+      formatJson(zone->snapshot(), payload, sizeof(payload));
+      client.publishString(topic, payload);
+    }
+#else
+    (void)client;
+    (void)topicPrefix;
+#endif
+  }
+
+private:
+  /* buffer[length] 以降に書式付きで追加する */
+  template <typename... Args>
+  static size_t append(char* buffer, size_t size, size_t length, const char* format, Args... args)
+  {
+    if (length + 1 >= size)
+      return length;
+    const int written = snprintf(buffer + length, size - length, format, args...);
+    if (written < 0)
+      return length;
+    return (size_t)written < size - length ? length + (size_t)written : size - 1;
+  }
+};
+
+/**
+ * @brief 生成から破棄までの時間を区間の統計に記録する
+ */
+class ProfileZone
+{
+public:
+  explicit ProfileZone(ProfileZoneStats& stats) : _stats(stats), _start(Profiler::ticks()) {}
+  ~ProfileZone() { _stats.record(Profiler::ticks() - _start); }
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+  /** 記録先 */
+  ProfileZoneStats& _stats;
+  /** 開始時刻 [tick] */
+  uint32_t _start;
+};
+
+}  // namespace PROFILER_CONFIG_NAMESPACE
+
+#if PROFILER_ENABLED
+/**
+ * @brief ここから囲んでいるブロックの終わりまでを name の区間として計測する
+ */
+#define PROFILE_ZONE(name)                                                    \
+  static ProfileZoneStats PROFILER_CONCAT(profileZoneStats_, __LINE__)(name); \
+  ProfileZone PROFILER_CONCAT(profileZone_, __LINE__)(PROFILER_CONCAT(profileZoneStats_, __LINE__))
+#else
+#define PROFILE_ZONE(name)
+#endif
@@ -0,0 +1,326 @@
+/**
+ * @file Scheduler.cpp
+ * @brief 周期タスク・ワンショットタスクのスケジューラ
+ * @author Tatsuya Miyazaki
+ */
+
+#include "Scheduler.h"
+
+namespace
+{
+
+/** 周期と遅延の最大値 [ms] (符号付きの差で比べられる範囲) */
+const uint32_t kMaxInterval = 0x7FFFFFFFUL;
+/** 識別子のうち領域の番号のビット数 */
+const uint8_t kIndexBits = 7;
+const uint8_t kIndexMask = (1 << kIndexBits) - 1;
+
+uint8_t indexOf(SchedulerBase::TaskId id)
+{
+  return (uint8_t)(id & kIndexMask);
+}
+
+uint8_t generationOf(SchedulerBase::TaskId id)
+{
+  return (uint8_t)(id >> kIndexBits);
+}
+
+uint32_t clampInterval(uint32_t interval)
+{
+  return interval > kMaxInterval ? kMaxInterval : interval;
+}
+
+}  // namespace
+
+/**
+ * @brief Construct a new SchedulerBase:: SchedulerBase object
+ *
+ * @param tasks タスクの領域 (capacity 個)
+ * @param heap 最小ヒープの領域 (capacity 個)
+ * @param capacity 登録できるタスクの数
+ */
+SchedulerBase::SchedulerBase(Task* tasks, uint8_t* heap, uint8_t capacity)
+  : _tasks(tasks), _heap(heap), _capacity(capacity), _count(0), _running(false)
+{
+}
+
+/**
+ * @brief 周期タスクを登録する (最初の実行は period 後)
+ *
+ * @param period 周期[ms]
+ * @param callback 呼び出す関数
+ * @param context 関数に渡す値
+ * @return TaskId タスクの識別子 (空きがなければ kInvalidTask)
+ */
+SchedulerBase::TaskId SchedulerBase::every(uint32_t period, Callback callback, void* context)
+{
+  return every(period, period, callback, context);
+}
+
+/**
+ * @brief 周期タスクを登録する
+ *
+ * @param period 周期[ms] (0 は 1 として扱う)
+ * @param delay 最初の実行までの時間[ms]
+ * @param callback 呼び出す関数
+ * @param context 関数に渡す値
+ * @return TaskId タスクの識別子 (空きがなければ kInvalidTask)
+ */
+SchedulerBase::TaskId SchedulerBase::every(uint32_t period, uint32_t delay, Callback callback, void* context)
+{
+  return add(delay, period > 0 ? period : 1, callback, context);
+}
+
+/**
+ * @brief ワンショットタスクを登録する
+ *
+ * 実行後は自動的に登録が解除される。タスクの中で after(0) で自分を登録し直すと、
+ * 同じ run() の中では呼ばれず、1ms 後以降の run() で呼ばれる。
+ *
+ * @param delay 実行までの時間[ms]
+ * @param callback 呼び出す関数
+ * @param context 関数に渡す値
+ * @return TaskId タスクの識別子 (空きがなければ kInvalidTask)
+ */
+SchedulerBase::TaskId SchedulerBase::after(uint32_t delay, Callback callback, void* context)
+{
+  return add(delay, 0, callback, context);
+}
+
+/**
+ * @brief タスクの登録を解除する
+ *
+ * 実行中のタスクが自分自身を解除してもよい。
+ *
+ * @param id タスクの識別子
+ * @return true 解除した
+ * @return false 登録されていない
+ */
+bool SchedulerBase::cancel(TaskId id)
+{
+  if (!isActive(id))
+    return false;
+  const uint8_t index = indexOf(id);
+  removeAt(_tasks[index].heapIndex);
+  release(index);
+  return true;
+}
+
+/**
+ * @brief タスクが登録されているかを返す
+ *
+ * @param id タスクの識別子
+ * @return true 登録されている
+ * @return false 登録されていない (ワンショットタスクは実行後に false になる。
+ *               解除した後に同じ領域へ別のタスクを登録しても false のまま)
+ */
+bool SchedulerBase::isActive(TaskId id) const
+{
+  if (id < 0 || indexOf(id) >= _capacity)
+    return false;
+  const Task& task = _tasks[indexOf(id)];
+  return task.callback != nullptr && task.generation == generationOf(id);
+}
+
+/**
+ * @brief 周期タスクの周期を変更する
+ *
+ * 次の実行時刻は今から period 後になる。
+ *
+ * @param id タスクの識別子
+ * @param period 周期[ms] (0 は 1 として扱う)
+ * @return true 変更した
+ * @return false 登録されていない
+ */
+bool SchedulerBase::setPeriod(TaskId id, uint32_t period)
+{
+  if (!isActive(id))
+    return false;
+  const uint8_t index = indexOf(id);
+  Task& task = _tasks[index];
+  task.period = clampInterval(period > 0 ? period : 1);
+  task.deadline = Timer::getGlobalTime() + task.period;
+  removeAt(task.heapIndex);
+  task.heapIndex = _count;
+  _heap[_count] = index;
+  _count++;
+  siftUp(task.heapIndex);
+  return true;
+}
+
+/**
+ * @brief すべてのタスクの登録を解除する
+ *
+ */
+void SchedulerBase::clear(void)
+{
+  for (uint8_t i = 0; i < _capacity; i++)
+  {
+    if (_tasks[i].callback != nullptr)
+      release(i);
+  }
+  _count = 0;
+}
+
+/**
+ * @brief 実行時刻が来たタスクを実行時刻の早い順に呼び出す
+ *
+ * メインループから呼ぶ。実行時刻が来ていないタスクには何もしない。
+ * 呼び出したタスクの中で登録したタスクは、遅延が 0 でも次の run() まで呼ばない。
+ *
+ * @return uint32_t 次の実行時刻までの時間[ms] (タスクがなければ kNoDeadline)
+ */
+uint32_t SchedulerBase::run(void)
+{
+  const uint32_t now = Timer::getGlobalTime();
+  const bool running = _running;
+  _running = true;
+  while (_count > 0)
+  {
+    const uint8_t index = _heap[0];
+    Task& task = _tasks[index];
+    if ((int32_t)(task.deadline - now) > 0)
+      break;
+
+    // 呼び出す前に次の実行時刻を決めておくので、関数の中で登録や解除をしてもよい
+    const Callback callback = task.callback;
+    void* const context = task.context;
+    if (task.period == 0)
+    {
+      removeAt(0);
+      release(index);
+    }
+    else
+    {
+      // 間に合わなかった回は飛ばし、位相を保ったまま次の予定時刻に進める
+      const uint32_t missed = (now - task.deadline) / task.period;
+      task.deadline += (missed + 1) * task.period;
+      siftDown(0);
+    }
+    callback(context);
+  }
+  _running = running;
+  return idleTime();
+}
+
+/**
+ * @brief 次の実行時刻までの時間を返す
+ *
+ * @return uint32_t 次の実行時刻までの時間[ms] (過ぎていれば 0、タスクがなければ kNoDeadline)
+ */
+uint32_t SchedulerBase::idleTime(void) const
+{
+  if (_count == 0)
+    return kNoDeadline;
+  const int32_t remaining = (int32_t)(_tasks[_heap[0]].deadline - Timer::getGlobalTime());
+  return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+/**
+ * @brief 登録中のタスクの数を返す
+ *
+ * @return uint8_t タスクの数
+ */
+uint8_t SchedulerBase::taskCount(void) const
+{
+  return _count;
+}
+
+/**
+ * @brief 登録できるタスクの数を返す
+ *
+ * @return uint8_t タスクの数
+ */
+uint8_t SchedulerBase::capacity(void) const
+{
+  return _capacity;
+}
+
+/* 空いている領域にタスクを登録する */
+SchedulerBase::TaskId SchedulerBase::add(uint32_t delay, uint32_t period, Callback callback, void* context)
+{
+  if (callback == nullptr)
+    return kInvalidTask;
+  for (uint8_t i = 0; i < _capacity; i++)
+  {
+    Task& task = _tasks[i];
+    if (task.callback != nullptr)
+      continue;
+    task.callback = callback;
+    task.context = context;
+    task.period = clampInterval(period);
+    // run() の中で登録したタスクが同じ run() で呼ばれ続けないように、実行時刻を 1ms 以上先にする
+    const uint32_t wait = (_running && delay == 0) ? 1 : clampInterval(delay);
+    task.deadline = Timer::getGlobalTime() + wait;
+    task.heapIndex = _count;
+    _heap[_count] = i;
+    _count++;
+    siftUp(task.heapIndex);
+    return (TaskId)((task.generation << kIndexBits) | i);
+  }
+  return kInvalidTask;
+}
+
+/* 領域 index を空きにし、古い識別子が使えないように世代を進める */
+void SchedulerBase::release(uint8_t index)
+{
+  _tasks[index].callback = nullptr;
+  _tasks[index].generation++;
+}
+
+/* ヒープの位置 a のタスクが位置 b のタスクより先に実行されるか */
+bool SchedulerBase::isBefore(uint8_t a, uint8_t b) const
+{
+  return (int32_t)(_tasks[_heap[a]].deadline - _tasks[_heap[b]].deadline) < 0;
+}
+
+/* ヒープの位置 a と b を入れ替える */
+void SchedulerBase::swap(uint8_t a, uint8_t b)
+{
+  const uint8_t temp = _heap[a];
+  _heap[a] = _heap[b];
+  _heap[b] = temp;
+  _tasks[_heap[a]].heapIndex = a;
+  _tasks[_heap[b]].heapIndex = b;
+}
+
+/* 位置 position のタスクを根の方へ移動する */
+void SchedulerBase::siftUp(uint8_t position)
+{
+  while (position > 0)
+  {
+    const uint8_t parent = (uint8_t)((position - 1) / 2);
+    if (!isBefore(position, parent))
+      break;
+    swap(position, parent);
+    position = parent;
+  }
+}
+
+/* 位置 position のタスクを葉の方へ移動する */
+void SchedulerBase::siftDown(uint8_t position)
+{
+  for (;;)
+  {
+    const uint8_t left = (uint8_t)(position * 2 + 1);
+    if (left >= _count)
+      break;
+    const uint8_t right = (uint8_t)(left + 1);
+    const uint8_t child = (right < _count && isBefore(right, left)) ? right : left;
+    if (!isBefore(child, position))
+      break;
+    swap(position, child);
+    position = child;
+  }
+}
+
+/* ヒープの位置 position のタスクを取り除く */
+void SchedulerBase::removeAt(uint8_t position)
+{
+  _count--;
+  if (position == _count)
+    return;
+  swap(position, _count);
+  siftDown(position);
+  siftUp(position);
+}
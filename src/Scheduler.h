@@ -0,0 +1,145 @@
+/**
+ * @file Scheduler.h
+ * @brief 周期タスク・ワンショットタスクのスケジューラ
+ * @author Tatsuya Miyazaki
+ *
+ * @details 登録したタスクを次の実行時刻の最小ヒープで管理し、run() で
+ * 実行時刻が来たタスクだけを呼び出す。タスクごとに Timer::isCycleTime() を
+ * ポーリングする必要がなく、次の実行時刻までの待ち時間もわかるので、
+ * メインループでスリープしたり他の処理に譲ったりできる。
+ *
+ * 実行時刻は符号付きの差で比べるので、millis() が一周しても動作する
+ * (周期と遅延は 2^31 - 1 [ms] まで)。
+ *
+ * 周期タスクは「前回の実行予定時刻 + 周期」で次の実行時刻を決めるため、
+ * 呼び出しが遅れても位相がずれない。周期より大きく遅れた場合は、
+ * 間に合わなかった回を飛ばして次の予定時刻に合わせる。
+ *
+ * タスクの領域は Scheduler<Capacity> が持ち、ヒープは使わない。
+ * 時刻はすべて Timer::getGlobalTime() [ms] (Clock::nowMillis()) を使う。
+ */
+
+#pragma once
+
+#if __has_include(<Arduino.h>)
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+/**
+ * @brief スケジューラの本体 (タスクの領域は Scheduler<Capacity> が持つ)
+ */
+class SchedulerBase
+{
+public:
+  /** タスクとして呼び出す関数 */
+  typedef void (*Callback)(void* context);
+  /**
+   * タスクの識別子 (下位 7 ビットが領域の番号、その上の 8 ビットが世代)
+   *
+   * 領域を使い回すたびに世代を進めるので、解除済みのタスクの識別子で
+   * 同じ領域に後から登録したタスクを操作してしまうことはない
+   * (同じ領域を 256 回使い回すと世代が一周する)。
+   */
+  typedef int16_t TaskId;
+  /** 登録に失敗したときの識別子 */
+  static const TaskId kInvalidTask = -1;
+  /** 実行待ちのタスクがないときの待ち時間 */
+  static const uint32_t kNoDeadline = 0xFFFFFFFFUL;
+
+  /**
+   * @brief タスクの領域
+   */
+  struct Task
+  {
+    /** 呼び出す関数 (nullptr なら空き) */
+    Callback callback;
+    /** 関数に渡す値 */
+    void* context;
+    /** 次の実行時刻 [ms] */
+    uint32_t deadline;
+    /** 周期 [ms] (0 ならワンショット) */
+    uint32_t period;
+    /** 最小ヒープ内の位置 */
+    uint8_t heapIndex;
+    /** 世代 (登録を解除するたびに進める) */
+    uint8_t generation;
+  };
+
+  SchedulerBase(const SchedulerBase&) = delete;
+  SchedulerBase& operator=(const SchedulerBase&) = delete;
+
+  TaskId every(uint32_t period, Callback callback, void* context = nullptr);
+  TaskId every(uint32_t period, uint32_t delay, Callback callback, void* context = nullptr);
+  TaskId after(uint32_t delay, Callback callback, void* context = nullptr);
+  bool cancel(TaskId id);
+  bool isActive(TaskId id) const;
+  bool setPeriod(TaskId id, uint32_t period);
+  void clear(void);
+  uint32_t run(void);
+  uint32_t idleTime(void) const;
+  uint8_t taskCount(void) const;
+  uint8_t capacity(void) const;
+
+protected:
+  SchedulerBase(Task* tasks, uint8_t* heap, uint8_t capacity);
+
+private:
+  TaskId add(uint32_t delay, uint32_t period, Callback callback, void* context);
+  void release(uint8_t index);
+  bool isBefore(uint8_t a, uint8_t b) const;
+  void swap(uint8_t a, uint8_t b);
+  void siftUp(uint8_t position);
+  void siftDown(uint8_t position);
+  void removeAt(uint8_t position);
+
+  /** タスクの領域 */
+  Task* _tasks;
+  /** 実行時刻順の最小ヒープ (タスクの番号) */
+  uint8_t* _heap;
+  /** 登録できるタスクの数 */
+  uint8_t _capacity;
+  /** 登録中のタスクの数 */
+  uint8_t _count;
+  /** run() でタスクを呼び出している間 */
+  bool _running;
+};
+
+/**
+ * @brief 周期タスク・ワンショットタスクのスケジューラ
+ *
+ * @tparam Capacity 登録できるタスクの数 (最大 127)
+ *
+ * @code
+ * Scheduler<8> scheduler;
+ *
+ * void blink(void*) { digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN)); }
+ *
+ * void setup() { scheduler.every(500, blink); }
+ *
+ * void loop() {
+ *   uint32_t idle = scheduler.run();
+ *   delay(min(idle, (uint32_t)10));  // 次の実行時刻まで休む
+ * }
+ * @endcode
+ */
+template <uint8_t Capacity>
+class Scheduler : public SchedulerBase
+{
+  static_assert(Capacity > 0 && Capacity <= 127, "capacity must be 1..127");
+
+public:
+  Scheduler() : SchedulerBase(_taskStorage, _heapStorage, Capacity), _taskStorage()
+  {
+    clear();
+  }
+
+private:
+  /** タスクの領域 */
+  Task _taskStorage[Capacity];
+  /** 最小ヒープの領域 */
+  uint8_t _heapStorage[Capacity];
+};
@@ -5,6 +5,8 @@
 
 #include "TimedPatternPlayer.h"
 
+#include "Clock.h"
+
 /**
  * @brief パターン未設定・停止状態で初期化する
  */
@@ -68,7 +70,7 @@ bool TimedPatternPlayer::update() {
     return false;
   }
 
-  if (millis() - _stepStartedAt < _steps[_index].durationMs) {
+  if (Clock::nowMillis() - _stepStartedAt < _steps[_index].durationMs) {
     return true;
   }
 
@@ -103,7 +105,7 @@ TimedPatternPlayer::Pattern TimedPatternPlayer::capturePlayback() const {
 }
 
 void TimedPatternPlayer::startCurrentStep() {
-  _stepStartedAt = millis();
+  _stepStartedAt = Clock::nowMillis();
   applyOutput(_steps[_index].output);
 }
 
@@ -7,31 +7,83 @@
  * @details 時間を計測したり、周期トリガを生成するクラス
  */
 
-#include <Arduino.h>
-
 #include "Timer.h"
 
 /**
  * @brief Construct a new Timer:: Timer object
  *
  */
-Timer::Timer() : startTime(millis()), stopTime(millis()), pastTime(0), cycleTime(0) {}
+Timer::Timer()
+  : startTime(Clock::nowMillis()),
+    stopTime(Clock::nowMillis()),
+    pastTime(0),
+    cycleTime(0),
+    period(0),
+    deadline(Clock::nowMillis()),
+    missedCycles(0),
+    totalMissedCycles(0),
+    lateness(0),
+    maxLateness(0),
+    resolution(MILLIS)
+{
+}
 
 /**
  * @brief Construct a new Timer:: Timer object
  *
  * @param time 周期[ms]
  */
-Timer::Timer(uint16_t time) : startTime(millis()), stopTime(millis()), pastTime(0), cycleTime(time) {}
+Timer::Timer(uint16_t time)
+  : startTime(Clock::nowMillis()),
+    stopTime(Clock::nowMillis()),
+    pastTime(0),
+    cycleTime(time),
+    period(time),
+    deadline(Clock::nowMillis() + time),
+    missedCycles(0),
+    totalMissedCycles(0),
+    lateness(0),
+    maxLateness(0),
+    resolution(MILLIS)
+{
+}
+
+/**
+ * @brief Construct a new Timer:: Timer object
+ *
+ * isDeadline() の周期と時間の単位を指定する。
+ *
+ * @param time 周期[resolution の単位]
+ * @param timeResolution 時間の単位 (MILLIS / MICROS)
+ */
+Timer::Timer(uint32_t time, Resolution timeResolution)
+  : startTime(Clock::nowMillis()),
+    stopTime(Clock::nowMillis()),
+    pastTime(0),
+    cycleTime(0),
+    period(0),
+    deadline(0),
+    missedCycles(0),
+    totalMissedCycles(0),
+    lateness(0),
+    maxLateness(0),
+    resolution(timeResolution)
+{
+  setPeriod(time, timeResolution);
+}
 
 /**
  * @brief 周期を設定する
  *
+ * Timer(uint16_t) と同じく、isDeadline() の周期も time [ms] にして、
+ * 次の実行時刻を今から 1 周期後にする。
+ *
  * @param time 周期[ms]
  */
 void Timer::setCycleTime(uint16_t time)
 {
   cycleTime = time;
+  setPeriod(time, MILLIS);
 }
 
 /**
@@ -52,7 +104,7 @@ uint16_t Timer::getCycleTime(void)
  */
 bool Timer::isCycleTime(void)
 {
-  uint32_t temp = millis() / (uint32_t)cycleTime;
+  uint32_t temp = Clock::nowMillis() / (uint32_t)cycleTime;
   uint32_t returnData = temp - pastTime;
   pastTime = temp;
   return (returnData > 0);
@@ -64,7 +116,7 @@ bool Timer::isCycleTime(void)
  */
 void Timer::startTimer(void)
 {
-  startTime = millis();
+  startTime = Clock::nowMillis();
   stopTime = 0;
 }
 
@@ -75,7 +127,7 @@ void Timer::startTimer(void)
 void Timer::stopTimer(void)
 {
   if (stopTime == 0)
-    stopTime = millis();
+    stopTime = Clock::nowMillis();
 }
 
 /**
@@ -86,7 +138,149 @@ void Timer::stopTimer(void)
 uint32_t Timer::getTime(void)
 {
   if (stopTime == 0)
-    return millis() - startTime;
+    return Clock::nowMillis() - startTime;
   else
     return stopTime - startTime;
 }
+
+/**
+ * @brief isDeadline() の周期を設定し、次の実行時刻を今から 1 周期後にする
+ *
+ * @param time 周期[resolution の単位] (2^31 未満)
+ * @param newResolution 時間の単位 (MILLIS / MICROS)
+ */
+void Timer::setPeriod(uint32_t time, Resolution newResolution)
+{
+  resolution = newResolution;
+  period = time;
+  resetDeadline();
+}
+
+/**
+ * @brief isDeadline() の周期を取得する
+ *
+ * @return uint32_t 周期[resolution の単位]
+ */
+uint32_t Timer::getPeriod(void) const
+{
+  return period;
+}
+
+/**
+ * @brief isDeadline() の時間の単位を取得する
+ *
+ * @return Resolution 時間の単位
+ */
+Timer::Resolution Timer::getResolution(void) const
+{
+  return resolution;
+}
+
+/**
+ * @brief 次の実行時刻を過ぎたかを調べ、過ぎていれば次の実行時刻を 1 周期進める
+ *
+ * 次の実行時刻は「前回の実行時刻 + 周期」なので、呼び出しが遅れても
+ * 周期の位相はずれない。1 周期以上遅れた場合は間に合わなかった周期を飛ばし、
+ * その数を getMissedCycles() で返す。
+ *
+ * 実行時刻前なら残り時間は必ず周期以下なので、それを超える差は遅れとして扱う。
+ * このため 2^32 - 周期 [resolution の単位] (MICROS で約 71 分、MILLIS で約 49 日)
+ * より長く呼ばなかった場合だけ、遅れを正しく数えられない。
+ *
+ * @return true 実行時刻を過ぎた
+ * @return false 実行時刻前
+ */
+bool Timer::isDeadline(void)
+{
+  const uint32_t current = now();
+  const uint32_t remaining = deadline - current;
+  if (remaining != 0 && remaining <= period)
+    return false;
+
+  const uint32_t late = current - deadline;
+  missedCycles = period > 0 ? late / period : 0;
+  totalMissedCycles += missedCycles;
+  lateness = late;
+  if (lateness > maxLateness)
+    maxLateness = lateness;
+  deadline += (missedCycles + 1) * period;
+  return true;
+}
+
+/**
+ * @brief 次の実行時刻を今から 1 周期後にする
+ *
+ */
+void Timer::resetDeadline(void)
+{
+  deadline = now() + period;
+}
+
+/**
+ * @brief 次の実行時刻までの時間を取得する
+ *
+ * @return uint32_t 次の実行時刻までの時間[resolution の単位] (過ぎていれば 0)
+ */
+uint32_t Timer::getTimeToDeadline(void) const
+{
+  const uint32_t remaining = deadline - now();
+  return remaining <= period ? remaining : 0;
+}
+
+/**
+ * @brief 直前に真を返した isDeadline() で飛ばした周期の数を取得する
+ *
+ * @return uint32_t 周期の数 (間に合っていれば 0)
+ */
+uint32_t Timer::getMissedCycles(void) const
+{
+  return missedCycles;
+}
+
+/**
+ * @brief 飛ばした周期の数の合計を取得する
+ *
+ * @return uint32_t 周期の数
+ */
+uint32_t Timer::getTotalMissedCycles(void) const
+{
+  return totalMissedCycles;
+}
+
+/**
+ * @brief 直前に真を返した isDeadline() の、実行時刻からの遅れを取得する
+ *
+ * @return uint32_t 遅れ[resolution の単位]
+ */
+uint32_t Timer::getLateness(void) const
+{
+  return lateness;
+}
+
+/**
+ * @brief 遅れの最大値を取得する
+ *
+ * @return uint32_t 遅れ[resolution の単位]
+ */
+uint32_t Timer::getMaxLateness(void) const
+{
+  return maxLateness;
+}
+
+/**
+ * @brief 飛ばした周期の数と遅れの記録をクリアする
+ *
+ */
+void Timer::clearStatistics(void)
+{
+  missedCycles = 0;
+  totalMissedCycles = 0;
+  lateness = 0;
+  maxLateness = 0;
+}
+
+/* isDeadline() の単位での現在時刻 */
+uint32_t Timer::now(void) const
+{
+  return resolution == MICROS ? Clock::nowMicros() : Clock::nowMillis();
+}
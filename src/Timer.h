@@ -5,26 +5,78 @@
  * @date 2020/6/28
  *
  * @details 時間を計測したり、周期トリガを生成するクラス
+ *
+ * 周期トリガは 2 種類ある。
+ *   - isCycleTime() : millis() を周期で割った値が変わったら真 (周期は 16 ビット [ms])
+ *   - isDeadline()  : 次の実行時刻を「前回の実行時刻 + 周期」で追跡し、時刻を過ぎたら真。
+ *                     位相がずれず、micros() を使う高分解能モードと 32 ビットの周期に対応する。
+ *                     間に合わなかった周期の数と遅れ時間も記録する。
+ *                     2^32 - 周期 (MICROS で約 71 分) より長く呼ばないと遅れを数えられない。
+ *
+ * @code
+ * Timer control(1000, Timer::MICROS);  // 1kHz の制御周期
+ *
+ * void loop() {
+ *   if (control.isDeadline()) {
+ *     controlStep();
+ *     if (control.getMissedCycles() > 0) {
+ *       // 周期に間に合わなかった
+ *     }
+ *   }
+ * }
+ * @endcode
+ *
+ * 時刻は Clock::nowMillis() / Clock::nowMicros() から取得する。
  */
 
 #pragma once
 
+#if __has_include(<Arduino.h>)
 #include <Arduino.h>
+#endif
+
+#include <stdint.h>
+
+#include "Clock.h"
 
 class Timer
 {
 public:
+  /** isDeadline() の時間の単位 */
+  enum Resolution
+  {
+    /** millis() [ms] */
+    MILLIS,
+    /** micros() [us] */
+    MICROS
+  };
+
   Timer();
   explicit Timer(uint16_t);
+  Timer(uint32_t, Resolution);
   void setCycleTime(uint16_t);
   uint16_t getCycleTime(void);
   bool isCycleTime(void);
+  void setPeriod(uint32_t, Resolution resolution = MILLIS);
+  uint32_t getPeriod(void) const;
+  Resolution getResolution(void) const;
+  bool isDeadline(void);
+  void resetDeadline(void);
+  uint32_t getTimeToDeadline(void) const;
+  uint32_t getMissedCycles(void) const;
+  uint32_t getTotalMissedCycles(void) const;
+  uint32_t getLateness(void) const;
+  uint32_t getMaxLateness(void) const;
+  void clearStatistics(void);
   void startTimer(void);
   void stopTimer(void);
   uint32_t getTime(void);
-  static uint32_t getGlobalTime(void) { return (millis()); }
+  static uint32_t getGlobalTime(void) { return (Clock::nowMillis()); }
+  static uint32_t getGlobalTimeMicros(void) { return (Clock::nowMicros()); }
 
 private:
+  uint32_t now(void) const;
+
   /** 開始したときの時刻[ms] */
   uint32_t startTime;
   /** 停止したときの時刻[ms] */
@@ -33,4 +85,18 @@ private:
   uint32_t pastTime;
   /** チェックする周期[ms] */
   uint16_t cycleTime;
+  /** isDeadline() の周期 [resolution の単位] */
+  uint32_t period;
+  /** 次の実行時刻 [resolution の単位] */
+  uint32_t deadline;
+  /** 直前の isDeadline() で間に合わなかった周期の数 */
+  uint32_t missedCycles;
+  /** 間に合わなかった周期の数の合計 */
+  uint32_t totalMissedCycles;
+  /** 直前の isDeadline() の遅れ [resolution の単位] */
+  uint32_t lateness;
+  /** 遅れの最大値 [resolution の単位] */
+  uint32_t maxLateness;
+  /** isDeadline() の時間の単位 */
+  Resolution resolution;
 };
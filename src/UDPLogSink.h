@@ -0,0 +1,69 @@
+/**
+ * @file UDPLogSink.h
+ * @brief ログを UDP で syslog 形式の行として送る出力先
+ *
+ * @details 各行の前に "<PRI>ホスト名: " (RFC 3164 の facility local0) を付け、
+ * 行をまとめて 1 つのデータグラムで送る (行は '\n' で区切る)。
+ * 送るのは Log::drain() / flush() の中か、LOG_BATCH_SIZE がいっぱいになったときなので、
+ * ログを出すたびにネットワークを待たない。
+ * 送るクライアントはメインループと共有するので、Log::startDrainTask() とは一緒に使えない
+ * (addSink() / startDrainTask() が false を返す)。非同期モードでは logger.drain() を
+ * メインループから呼ぶ。
+ *
+ * @code
+ * UDPClientESP32 udp("192.168.0.10", 514, 5140);
+ * UDPLogSink udpLog(udp, "node1", 1000, Log::INFO);
+ *
+ * void setup() {
+ *   udp.begin();
+ *   logger.addSink(udpLog);
+ * }
+ *
+ * void loop() {
+ *   logger.drain();  // 非同期モードでなくても、溜めた行を 1 秒ごとに送る
+ * }
+ * @endcode
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include "Log.h"
+#include "UDPClientESP32.h"
+
+class UDPLogSink : public BatchLogSink {
+ public:
+  /**
+   * @param client 送信に使う UDP クライアント
+   * @param hostname 行に付けるホスト名 (nullptr なら付けない)
+   * @param intervalMs 最初の行を溜めてから送るまでの時間 [ms]
+   * @param level 出力するログレベル
+   */
+  explicit UDPLogSink(UDPClientESP32& client, const char* hostname = nullptr, uint32_t intervalMs = 1000,
+                      uint8_t level = 0)
+      : BatchLogSink(intervalMs, level), m_client(client), m_hostname(hostname) {}
+
+ protected:
+  bool send(const uint8_t* data, size_t length) override { return m_client.send(data, length); }
+
+  size_t formatPrefix(const LogRecord& record, uint8_t* buffer, size_t size) override {
+    if (record.binary) {
+      return 0;
+    }
+    // facility local0 (16) と Log のレベルに対応する severity
+    static const uint8_t kSeverity[] = {7, 7, 6, 4, 3, 7};
+    const uint8_t severity = record.level < sizeof(kSeverity) ? kSeverity[record.level] : 7;
+    const int written = (m_hostname != nullptr)
+                            ? snprintf((char*)buffer, size, "<%u>%s: ", 16 * 8 + severity, m_hostname)
+                            : snprintf((char*)buffer, size, "<%u>", 16 * 8 + severity);
+    if (written < 0) {
+      return 0;
+    }
+    return ((size_t)written < size) ? (size_t)written : size - 1;
+  }
+
+ private:
+  UDPClientESP32& m_client;
+  const char* m_hostname;
+};
@@ -10,7 +10,11 @@
 /***********************************************************************/
 #pragma once
 
+#if __has_include(<Arduino.h>)
 #include <Arduino.h>
+#else
+#include <stdint.h>
+#endif
 
 typedef int32_t fix;
 
@@ -38,6 +42,7 @@ typedef int32_t fix;
 /* 固定小数点数の割り算(int64_t でキャスト) */
 #define FIX_DIV(fx1, fx2) ((fix)((((int64_t)(fx1)) << FIX_SHIFT_BIT) / ((int64_t)(fx2))))
 /* 固定小数点数の掛け算(精度落ちるが速い) */
+/* 下位 8bit を捨てるため誤差が大きい。丸めと飽和が必要な場合は Fixed.hpp の FixQ16 を使う */
 #define FIX_MUL2(fx1, fx2) (((fx1) >> (FIX_SHIFT_BIT >> 1)) * ((fx2) >> (FIX_SHIFT_BIT >> 1)))
 /* 固定小数点数の割り算(精度落ちるが速い) */
 #define FIX_DIV2(fx1, fx2) (((fx1) << (FIX_SHIFT_BIT >> 1)) / ((fx2) >> (FIX_SHIFT_BIT >> 1)))
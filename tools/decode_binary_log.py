@@ -0,0 +1,301 @@
+#!/usr/bin/env python3
+"""Decode the binary log stream written by Log::setBinary(true) back into text.
+
+The format-string table is rebuilt from the sources: every LOG_xxxF() /
+LOG_PRINTF() call is scanned and its format string hashed with the same
+FNV-1a 32-bit function as logFormatHash() in src/Log.h.
+
+Bytes that are not part of a binary record (boot messages, text logs) are
+passed through unchanged. The tag bytes (0xA0-0xA4, 0xAF) also occur inside
+UTF-8 text, so a record is only accepted when its format ID is known, and a
+sync record only when a record (or another sync) follows it and its time does
+not go backwards.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import re
+import struct
+import sys
+from pathlib import Path
+
+
+RECORD_TAG = 0xA0
+SYNC_TAG = 0xAF
+TEXT_FORMAT_ID = 0
+TOO_LONG_FORMAT_ID = 1
+LEVEL_NAMES = {0: "", 1: "DEBUG", 2: "INFO", 3: "WARN", 4: "ERROR"}
+SOURCE_SUFFIXES = {".c", ".cc", ".cpp", ".h", ".hpp", ".ino"}
+
+CALL_PATTERN = re.compile(
+    r"\bLOG_(?:DEBUG|INFO|WARN|ERROR)F\s*\(\s*"
+    r"|\bLOG_PRINTF\s*\([^,()]*(?:\([^()]*\)[^,()]*)*,\s*"
+)
+LITERAL_PATTERN = re.compile(r'\s*"((?:[^"\\\n]|\\.)*)"')
+CONVERSION_PATTERN = re.compile(
+    r"%(?P<flags>[-+ #0]*)(?P<width>\*|\d+)?(?:\.(?P<precision>\*|\d+))?"
+    r"(?P<length>hh|h|ll|l|j|z|t|L)?(?P<conversion>[diouxXcsfFeEgGaAp%])"
+)
+SIMPLE_ESCAPES = {
+    "n": b"\n", "t": b"\t", "r": b"\r", "0": b"\0", "\\": b"\\", '"': b'"', "'": b"'",
+    "a": b"\a", "b": b"\b", "f": b"\f", "v": b"\v", "?": b"?",
+}
+
+
+def fnv1a(data: bytes) -> int:
+    value = 2166136261
+    for byte in data:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def unescape(literal: str) -> bytes:
+    out = bytearray()
+    i = 0
+    while i < len(literal):
+        ch = literal[i]
+        if ch != "\\":
+            out += ch.encode("utf-8")
+            i += 1
+            continue
+        nxt = literal[i + 1]
+        if nxt == "x":
+            match = re.match(r"[0-9a-fA-F]+", literal[i + 2:])
+            out.append(int(match.group(0), 16) & 0xFF)
+            i += 2 + len(match.group(0))
+        elif nxt in "01234567":
+            match = re.match(r"[0-7]{1,3}", literal[i + 1:])
+            out.append(int(match.group(0), 8) & 0xFF)
+            i += 1 + len(match.group(0))
+        else:
+            out += SIMPLE_ESCAPES.get(nxt, nxt.encode("utf-8"))
+            i += 2
+    return bytes(out)
+
+
+def scan_sources(paths: list[Path]) -> dict[int, str]:
+    table: dict[int, str] = {TEXT_FORMAT_ID: "%s"}
+    files: list[Path] = []
+    for path in paths:
+        if path.is_dir():
+            files.extend(p for p in sorted(path.rglob("*")) if p.suffix in SOURCE_SUFFIXES)
+        elif path.exists():
+            files.append(path)
+    for file in files:
+        text = file.read_text(encoding="utf-8", errors="replace")
+        for call in CALL_PATTERN.finditer(text):
+            position = call.end()
+            data = b""
+            while True:
+                literal = LITERAL_PATTERN.match(text, position)
+                if literal is None:
+                    break
+                data += unescape(literal.group(1))
+                position = literal.end()
+            if position == call.end():
+                continue
+            fmt = data.decode("utf-8", errors="replace")
+            previous = table.setdefault(fnv1a(data), fmt)
+            if previous != fmt:
+                print(f"warning: hash collision: {previous!r} / {fmt!r}", file=sys.stderr)
+    return table
+
+
+class Reader:
+    def __init__(self, data: bytes, position: int = 0) -> None:
+        self.data = data
+        self.position = position
+
+    def byte(self) -> int:
+        if self.position >= len(self.data):
+            raise EOFError
+        value = self.data[self.position]
+        self.position += 1
+        return value
+
+    def bytes(self, length: int) -> bytes:
+        if self.position + length > len(self.data):
+            raise EOFError
+        value = self.data[self.position:self.position + length]
+        self.position += length
+        return value
+
+    def varint(self) -> int:
+        value = 0
+        for shift in range(0, 70, 7):
+            byte = self.byte()
+            value |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                return value
+        raise ValueError("varint too long")
+
+    def signed(self) -> int:
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def float32(self) -> float:
+        return struct.unpack("<f", self.bytes(4))[0]
+
+    def string(self) -> str:
+        return self.bytes(self.varint()).decode("utf-8", errors="replace")
+
+
+def render(fmt: str, args: Reader) -> str:
+    """Format fmt like printf, reading each argument from args."""
+
+    def convert(match: re.Match[str]) -> str:
+        conversion = match.group("conversion")
+        if conversion == "%":
+            return "%"
+        width = match.group("width")
+        precision = match.group("precision")
+        if width == "*":
+            width = str(args.signed())
+        if precision == "*":
+            precision = str(args.signed())
+        spec = "%" + match.group("flags") + (width or "") + ("." + precision if precision is not None else "")
+        length = match.group("length")
+        if conversion in "fFeEgGaA":
+            value = args.float32()
+            return (spec + ("e" if conversion in "aA" else conversion)) % value
+        if conversion == "s":
+            return (spec + "s") % args.string()
+        value = args.signed()
+        if conversion == "c":
+            return (spec + "c") % chr(value & 0xFF)
+        if conversion == "p":
+            return "0x%x" % (value & 0xFFFFFFFFFFFFFFFF)
+        if conversion in "ouxX":
+            bits = 64 if length in ("ll", "j") else 16 if length == "h" else 8 if length == "hh" else 32
+            value &= (1 << bits) - 1
+            return (spec + ("d" if conversion == "u" else conversion)) % value
+        return (spec + "d") % value
+
+    return CONVERSION_PATTERN.sub(convert, fmt)
+
+
+def parse_record(data: bytes, position: int, table: dict[int, str], accept_unknown: bool) -> tuple[int, int, str, bool]:
+    """Parse the record at position and return (end, delta, message, unknown).
+
+    Raises EOFError / ValueError (or a struct/format error) if the bytes there are not a complete record.
+    """
+    tag = data[position]
+    if not RECORD_TAG <= tag <= RECORD_TAG + 4:
+        raise ValueError("not a record tag")
+    reader = Reader(data, position + 1)
+    delta = reader.signed()
+    format_id = struct.unpack("<I", reader.bytes(4))[0]
+    args = Reader(reader.bytes(reader.varint()))
+    unknown = False
+    if format_id == TOO_LONG_FORMAT_ID:
+        original = args.signed() & 0xFFFFFFFF
+        message = f"(arguments too long: {table.get(original, hex(original))!r})"
+    elif format_id in table:
+        message = render(table[format_id], args)
+    elif accept_unknown:
+        unknown = True
+        message = f"(unknown format 0x{format_id:08x}: {args.data.hex()})"
+    else:
+        raise ValueError("unknown format")
+    return reader.position, delta, message, unknown
+
+
+def parse_sync(data: bytes, position: int, table: dict[int, str], accept_unknown: bool) -> tuple[int, int]:
+    """Parse the sync record at position and return (end, time).
+
+    The device writes a sync right before a record; a sink whose level filters that record
+    sees the next sync instead. Anything else means the 0xAF byte was part of plain text.
+    """
+    end = position + 5
+    time = struct.unpack("<I", Reader(data, position + 1).bytes(4))[0]
+    following = end
+    while following < len(data) and data[following] == SYNC_TAG:
+        following += 5
+    parse_record(data, following, table, accept_unknown)
+    return end, time
+
+
+def decode(data: bytes, table: dict[int, str], accept_unknown: bool, out) -> dict[str, int]:
+    stats = {"records": 0, "unknown": 0, "text_bytes": 0}
+    # absolute time of the last sync record; each record carries its offset from it
+    sync: int | None = None
+    text = bytearray()
+    position = 0
+
+    def flush_text() -> None:
+        if text:
+            out.write(text.decode("utf-8", errors="replace"))
+            stats["text_bytes"] += len(text)
+            text.clear()
+
+    while position < len(data):
+        tag = data[position]
+        try:
+            if tag == SYNC_TAG:
+                end, time = parse_sync(data, position, table, accept_unknown)
+                if sync is not None and (time - sync) & 0xFFFFFFFF >= 0x80000000:
+                    raise ValueError("sync time went backwards")
+                sync = time
+                position = end
+                continue
+            if RECORD_TAG <= tag <= RECORD_TAG + 4:
+                end, delta, message, unknown = parse_record(data, position, table, accept_unknown)
+                if unknown:
+                    stats["unknown"] += 1
+                flush_text()
+                if sync is None:
+                    stamp = f"+{delta}"
+                else:
+                    stamp = str((sync + delta) & 0xFFFFFFFF)
+                level = LEVEL_NAMES[tag - RECORD_TAG]
+                out.write(f"{stamp},{level + ',' if level else ''}{message}\n")
+                stats["records"] += 1
+                position = end
+                continue
+        except (EOFError, ValueError, TypeError, struct.error, OverflowError):
+            pass
+        # not a complete record: pass the byte through as plain text
+        text.append(tag)
+        if tag == 0x0A:
+            flush_text()
+        position += 1
+    flush_text()
+    return stats
+
+
+def main() -> int:
+    library_root = Path(__file__).resolve().parents[1]
+    parser = argparse.ArgumentParser(description="Decode binary logs written by Log::setBinary(true).")
+    parser.add_argument("input", nargs="?", default="-", help="binary log file (default: stdin)")
+    parser.add_argument(
+        "-s",
+        "--source",
+        action="append",
+        type=Path,
+        help="source file or directory to scan for LOG_xxxF() format strings (repeatable; default: library src/)",
+    )
+    parser.add_argument("--dump-table", action="store_true", help="print the format-string table as JSON and exit")
+    parser.add_argument("--accept-unknown", action="store_true", help="decode records whose format ID is not known")
+    args = parser.parse_args()
+
+    table = scan_sources(args.source or [library_root / "src"])
+    if args.dump_table:
+        json.dump({f"0x{key:08x}": value for key, value in sorted(table.items())}, sys.stdout, indent=2,
+                  ensure_ascii=False)
+        print()
+        return 0
+
+    data = sys.stdin.buffer.read() if args.input == "-" else Path(args.input).read_bytes()
+    stats = decode(data, table, args.accept_unknown, sys.stdout)
+    print(
+        f"decoded {stats['records']} records ({stats['unknown']} unknown), "
+        f"{stats['text_bytes']} bytes of plain text",
+        file=sys.stderr,
+    )
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
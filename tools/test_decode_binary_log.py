@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Tests for decode_binary_log.py.
+
+Run from the repository root:
+    python3 tools/test_decode_binary_log.py
+"""
+
+from __future__ import annotations
+
+import io
+import struct
+import sys
+import unittest
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+
+import decode_binary_log as decoder  # noqa: E402
+
+TABLE = {decoder.TEXT_FORMAT_ID: "%s"}
+
+
+def varint(value: int) -> bytes:
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def sync(time: int) -> bytes:
+    return bytes([decoder.SYNC_TAG]) + struct.pack("<I", time)
+
+
+def text_record(level: int, delta: int, text: str) -> bytes:
+    """A record as written by Log::writeBinaryText()."""
+    data = text.encode("utf-8")
+    args = varint(len(data)) + data
+    zigzag = (delta << 1) ^ (delta >> 31)
+    return (
+        bytes([decoder.RECORD_TAG + level])
+        + varint(zigzag & 0xFFFFFFFF)
+        + struct.pack("<I", decoder.TEXT_FORMAT_ID)
+        + varint(len(args))
+        + args
+    )
+
+
+def decode(data: bytes, accept_unknown: bool = False) -> str:
+    out = io.StringIO()
+    decoder.decode(data, TABLE, accept_unknown, out)
+    return out.getvalue()
+
+
+class DecodeTest(unittest.TestCase):
+    def test_japanese_text_passes_through(self) -> None:
+        # "は" is E3 81 AF: the last byte is the sync tag
+        text = "接続は完了しました\n"
+        self.assertEqual(decode(text.encode("utf-8")), text)
+        self.assertEqual(decode(text.encode("utf-8"), accept_unknown=True), text)
+
+    def test_japanese_text_between_records(self) -> None:
+        data = (
+            "起動しました\n".encode("utf-8")
+            + sync(1000)
+            + text_record(2, 0, "温度は正常")
+            + "接続は完了しました\n".encode("utf-8")
+            + text_record(3, 25, "再接続は失敗")
+        )
+        self.assertEqual(
+            decode(data),
+            "起動しました\n1000,INFO,温度は正常\n接続は完了しました\n1025,WARN,再接続は失敗\n",
+        )
+
+    def test_sync_before_filtered_record(self) -> None:
+        # a sink whose level filtered the record after the first sync sees two syncs in a row
+        data = sync(1000) + sync(70000) + text_record(4, 3, "error")
+        self.assertEqual(decode(data), "70003,ERROR,error\n")
+
+    def test_sync_going_backwards_is_text(self) -> None:
+        data = sync(5000) + text_record(2, 1, "a") + sync(10) + text_record(2, 2, "b")
+        lines = decode(data).splitlines()
+        self.assertEqual(lines[0], "5001,INFO,a")
+        self.assertTrue(lines[-1].endswith("5002,INFO,b"))
+
+    def test_sync_without_record_is_text(self) -> None:
+        data = b"x" + sync(1234) + b"y\n"
+        self.assertEqual(decode(data), data.decode("utf-8", errors="replace"))
+
+
+if __name__ == "__main__":
+    unittest.main()